@@ -0,0 +1,263 @@
+#include "CommandBuffer.h"
+#include <string.h>
+
+namespace
+{
+	//Arguments of the commands with more than one
+	struct DrawInstancedCommand {
+		const InstanceBuffer* instances;
+		GLsizei count;
+		int lod;
+	};
+
+	struct MultiDrawCommand {
+		IndirectRenderer* renderer;
+		size_t first;
+		size_t count;
+	};
+}
+
+CommandBuffer::CommandBuffer()
+{
+	clear();
+}
+
+void CommandBuffer::clear()
+{
+	mData.clear();
+	mCommandCount = 0;
+	mIndirectCommands.clear();
+	mIndirectDraws.clear();
+	mFirstIndirect = 0;
+	mShader = nullptr;
+	mMaterial = nullptr;
+	mMesh = nullptr;
+}
+
+template<typename T>
+void CommandBuffer::write(const T& value)
+{
+	size_t offset = mData.size();
+	mData.resize(offset + sizeof(T));
+	memcpy(&mData[offset], &value, sizeof(T));
+}
+
+template<typename T>
+T CommandBuffer::read(const unsigned char*& data)
+{
+	T value;
+	memcpy(&value, data, sizeof(T));
+	data += sizeof(T);
+	return value;
+}
+
+void CommandBuffer::writeCommand(CommandType type)
+{
+	mData.push_back(type);
+	mCommandCount++;
+}
+
+void CommandBuffer::useShader(Shader* shader)
+{
+	if (shader == mShader) {
+		return;
+	}
+	writeCommand(COMMAND_USE_SHADER);
+	write(shader);
+	mShader = shader;
+}
+
+void CommandBuffer::bindMaterial(UniformBuffer* material)
+{
+	if (material == mMaterial) {
+		return;
+	}
+	writeCommand(COMMAND_BIND_MATERIAL);
+	write(material);
+	mMaterial = material;
+}
+
+void CommandBuffer::bindMesh(Mesh* mesh)
+{
+	if (mesh == mMesh) {
+		return;
+	}
+	writeCommand(COMMAND_BIND_MESH);
+	write(mesh);
+	mMesh = mesh;
+}
+
+void CommandBuffer::setFloat(UniformKey key, float value)
+{
+	writeCommand(COMMAND_SET_FLOAT);
+	write(key);
+	write(value);
+}
+
+void CommandBuffer::setInt(UniformKey key, int value)
+{
+	writeCommand(COMMAND_SET_INT);
+	write(key);
+	write(value);
+}
+
+void CommandBuffer::setVec3(UniformKey key, const glm::vec3& value)
+{
+	writeCommand(COMMAND_SET_VEC3);
+	write(key);
+	write(value);
+}
+
+void CommandBuffer::setMat4(UniformKey key, const glm::mat4& value)
+{
+	writeCommand(COMMAND_SET_MAT4);
+	write(key);
+	write(value);
+}
+
+void CommandBuffer::draw(int lod)
+{
+	writeCommand(COMMAND_DRAW);
+	write(lod);
+}
+
+void CommandBuffer::drawInstanced(const InstanceBuffer* instances, GLsizei count, int lod)
+{
+	writeCommand(COMMAND_DRAW_INSTANCED);
+	write(DrawInstancedCommand{ instances, count, lod });
+}
+
+void CommandBuffer::addIndirect(const GeometryBuffer& geometry, GeometryHandle handle, const glm::mat4& model, int lod,
+	uint32_t materialIndex)
+{
+	const GeometryRange& range = geometry.getRange(handle, lod);
+	DrawElementsIndirectCommand command = { range.numIndices, 1, range.firstIndex, range.baseVertex,
+		(GLuint)(mIndirectCommands.size() - mFirstIndirect) };
+	mIndirectCommands.push_back(command);
+	InstanceData draw = {};
+	draw.model = model;
+	draw.materialIndex = materialIndex;
+	mIndirectDraws.push_back(draw);
+}
+
+void CommandBuffer::multiDraw(IndirectRenderer* renderer)
+{
+	if (mIndirectCommands.size() == mFirstIndirect) {
+		return;
+	}
+	writeCommand(COMMAND_MULTI_DRAW);
+	write(MultiDrawCommand{ renderer, mFirstIndirect, mIndirectCommands.size() - mFirstIndirect });
+	mFirstIndirect = mIndirectCommands.size();
+	//The renderer binds its geometry buffer's vertex array
+	mMesh = nullptr;
+}
+
+void CommandBuffer::replay(bool drawAsPoints) const
+{
+	CommandReplayState state;
+	state.drawAsPoints = drawAsPoints;
+	replay(state);
+	flush(state);
+}
+
+void CommandBuffer::replay(CommandReplayState& state) const
+{
+	const unsigned char* data = mData.data();
+	const unsigned char* end = data + mData.size();
+	while (data < end)
+	{
+		CommandType type = (CommandType)*data++;
+		//Binding what is already bound changes nothing, so a gathered multi-draw can carry on past it.
+		//Anything else has to see the draws before it done
+		switch (type) {
+		case COMMAND_USE_SHADER: {
+			Shader* shader = read<Shader*>(data);
+			if (shader != state.shader) {
+				flush(state);
+				state.shader = shader;
+				shader->use();
+			}
+			break;
+		}
+		case COMMAND_BIND_MATERIAL: {
+			UniformBuffer* material = read<UniformBuffer*>(data);
+			if (material != state.material) {
+				flush(state);
+				state.material = material;
+				material->bind();
+			}
+			break;
+		}
+		case COMMAND_BIND_MESH:
+			flush(state);
+			state.mesh = read<Mesh*>(data);
+			state.mesh->bind();
+			break;
+		case COMMAND_SET_FLOAT: {
+			flush(state);
+			UniformKey key = read<UniformKey>(data);
+			state.shader->setFloat(key, read<float>(data));
+			break;
+		}
+		case COMMAND_SET_INT: {
+			flush(state);
+			UniformKey key = read<UniformKey>(data);
+			state.shader->setInt(key, read<int>(data));
+			break;
+		}
+		case COMMAND_SET_VEC3: {
+			flush(state);
+			UniformKey key = read<UniformKey>(data);
+			state.shader->setVec3(key, read<glm::vec3>(data));
+			break;
+		}
+		case COMMAND_SET_MAT4: {
+			flush(state);
+			UniformKey key = read<UniformKey>(data);
+			state.shader->setMat4(key, read<glm::mat4>(data));
+			break;
+		}
+		case COMMAND_DRAW:
+			flush(state);
+			state.mesh->drawBound(state.drawAsPoints, read<int>(data));
+			break;
+		case COMMAND_DRAW_INSTANCED: {
+			flush(state);
+			DrawInstancedCommand drawInstanced = read<DrawInstancedCommand>(data);
+			state.mesh->drawInstanced(*drawInstanced.instances, drawInstanced.count, state.drawAsPoints, drawInstanced.lod);
+			break;
+		}
+		case COMMAND_MULTI_DRAW: {
+			MultiDrawCommand multiDraw = read<MultiDrawCommand>(data);
+			if (multiDraw.renderer != state.renderer) {
+				flush(state);
+				state.renderer = multiDraw.renderer;
+			}
+			//baseInstance counted from the start of this buffer's batch, now it counts from the start of the gathered one
+			GLuint firstDraw = (GLuint)state.draws.size();
+			for (size_t i = multiDraw.first; i < multiDraw.first + multiDraw.count; i++)
+			{
+				DrawElementsIndirectCommand command = mIndirectCommands[i];
+				command.baseInstance += firstDraw;
+				state.commands.push_back(command);
+			}
+			state.draws.insert(state.draws.end(), mIndirectDraws.begin() + multiDraw.first,
+				mIndirectDraws.begin() + multiDraw.first + multiDraw.count);
+			break;
+		}
+		}
+	}
+}
+
+void CommandBuffer::flush(CommandReplayState& state)
+{
+	if (!state.renderer) {
+		return;
+	}
+	state.renderer->draw(state.commands.data(), state.draws.data(), state.commands.size(), state.drawAsPoints);
+	state.commands.clear();
+	state.draws.clear();
+	state.renderer = nullptr;
+	//The renderer bound its geometry buffer's vertex array
+	state.mesh = nullptr;
+}
@@ -0,0 +1,94 @@
+#pragma once
+#include "GL/glew.h"
+#include <glm/glm.hpp>
+#include <vector>
+#include <stdint.h>
+#include "Mesh.h"
+#include "Shader.h"
+#include "UniformBuffer.h"
+#include "InstanceBuffer.h"
+#include "GeometryBuffer.h"
+#include "IndirectRenderer.h"
+
+//First byte of every command in a CommandBuffer, followed by its arguments
+enum CommandType : uint8_t
+{
+	COMMAND_USE_SHADER,
+	COMMAND_BIND_MATERIAL,
+	COMMAND_BIND_MESH,
+	COMMAND_SET_FLOAT,
+	COMMAND_SET_INT,
+	COMMAND_SET_VEC3,
+	COMMAND_SET_MAT4,
+	COMMAND_DRAW,
+	COMMAND_DRAW_INSTANCED,
+	COMMAND_MULTI_DRAW
+};
+
+/// <summary>
+/// What replaying has bound so far, carried from one CommandBuffer to the next. Multi-draws through the same renderer
+/// with nothing bound or set between them are gathered here and drawn as one
+/// </summary>
+struct CommandReplayState {
+	bool drawAsPoints = false;
+	Shader* shader = nullptr;
+	UniformBuffer* material = nullptr;
+	Mesh* mesh = nullptr;
+	IndirectRenderer* renderer = nullptr;
+	std::vector<DrawElementsIndirectCommand> commands;
+	std::vector<InstanceData> draws;
+};
+
+/// <summary>
+/// Draw calls and the state they need, written to memory instead of GL so any thread can record them. Only
+/// replay() touches GL, and it must run on the GL thread. Recording reads the shaders, meshes and geometry
+/// buffers it is given but never changes them, so several threads can record into buffers of their own at once
+/// as long as nothing else changes those objects meanwhile
+/// </summary>
+class CommandBuffer {
+public:
+	CommandBuffer();
+	void clear();
+	void useShader(Shader* shader);
+	//Binds the uniform buffer to its binding point (MATERIAL_BLOCK_BINDING for materials)
+	void bindMaterial(UniformBuffer* material);
+	void bindMesh(Mesh* mesh);
+	//Set on the shader of the last useShader
+	void setFloat(UniformKey key, float value);
+	void setInt(UniformKey key, int value);
+	void setVec3(UniformKey key, const glm::vec3& value);
+	void setMat4(UniformKey key, const glm::mat4& value);
+	//Draws the mesh of the last bindMesh
+	void draw(int lod = 0);
+	void drawInstanced(const InstanceBuffer* instances, GLsizei count, int lod = 0);
+	//Adds a draw to the multi-draw ended by the next multiDraw, which must be given a renderer drawing from geometry
+	void addIndirect(const GeometryBuffer& geometry, GeometryHandle handle, const glm::mat4& model, int lod = 0,
+		uint32_t materialIndex = 0);
+	void multiDraw(IndirectRenderer* renderer);
+	//Runs the commands in the order they were recorded. A buffer starts with useShader and bindMesh, so it can be
+	//replayed on its own
+	void replay(bool drawAsPoints = false) const;
+	//Replays after the buffers replayed with the same state. Call flush() after the last one
+	void replay(CommandReplayState& state) const;
+	//Draws the multi-draw gathered in state, if any
+	static void flush(CommandReplayState& state);
+	size_t getCommandCount() const { return mCommandCount; }
+	size_t getSize() const { return mData.size(); }
+private:
+	template<typename T>
+	void write(const T& value);
+	//Reads the next value and moves past it. Values are packed without padding, so they are copied out
+	template<typename T>
+	static T read(const unsigned char*& data);
+	void writeCommand(CommandType type);
+	std::vector<unsigned char> mData;
+	size_t mCommandCount;
+	//Draws added since the last multiDraw start at mFirstIndirect. Their baseInstance counts from there
+	std::vector<DrawElementsIndirectCommand> mIndirectCommands;
+	std::vector<InstanceData> mIndirectDraws;
+	size_t mFirstIndirect;
+	//What was last recorded, so repeating it records nothing
+	Shader* mShader;
+	UniformBuffer* mMaterial;
+	Mesh* mMesh;
+};
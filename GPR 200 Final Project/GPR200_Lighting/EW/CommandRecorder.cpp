@@ -0,0 +1,116 @@
+#include "CommandRecorder.h"
+#include <algorithm>
+
+CommandRecorder::CommandRecorder(unsigned int numThreads)
+{
+	if (numThreads == 0) {
+		numThreads = std::max(1u, std::thread::hardware_concurrency());
+	}
+	mBuffers.resize(numThreads);
+	mRecordFunction = nullptr;
+	mCount = 0;
+	mNumSlices = 0;
+	mPending = 0;
+	mGeneration = 0;
+	mRunning = true;
+	for (unsigned int slice = 1; slice < numThreads; slice++) {
+		mThreads.emplace_back(&CommandRecorder::run, this, slice);
+	}
+}
+
+CommandRecorder::~CommandRecorder()
+{
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mRunning = false;
+	}
+	mStart.notify_all();
+	for (std::thread& thread : mThreads) {
+		thread.join();
+	}
+}
+
+void CommandRecorder::record(size_t count, const RecordFunction& recordFunction)
+{
+	size_t numSlices = std::min((size_t)mBuffers.size(), std::max((size_t)1, count / COMMAND_RECORD_MIN_PER_THREAD));
+	//Buffers past the slices in use are emptied, so replay() doesn't draw what they held last time
+	for (size_t slice = numSlices; slice < mBuffers.size(); slice++) {
+		mBuffers[slice].clear();
+	}
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mRecordFunction = &recordFunction;
+		mCount = count;
+		mNumSlices = (unsigned int)numSlices;
+		mPending = mNumSlices - 1;
+		if (numSlices > 1) {
+			mGeneration++;
+		}
+	}
+	if (numSlices == 1) {
+		recordSlice(0);
+		return;
+	}
+	mStart.notify_all();
+	recordSlice(0);
+	std::unique_lock<std::mutex> lock(mMutex);
+	mDone.wait(lock, [this] { return mPending == 0; });
+}
+
+//Waits for each record() call, records its slice if it has one and reports back
+void CommandRecorder::run(unsigned int slice)
+{
+	uint64_t generation = 0;
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(mMutex);
+			mStart.wait(lock, [this, generation] { return !mRunning || mGeneration != generation; });
+			if (!mRunning) {
+				return;
+			}
+			generation = mGeneration;
+			if (slice >= mNumSlices) {
+				continue;
+			}
+		}
+		recordSlice(slice);
+		std::lock_guard<std::mutex> lock(mMutex);
+		if (--mPending == 0) {
+			mDone.notify_one();
+		}
+	}
+}
+
+void CommandRecorder::recordSlice(unsigned int slice)
+{
+	size_t perSlice = (mCount + mNumSlices - 1) / mNumSlices;
+	size_t first = std::min(mCount, slice * perSlice);
+	size_t last = std::min(mCount, first + perSlice);
+	CommandBuffer& buffer = mBuffers[slice];
+	buffer.clear();
+	if (first < last) {
+		(*mRecordFunction)(buffer, first, last);
+	}
+}
+
+void CommandRecorder::replay(bool drawAsPoints)
+{
+	mReplayState.drawAsPoints = drawAsPoints;
+	mReplayState.shader = nullptr;
+	mReplayState.material = nullptr;
+	mReplayState.mesh = nullptr;
+	for (const CommandBuffer& buffer : mBuffers) {
+		buffer.replay(mReplayState);
+	}
+	CommandBuffer::flush(mReplayState);
+}
+
+size_t CommandRecorder::getCommandCount() const
+{
+	size_t count = 0;
+	for (const CommandBuffer& buffer : mBuffers) {
+		count += buffer.getCommandCount();
+	}
+	return count;
+}
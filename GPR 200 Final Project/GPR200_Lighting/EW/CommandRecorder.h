@@ -0,0 +1,51 @@
+#pragma once
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <stdint.h>
+#include "CommandBuffer.h"
+
+//Records the items first to last - 1 into buffer. Runs on a worker thread, so it must not call GL
+typedef std::function<void(CommandBuffer& buffer, size_t first, size_t last)> RecordFunction;
+
+//Items each recording thread gets at least, so small scenes stay on the calling thread
+const size_t COMMAND_RECORD_MIN_PER_THREAD = 256;
+
+/// <summary>
+/// Records a scene into one CommandBuffer per thread, each thread taking its own slice of the items, then replays
+/// the buffers in slice order on the GL thread. The worker threads live as long as the recorder and wait between frames
+/// </summary>
+class CommandRecorder {
+public:
+	//0 uses one thread per core. The calling thread counts as one of them
+	CommandRecorder(unsigned int numThreads = 0);
+	~CommandRecorder();
+	//Returns once every slice is recorded
+	void record(size_t count, const RecordFunction& recordFunction);
+	//Multi-draws through the same renderer in consecutive slices are drawn as one, so recording on more threads
+	//doesn't mean more draws or uploads
+	void replay(bool drawAsPoints = false);
+	unsigned int getThreadCount() const { return (unsigned int)mBuffers.size(); }
+	size_t getCommandCount() const;
+	const CommandBuffer& getBuffer(unsigned int slice) const { return mBuffers[slice]; }
+private:
+	CommandRecorder(const CommandRecorder& r) = delete;
+	void run(unsigned int slice);
+	void recordSlice(unsigned int slice);
+	std::vector<CommandBuffer> mBuffers;
+	//Kept so the gathered multi-draw arrays keep their capacity from frame to frame
+	CommandReplayState mReplayState;
+	std::vector<std::thread> mThreads;
+	//The job of the current record() call, handed to the workers under mMutex
+	std::mutex mMutex;
+	std::condition_variable mStart;
+	std::condition_variable mDone;
+	const RecordFunction* mRecordFunction;
+	size_t mCount;
+	unsigned int mNumSlices;
+	unsigned int mPending;
+	uint64_t mGeneration;
+	bool mRunning;
+};
@@ -0,0 +1,345 @@
+//Generated by tools/embed_shaders.py from shaders/. Do not edit, rebuild instead
+#pragma once
+#include "EmbeddedShaders.h"
+
+constexpr EmbeddedShaderFile EMBEDDED_SHADER_FILES[] = {
+	{
+		"defaultLit.frag",
+		"#version 330\n"
+		"out vec4 FragColor;\n"
+		"\n"
+		"in vec3 Color;\n"
+		"\n"
+		"in vec3 WorldPos;\n"
+		"in vec3 WorldNormal;\n"
+		"\n"
+		"//Not read, but separable programs only match up the outputs of the INSTANCED and INDIRECT defaultLit.vert\n"
+		"//if it is declared\n"
+		"#ifndef INSTANCED\n"
+		"#define INSTANCED 0\n"
+		"#endif\n"
+		"\n"
+		"#ifndef INDIRECT\n"
+		"#define INDIRECT 0\n"
+		"#endif\n"
+		"\n"
+		"#if INSTANCED || INDIRECT\n"
+		"flat in uint MaterialIndex;\n"
+		"#endif\n"
+		"\n"
+		"#include \"material.glsl\"\n"
+		"#include \"lights.glsl\"\n"
+		"\n"
+		"//Number of point lights actually lit. Pick a variant with the real count so the loop can be unrolled\n"
+		"#ifndef NR_POINT_LIGHTS\n"
+		"#define NR_POINT_LIGHTS 2\n"
+		"#endif\n"
+		"\n"
+		"//Set to 0 for a variant without the spot light\n"
+		"#ifndef HAS_SPOT\n"
+		"#define HAS_SPOT 1\n"
+		"#endif\n"
+		"\n"
+		"struct Light\n"
+		"{\n"
+		"    vec3 ambient;\n"
+		"    vec3 diffuse;\n"
+		"    vec3 specular;\n"
+		"};\n"
+		"\n"
+		"vec3 CalculateDirectionalLighting(DirLight light, vec3 normal, vec3 cameraDirection);\n"
+		"\n"
+		"vec3 CalculatePointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 cameraDirection);\n"
+		"\n"
+		"vec3 CalculateSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 cameraDirection, vec3 cameraPosition);\n"
+		"\n"
+		"uniform vec3 uEyePos;\n"
+		"\n"
+		"void main()\n"
+		"{\n"
+		"    vec3 normal = normalize(WorldNormal);\n"
+		"    vec3 viewDirection = normalize(uEyePos - WorldPos);\n"
+		"\n"
+		"    vec3 totalLight = CalculateDirectionalLighting(dirLight,normal,viewDirection);\n"
+		"\n"
+		"#if HAS_SPOT\n"
+		"    totalLight += CalculateSpotLight(sptLight,normal,WorldPos,viewDirection,uEyePos);\n"
+		"#endif\n"
+		"\n"
+		"    for(int i = 0; i < NR_POINT_LIGHTS; i++)\n"
+		"        totalLight += CalculatePointLight(pointLights[i], normal, WorldPos,viewDirection);\n"
+		"\n"
+		"    FragColor = vec4(totalLight,1.0f);\n"
+		"};\n"
+		"\n"
+		"vec3 CalculateDirectionalLighting(DirLight light, vec3 normal, vec3 cameraDirection)\n"
+		"{\n"
+		"    vec3 toLight = normalize(-light.direction);\n"
+		"    \n"
+		"    float d = max(dot(normal,toLight),0.0);\n"
+		"\n"
+		"    vec3 reflectDir = reflect(-toLight,normal);\n"
+		"    float s = pow(max(dot(cameraDirection,reflectDir),0.0),material.shininess);\n"
+		"\n"
+		"    vec3 ambient = light.ambient * material.ambient;\n"
+		"    vec3 diffuse = light.diffuse * d * material.diffuse;\n"
+		"    vec3 specular = light.specular * s * material.specular;\n"
+		"\n"
+		"    return (ambient + diffuse + specular);\n"
+		"};\n"
+		"\n"
+		"vec3 CalculatePointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 cameraDirection)\n"
+		"{\n"
+		"    vec3 lightDir = normalize(light.position - fragPos);\n"
+		"\n"
+		"    float d = max(dot(normal,lightDir),0.0);\n"
+		"\n"
+		"    vec3 reflectDir = reflect(-lightDir,normal);\n"
+		"    float s = pow(max(dot(cameraDirection,reflectDir),0.0),material.shininess);\n"
+		"\n"
+		"    float distance = length(light.position - fragPos);\n"
+		"    float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));\n"
+		"\n"
+		"    vec3 ambient = light.ambient * material.ambient;\n"
+		"    vec3 diffuse = light.diffuse * d * material.diffuse;\n"
+		"    vec3 specular = light.specular * s * material.specular;\n"
+		"\n"
+		"    ambient *= attenuation;\n"
+		"    diffuse *= attenuation;\n"
+		"    specular *= attenuation;\n"
+		"    \n"
+		"    return (ambient + diffuse + specular);\n"
+		"};\n"
+		"\n"
+		" vec3 CalculateSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 cameraDirection, vec3 cameraPosition)\n"
+		" {\n"
+		"    vec3 lightDir = normalize(light.position - fragPos);\n"
+		"\n"
+		"    float theta = dot(lightDir, normalize(-light.direction));\n"
+		"\n"
+		"    if(theta > light.cutOff)\n"
+		"    {\n"
+		"        //ambient\n"
+		"        vec3 ambient = light.ambient * material.ambient;\n"
+		"\n"
+		"        //diffuse\n"
+		"        vec3 norm = normalize(normal);\n"
+		"        float d = max(dot(norm,lightDir),0.0);\n"
+		"        vec3 diffuse = light.diffuse * d * material.diffuse;\n"
+		"\n"
+		"        //specular\n"
+		"        vec3 viewDirection = normalize(cameraPosition - fragPos);\n"
+		"        vec3 reflectDir = reflect(-lightDir,normal);\n"
+		"        float s = pow(max(dot(viewDirection,reflectDir),0.0),material.shininess);\n"
+		"        vec3 specular = light.specular * s * material.specular;\n"
+		"\n"
+		"        //attenuation\n"
+		"        float distance    = length(light.position - fragPos);\n"
+		"        float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));\n"
+		"        \n"
+		"        ambient  *= attenuation;\n"
+		"        diffuse  *= attenuation;\n"
+		"        specular *= attenuation;\n"
+		"\n"
+		"        return (ambient + diffuse + specular);\n"
+		"    }\n"
+		"\n"
+		"    return vec3(0.0f);\n"
+		" };\n"
+		" \n"
+		" ",
+		4080, 0x846974840159bce8ull
+	},
+	{
+		"defaultLit.vert",
+		"#version 330     \n"
+		"//Set to 1 for a variant drawn with Mesh::drawInstanced, which reads the model matrix per instance instead of uModel\n"
+		"#ifndef INSTANCED\n"
+		"#define INSTANCED 0\n"
+		"#endif\n"
+		"\n"
+		"//Set to 1 for a variant drawn by IndirectRenderer, which reads the model matrix of each draw from DrawBlock.\n"
+		"//Only compile it if IndirectRenderer::isSupported()\n"
+		"#ifndef INDIRECT\n"
+		"#define INDIRECT 0\n"
+		"#endif\n"
+		"\n"
+		"#if INDIRECT\n"
+		"#extension GL_ARB_shader_storage_buffer_object : require\n"
+		"#endif\n"
+		"\n"
+		"layout (location = 0) in vec3 in_Pos;  \n"
+		"layout (location = 1) in vec3 in_Color;\n"
+		"layout (location = 2) in vec3 in_Normal;\n"
+		"\n"
+		"#if INSTANCED\n"
+		"layout (location = 3) in mat4 in_Model;\n"
+		"layout (location = 7) in uint in_MaterialIndex;\n"
+		"#elif INDIRECT\n"
+		"//Which entry of DrawBlock this draw is, from the command's baseInstance\n"
+		"layout (location = 8) in uint in_DrawIndex;\n"
+		"\n"
+		"//Matches InstanceData\n"
+		"struct DrawData\n"
+		"{\n"
+		"    mat4 model;\n"
+		"    uint materialIndex;\n"
+		"};\n"
+		"\n"
+		"layout (std430) readonly buffer DrawBlock\n"
+		"{\n"
+		"    DrawData draws[];\n"
+		"};\n"
+		"#else\n"
+		"uniform mat4 uModel;\n"
+		"#endif\n"
+		"\n"
+		"//Every fragment shader declares it too, or separable programs can't match up the outputs\n"
+		"#if INSTANCED || INDIRECT\n"
+		"flat out uint MaterialIndex;\n"
+		"#endif\n"
+		"\n"
+		"out vec3 Color;\n"
+		"\n"
+		"out vec3 WorldPos;\n"
+		"out vec3 WorldNormal;\n"
+		"\n"
+		"uniform mat4 uView;\n"
+		"uniform mat4 uProjection;\n"
+		"\n"
+		"void main(){       \n"
+		"#if INSTANCED\n"
+		"    mat4 model = in_Model;\n"
+		"    MaterialIndex = in_MaterialIndex;\n"
+		"#elif INDIRECT\n"
+		"    mat4 model = draws[in_DrawIndex].model;\n"
+		"    MaterialIndex = draws[in_DrawIndex].materialIndex;\n"
+		"#else\n"
+		"    mat4 model = uModel;\n"
+		"#endif\n"
+		"\n"
+		"    Color = in_Color;\n"
+		"    gl_Position = uProjection * uView * model * vec4(in_Pos,1);\n"
+		"\n"
+		"    WorldPos = vec3(model * vec4(in_Pos,1.0));\n"
+		"\n"
+		"    WorldNormal = mat3(transpose(inverse(model))) * in_Normal;\n"
+		"\n"
+		"}",
+		1723, 0xad7b39706d580e14ull
+	},
+	{
+		"lights.glsl",
+		"//Shared light definitions. Pulled in with #include \"lights.glsl\"\n"
+		"//Members are ordered so each float fills the padding after a vec3.\n"
+		"//The std140 layout of these structs is mirrored in WBox/LightBlocks.h\n"
+		"\n"
+		"//Size of the pointLights array. Injected by the application from MAX_POINT_LIGHTS in WBox/LightBlocks.h\n"
+		"#ifndef MAX_POINT_LIGHTS\n"
+		"#define MAX_POINT_LIGHTS 16\n"
+		"#endif\n"
+		"\n"
+		"struct SpotLight\n"
+		"{\n"
+		"    vec3  position;\n"
+		"    float constant;\n"
+		"    vec3  direction;\n"
+		"    float linear;\n"
+		"\n"
+		"    vec3 ambient;\n"
+		"    float quadratic;\n"
+		"    vec3 diffuse;\n"
+		"    float cutOff;\n"
+		"    vec3 specular;\n"
+		"};\n"
+		"\n"
+		"struct PointLight\n"
+		"{\n"
+		"    vec3 position;\n"
+		"    float constant;\n"
+		"\n"
+		"    vec3 ambient;\n"
+		"    float linear;\n"
+		"    vec3 diffuse;\n"
+		"    float quadratic;\n"
+		"    vec3 specular;\n"
+		"};\n"
+		"\n"
+		"struct DirLight\n"
+		"{\n"
+		"    vec3 direction;\n"
+		"\n"
+		"    vec3 ambient;\n"
+		"    vec3 diffuse;\n"
+		"    vec3 specular;\n"
+		"};\n"
+		"\n"
+		"layout(std140) uniform LightBlock\n"
+		"{\n"
+		"    DirLight dirLight;\n"
+		"    SpotLight sptLight;\n"
+		"    PointLight pointLights[MAX_POINT_LIGHTS];\n"
+		"};\n",
+		957, 0xed6e09dcfb53122dull
+	},
+	{
+		"material.glsl",
+		"//Shared material definition. Pulled in with #include \"material.glsl\"\n"
+		"//The std140 layout is mirrored by MaterialBlock in WBox/LightBlocks.h, shininess fills the padding after ambient\n"
+		"\n"
+		"struct Material\n"
+		"{\n"
+		"    vec3 ambient;\n"
+		"    float shininess;\n"
+		"    vec3 diffuse;\n"
+		"    vec3 specular;\n"
+		"};\n"
+		"\n"
+		"layout(std140) uniform MaterialBlock\n"
+		"{\n"
+		"    Material material;\n"
+		"};\n",
+		348, 0x1613e091a5d075fdull
+	},
+	{
+		"unlit.frag",
+		"#version 330                          \n"
+		"out vec4 FragColor;\n"
+		"\n"
+		"in vec3 Color;\n"
+		"in vec3 WorldPos;\n"
+		"in vec3 WorldNormal;\n"
+		"\n"
+		"//Set to 1 for the variants paired with the INSTANCED or INDIRECT defaultLit.vert. Each instance or draw picks its\n"
+		"//color from uMaterialColors\n"
+		"#ifndef INSTANCED\n"
+		"#define INSTANCED 0\n"
+		"#endif\n"
+		"\n"
+		"#ifndef INDIRECT\n"
+		"#define INDIRECT 0\n"
+		"#endif\n"
+		"\n"
+		"#ifndef MAX_INSTANCE_MATERIALS\n"
+		"#define MAX_INSTANCE_MATERIALS 8\n"
+		"#endif\n"
+		"\n"
+		"#if INSTANCED || INDIRECT\n"
+		"flat in uint MaterialIndex;\n"
+		"\n"
+		"uniform vec3 uMaterialColors[MAX_INSTANCE_MATERIALS];\n"
+		"#else\n"
+		"uniform vec3 uColor;\n"
+		"#endif\n"
+		"\n"
+		"void main(){         \n"
+		"#if INSTANCED || INDIRECT\n"
+		"    vec3 color = uMaterialColors[MaterialIndex];\n"
+		"#else\n"
+		"    vec3 color = uColor;\n"
+		"#endif\n"
+		"    FragColor = vec4(Color * color,1.0f);\n"
+		"}",
+		743, 0x7dd9325a6d250089ull
+	}
+};
@@ -0,0 +1,12 @@
+#include "EmbeddedShaders.h"
+#include "EmbeddedShaderData.h"
+
+const EmbeddedShaderFile* findEmbeddedShader(std::string_view name)
+{
+	for (const EmbeddedShaderFile& file : EMBEDDED_SHADER_FILES) {
+		if (name == file.name) {
+			return &file;
+		}
+	}
+	return nullptr;
+}
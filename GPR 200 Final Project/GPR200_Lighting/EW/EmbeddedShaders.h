@@ -0,0 +1,20 @@
+#pragma once
+#include <string_view>
+#include <cstdint>
+#include <stddef.h>
+
+/// <summary>
+/// A file from shaders/ compiled into the executable by tools/embed_shaders.py
+/// </summary>
+struct EmbeddedShaderFile
+{
+	//Relative to shaders/
+	const char* name;
+	const char* source;
+	size_t length;
+	//hashString64 of the source
+	uint64_t hash;
+};
+
+//nullptr if no file by that name was embedded
+const EmbeddedShaderFile* findEmbeddedShader(std::string_view name);
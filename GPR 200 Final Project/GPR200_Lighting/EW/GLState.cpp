@@ -0,0 +1,327 @@
+#include "GLState.h"
+#include <algorithm>
+#include <iterator>
+
+namespace
+{
+	//No object is ever given this name, and no state takes this value
+	const GLuint UNKNOWN = 0xFFFFFFFF;
+
+	//Order of TrackedState::buffers and capabilities
+	const GLenum BUFFER_TARGETS[] = {
+		GL_ARRAY_BUFFER, GL_ELEMENT_ARRAY_BUFFER, GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, GL_DRAW_INDIRECT_BUFFER,
+		GL_SHADER_STORAGE_BUFFER, GL_UNIFORM_BUFFER, GL_PIXEL_PACK_BUFFER, GL_PIXEL_UNPACK_BUFFER
+	};
+	const GLenum CAPABILITIES[] = { GL_DEPTH_TEST, GL_CULL_FACE, GL_BLEND, GL_SCISSOR_TEST, GL_STENCIL_TEST };
+}
+
+GLState::TrackedState GLState::s_state;
+GLStateStats GLState::s_stats = { 0, 0 };
+
+GLState::TrackedState::TrackedState()
+{
+	static_assert(std::size(BUFFER_TARGETS) == NUM_BUFFER_TARGETS && std::size(CAPABILITIES) == NUM_CAPABILITIES,
+		"GLState tracks a slot for each buffer target and capability");
+	program = UNKNOWN;
+	pipeline = UNKNOWN;
+	vertexArray = UNKNOWN;
+	std::fill(std::begin(buffers), std::end(buffers), UNKNOWN);
+	for (GLuint (&bindings)[GL_STATE_INDEXED_BINDINGS] : indexedBuffers) {
+		std::fill(std::begin(bindings), std::end(bindings), UNKNOWN);
+	}
+	activeTexture = UNKNOWN;
+	std::fill(std::begin(textureTargets), std::end(textureTargets), UNKNOWN);
+	std::fill(std::begin(textures), std::end(textures), UNKNOWN);
+	std::fill(std::begin(capabilities), std::end(capabilities), (int8_t)-1);
+	depthFunc = UNKNOWN;
+	depthWrite = -1;
+	cullMode = UNKNOWN;
+	blendSource = UNKNOWN;
+	blendDestination = UNKNOWN;
+	pointSize = -1.0f;
+}
+
+//Stores value and returns true if the call has to be made
+bool GLState::changed(GLuint& current, GLuint value)
+{
+	if (current == value) {
+		s_stats.elided++;
+		return false;
+	}
+	current = value;
+	s_stats.issued++;
+	return true;
+}
+
+bool GLState::changed(int8_t& current, bool value)
+{
+	if (current == (int8_t)value) {
+		s_stats.elided++;
+		return false;
+	}
+	current = (int8_t)value;
+	s_stats.issued++;
+	return true;
+}
+
+int GLState::bufferTargetIndex(GLenum target)
+{
+	for (int i = 0; i < (int)std::size(BUFFER_TARGETS); i++)
+	{
+		if (BUFFER_TARGETS[i] == target) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+int GLState::indexedTargetIndex(GLenum target)
+{
+	switch (target) {
+	case GL_UNIFORM_BUFFER: return 0;
+	case GL_SHADER_STORAGE_BUFFER: return 1;
+	default: return -1;
+	}
+}
+
+int GLState::capabilityIndex(GLenum capability)
+{
+	for (int i = 0; i < (int)std::size(CAPABILITIES); i++)
+	{
+		if (CAPABILITIES[i] == capability) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+void GLState::useProgram(GLuint program)
+{
+	if (changed(s_state.program, program)) {
+		glUseProgram(program);
+	}
+}
+
+void GLState::bindProgramPipeline(GLuint pipeline)
+{
+	if (changed(s_state.pipeline, pipeline)) {
+		glBindProgramPipeline(pipeline);
+	}
+}
+
+void GLState::bindVertexArray(GLuint vertexArray)
+{
+	if (changed(s_state.vertexArray, vertexArray)) {
+		glBindVertexArray(vertexArray);
+		s_state.buffers[bufferTargetIndex(GL_ELEMENT_ARRAY_BUFFER)] = UNKNOWN;
+	}
+}
+
+void GLState::bindBuffer(GLenum target, GLuint buffer)
+{
+	int index = bufferTargetIndex(target);
+	if (index < 0) {
+		s_stats.issued++;
+		glBindBuffer(target, buffer);
+		return;
+	}
+	if (changed(s_state.buffers[index], buffer)) {
+		glBindBuffer(target, buffer);
+	}
+}
+
+void GLState::bindBufferBase(GLenum target, GLuint index, GLuint buffer)
+{
+	int targetIndex = indexedTargetIndex(target);
+	int bufferIndex = bufferTargetIndex(target);
+	if (targetIndex < 0 || index >= GL_STATE_INDEXED_BINDINGS) {
+		s_stats.issued++;
+		glBindBufferBase(target, index, buffer);
+		if (bufferIndex >= 0) {
+			s_state.buffers[bufferIndex] = buffer;
+		}
+		return;
+	}
+	if (changed(s_state.indexedBuffers[targetIndex][index], buffer)) {
+		glBindBufferBase(target, index, buffer);
+		s_state.buffers[bufferIndex] = buffer;
+	}
+	//Already bound to index, but the target itself may have moved on since
+	else if (s_state.buffers[bufferIndex] != buffer) {
+		s_state.buffers[bufferIndex] = buffer;
+		s_stats.issued++;
+		glBindBuffer(target, buffer);
+	}
+}
+
+void GLState::bindTexture(GLuint unit, GLenum target, GLuint texture)
+{
+	if (unit >= GL_STATE_TEXTURE_UNITS) {
+		s_stats.issued += 2;
+		s_state.activeTexture = UNKNOWN;
+		glActiveTexture(GL_TEXTURE0 + unit);
+		glBindTexture(target, texture);
+		return;
+	}
+	if (s_state.textureTargets[unit] == target && s_state.textures[unit] == texture) {
+		s_stats.elided++;
+		return;
+	}
+	if (changed(s_state.activeTexture, unit)) {
+		glActiveTexture(GL_TEXTURE0 + unit);
+	}
+	s_state.textureTargets[unit] = target;
+	s_state.textures[unit] = texture;
+	s_stats.issued++;
+	glBindTexture(target, texture);
+}
+
+void GLState::setEnabled(GLenum capability, bool enabled)
+{
+	int index = capabilityIndex(capability);
+	if (index < 0) {
+		s_stats.issued++;
+	}
+	else if (!changed(s_state.capabilities[index], enabled)) {
+		return;
+	}
+	if (enabled) {
+		glEnable(capability);
+	}
+	else {
+		glDisable(capability);
+	}
+}
+
+void GLState::depthFunc(GLenum func)
+{
+	if (changed(s_state.depthFunc, func)) {
+		glDepthFunc(func);
+	}
+}
+
+void GLState::depthMask(bool write)
+{
+	if (changed(s_state.depthWrite, write)) {
+		glDepthMask(write ? GL_TRUE : GL_FALSE);
+	}
+}
+
+void GLState::cullFace(GLenum mode)
+{
+	if (changed(s_state.cullMode, mode)) {
+		glCullFace(mode);
+	}
+}
+
+void GLState::blendFunc(GLenum source, GLenum destination)
+{
+	if (s_state.blendSource == source && s_state.blendDestination == destination) {
+		s_stats.elided++;
+		return;
+	}
+	s_state.blendSource = source;
+	s_state.blendDestination = destination;
+	s_stats.issued++;
+	glBlendFunc(source, destination);
+}
+
+void GLState::pointSize(float size)
+{
+	if (s_state.pointSize == size) {
+		s_stats.elided++;
+		return;
+	}
+	s_state.pointSize = size;
+	s_stats.issued++;
+	glPointSize(size);
+}
+
+//Functions and modes of anything disabled are left as they are
+void GLState::apply(const RenderState& state)
+{
+	setEnabled(GL_DEPTH_TEST, state.depthTest);
+	if (state.depthTest) {
+		depthFunc(state.depthFunc);
+		depthMask(state.depthWrite);
+	}
+	setEnabled(GL_CULL_FACE, state.cullFace);
+	if (state.cullFace) {
+		cullFace(state.cullMode);
+	}
+	setEnabled(GL_BLEND, state.blend);
+	if (state.blend) {
+		blendFunc(state.blendSource, state.blendDestination);
+	}
+}
+
+//A program deleted while in use stays current until replaced, but a pipeline, vertex array, buffer or texture
+//stops being bound. Either way the binding is forgotten
+void GLState::deleteProgram(GLuint program)
+{
+	if (program != 0 && s_state.program == program) {
+		s_state.program = UNKNOWN;
+	}
+	glDeleteProgram(program);
+}
+
+void GLState::deleteProgramPipeline(GLuint pipeline)
+{
+	if (pipeline != 0 && s_state.pipeline == pipeline) {
+		s_state.pipeline = UNKNOWN;
+	}
+	glDeleteProgramPipelines(1, &pipeline);
+}
+
+void GLState::deleteVertexArray(GLuint vertexArray)
+{
+	if (vertexArray != 0 && s_state.vertexArray == vertexArray) {
+		s_state.vertexArray = UNKNOWN;
+		s_state.buffers[bufferTargetIndex(GL_ELEMENT_ARRAY_BUFFER)] = UNKNOWN;
+	}
+	glDeleteVertexArrays(1, &vertexArray);
+}
+
+void GLState::deleteBuffer(GLuint buffer)
+{
+	if (buffer != 0) {
+		std::replace(std::begin(s_state.buffers), std::end(s_state.buffers), buffer, UNKNOWN);
+		//Some drivers unbind an indexed binding the way glBindBufferBase would, taking the target with it. An unknown
+		//binding might hold the buffer too
+		const GLenum indexedTargets[] = { GL_UNIFORM_BUFFER, GL_SHADER_STORAGE_BUFFER };
+		for (GLenum target : indexedTargets)
+		{
+			GLuint (&bindings)[GL_STATE_INDEXED_BINDINGS] = s_state.indexedBuffers[indexedTargetIndex(target)];
+			if (std::find(std::begin(bindings), std::end(bindings), buffer) != std::end(bindings) ||
+				std::find(std::begin(bindings), std::end(bindings), UNKNOWN) != std::end(bindings)) {
+				std::replace(std::begin(bindings), std::end(bindings), buffer, UNKNOWN);
+				s_state.buffers[bufferTargetIndex(target)] = UNKNOWN;
+			}
+		}
+	}
+	glDeleteBuffers(1, &buffer);
+}
+
+void GLState::deleteTexture(GLuint texture)
+{
+	if (texture != 0) {
+		for (GLuint unit = 0; unit < GL_STATE_TEXTURE_UNITS; unit++)
+		{
+			if (s_state.textures[unit] == texture) {
+				s_state.textureTargets[unit] = UNKNOWN;
+				s_state.textures[unit] = UNKNOWN;
+			}
+		}
+	}
+	glDeleteTextures(1, &texture);
+}
+
+void GLState::invalidate()
+{
+	s_state = TrackedState();
+}
+
+void GLState::resetStats()
+{
+	s_stats = { 0, 0 };
+}
@@ -0,0 +1,102 @@
+#pragma once
+#include "GL/glew.h"
+#include <stdint.h>
+
+//GL calls made through GLState since GLState::resetStats(). Elided calls matched the state already set and never reached the driver
+struct GLStateStats
+{
+	uint32_t issued;
+	uint32_t elided;
+};
+
+/// <summary>
+/// Depth, cull and blend state of one pass, set together with GLState::apply
+/// </summary>
+struct RenderState
+{
+	bool depthTest;
+	GLenum depthFunc;
+	bool depthWrite;
+	bool cullFace;
+	GLenum cullMode;
+	bool blend;
+	GLenum blendSource;
+	GLenum blendDestination;
+};
+
+//Solid geometry: depth tested and written, back faces culled, no blending
+const RenderState OPAQUE_RENDER_STATE = { true, GL_LESS, true, true, GL_BACK, false, GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA };
+//Drawn after everything opaque, back to front: depth tested but not written, alpha blended
+const RenderState TRANSPARENT_RENDER_STATE = { true, GL_LESS, false, true, GL_BACK, true, GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA };
+
+//Texture units and indexed buffer binding points tracked. Calls past these always reach the driver
+const GLuint GL_STATE_TEXTURE_UNITS = 16;
+const GLuint GL_STATE_INDEXED_BINDINGS = 16;
+
+/// <summary>
+/// Remembers the program, vertex array, buffer, texture and fixed function state last set through it, and drops
+/// calls that would set them to what they already are. Every bind and enable in EW and WBox goes through here,
+/// so anything else calling GL directly (ImGui) must be followed by invalidate(). Tracks the one context the app draws with
+/// </summary>
+class GLState
+{
+public:
+	static void useProgram(GLuint program);
+	static void bindProgramPipeline(GLuint pipeline);
+	//Also forgets the element array buffer, which belongs to the vertex array
+	static void bindVertexArray(GLuint vertexArray);
+	static void bindBuffer(GLenum target, GLuint buffer);
+	//Also binds the buffer to target itself, as glBindBufferBase does
+	static void bindBufferBase(GLenum target, GLuint index, GLuint buffer);
+	static void bindTexture(GLuint unit, GLenum target, GLuint texture);
+	static void setEnabled(GLenum capability, bool enabled);
+	static void depthFunc(GLenum func);
+	static void depthMask(bool write);
+	static void cullFace(GLenum mode);
+	static void blendFunc(GLenum source, GLenum destination);
+	static void pointSize(float size);
+	//Only what differs from the current state is set
+	static void apply(const RenderState& state);
+
+	//Deleting through these keeps a later object that is handed the same name from looking already bound
+	static void deleteProgram(GLuint program);
+	static void deleteProgramPipeline(GLuint pipeline);
+	static void deleteVertexArray(GLuint vertexArray);
+	static void deleteBuffer(GLuint buffer);
+	static void deleteTexture(GLuint texture);
+
+	//Forgets everything, so the next call of each kind reaches the driver
+	static void invalidate();
+	static GLStateStats getStats() { return s_stats; }
+	static void resetStats();
+private:
+	static const int NUM_BUFFER_TARGETS = 9;
+	static const int NUM_CAPABILITIES = 5;
+	//Every value starts out unknown, which never matches a real one
+	struct TrackedState
+	{
+		TrackedState();
+		GLuint program;
+		GLuint pipeline;
+		GLuint vertexArray;
+		GLuint buffers[NUM_BUFFER_TARGETS];
+		GLuint indexedBuffers[2][GL_STATE_INDEXED_BINDINGS];
+		GLuint activeTexture;
+		GLenum textureTargets[GL_STATE_TEXTURE_UNITS];
+		GLuint textures[GL_STATE_TEXTURE_UNITS];
+		int8_t capabilities[NUM_CAPABILITIES];
+		GLenum depthFunc;
+		int8_t depthWrite;
+		GLenum cullMode;
+		GLenum blendSource;
+		GLenum blendDestination;
+		float pointSize;
+	};
+	static bool changed(GLuint& current, GLuint value);
+	static bool changed(int8_t& current, bool value);
+	static int bufferTargetIndex(GLenum target);
+	static int indexedTargetIndex(GLenum target);
+	static int capabilityIndex(GLenum capability);
+	static TrackedState s_state;
+	static GLStateStats s_stats;
+};
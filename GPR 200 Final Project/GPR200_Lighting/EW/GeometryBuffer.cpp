@@ -0,0 +1,131 @@
+#include "GeometryBuffer.h"
+#include "GLState.h"
+#include <stdio.h>
+#include <algorithm>
+
+GeometryBuffer::GeometryBuffer(const VertexLayout& layout, uint32_t vertexCapacity, uint32_t indexCapacity)
+	: mVertexAllocator(vertexCapacity), mIndexAllocator(indexCapacity)
+{
+	mLayout = &layout;
+
+	glGenVertexArrays(1, &mVAO);
+	GLState::bindVertexArray(mVAO);
+
+	glGenBuffers(1, &mVBO);
+	GLState::bindBuffer(GL_ARRAY_BUFFER, mVBO);
+	glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)vertexCapacity * mLayout->stride, NULL, GL_STATIC_DRAW);
+	for (const VertexAttribute& attribute : mLayout->attributes) {
+		setAttributePointer(attribute, mLayout->stride, 0);
+	}
+
+	glGenBuffers(1, &mEBO);
+	GLState::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, mEBO);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, (GLsizeiptr)indexCapacity * sizeof(GLuint), NULL, GL_STATIC_DRAW);
+
+	GLState::bindVertexArray(0);
+}
+
+GeometryBuffer::~GeometryBuffer()
+{
+	GLState::deleteVertexArray(mVAO);
+	GLState::deleteBuffer(mVBO);
+	GLState::deleteBuffer(mEBO);
+}
+
+//A block of size elements. When the allocator is full, the buffer is replaced by a copy with at least twice the room.
+//Handed out ranges keep their offsets. Growing by twice size always leaves a free range the allocator will pick
+uint32_t GeometryBuffer::allocate(TlsfAllocator& allocator, GLenum target, GLuint& buffer, GLsizeiptr elementSize, uint32_t size)
+{
+	uint32_t block = allocator.allocate(size);
+	if (block != TLSF_INVALID_BLOCK) {
+		return block;
+	}
+
+	uint32_t oldCapacity = allocator.getCapacity();
+	uint32_t newCapacity = std::max(oldCapacity * 2, oldCapacity + std::max(size, 1u) * 2);
+	GLuint newBuffer;
+	glGenBuffers(1, &newBuffer);
+	GLState::bindBuffer(GL_COPY_WRITE_BUFFER, newBuffer);
+	glBufferData(GL_COPY_WRITE_BUFFER, (GLsizeiptr)newCapacity * elementSize, NULL, GL_STATIC_DRAW);
+	GLState::bindBuffer(GL_COPY_READ_BUFFER, buffer);
+	glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, (GLsizeiptr)oldCapacity * elementSize);
+	GLState::deleteBuffer(buffer);
+	buffer = newBuffer;
+
+	//The vertex array points at the buffers themselves, so point it at the new one
+	GLState::bindVertexArray(mVAO);
+	GLState::bindBuffer(target, buffer);
+	if (target == GL_ARRAY_BUFFER) {
+		for (const VertexAttribute& attribute : mLayout->attributes) {
+			setAttributePointer(attribute, mLayout->stride, 0);
+		}
+	}
+	GLState::bindVertexArray(0);
+
+	allocator.grow(newCapacity);
+	return allocator.allocate(size);
+}
+
+GeometryHandle GeometryBuffer::add(const VertexLayout& layout, const void* vertexData, uint32_t numVertices, const std::vector<MeshLod>& levels)
+{
+	if (&layout != mLayout) {
+		printf("Geometry buffer can't add a mesh with a different vertex layout\n");
+		return INVALID_GEOMETRY;
+	}
+
+	Allocation allocation;
+	uint32_t numIndices = 0;
+	for (const MeshLod& level : levels) {
+		numIndices += (uint32_t)level.indices.size();
+	}
+	allocation.vertexBlock = allocate(mVertexAllocator, GL_ARRAY_BUFFER, mVBO, mLayout->stride, numVertices);
+	allocation.indexBlock = allocate(mIndexAllocator, GL_ELEMENT_ARRAY_BUFFER, mEBO, sizeof(GLuint), numIndices);
+
+	uint32_t firstVertex = mVertexAllocator.getOffset(allocation.vertexBlock);
+	GLState::bindBuffer(GL_ARRAY_BUFFER, mVBO);
+	glBufferSubData(GL_ARRAY_BUFFER, (GLintptr)firstVertex * mLayout->stride, (GLsizeiptr)numVertices * mLayout->stride, vertexData);
+
+	//Indices stay relative to the mesh's own vertices, each draw adds baseVertex. The element buffer is only
+	//bound through the vertex array, so it is written through the copy target instead
+	uint32_t firstIndex = mIndexAllocator.getOffset(allocation.indexBlock);
+	GLState::bindBuffer(GL_COPY_WRITE_BUFFER, mEBO);
+	for (const MeshLod& level : levels)
+	{
+		GeometryRange range = { (GLuint)level.indices.size(), firstIndex, (GLint)firstVertex };
+		glBufferSubData(GL_COPY_WRITE_BUFFER, (GLintptr)firstIndex * sizeof(GLuint), level.indices.size() * sizeof(GLuint), level.indices.data());
+		allocation.levels.push_back(range);
+		firstIndex += range.numIndices;
+	}
+
+	if (!mFreeHandles.empty()) {
+		GeometryHandle geometry = mFreeHandles.back();
+		mFreeHandles.pop_back();
+		mAllocations[geometry] = allocation;
+		return geometry;
+	}
+	mAllocations.push_back(allocation);
+	return (GeometryHandle)mAllocations.size() - 1;
+}
+
+void GeometryBuffer::remove(GeometryHandle geometry)
+{
+	if (geometry == INVALID_GEOMETRY || mAllocations[geometry].vertexBlock == TLSF_INVALID_BLOCK) {
+		return;
+	}
+	Allocation& allocation = mAllocations[geometry];
+	mVertexAllocator.free(allocation.vertexBlock);
+	mIndexAllocator.free(allocation.indexBlock);
+	allocation.vertexBlock = TLSF_INVALID_BLOCK;
+	allocation.indexBlock = TLSF_INVALID_BLOCK;
+	allocation.levels.clear();
+	mFreeHandles.push_back(geometry);
+}
+
+void GeometryBuffer::bind()
+{
+	GLState::bindVertexArray(mVAO);
+	//Generic attribute values aren't part of the vertex array, so set them for every draw
+	for (const VertexConstant& constant : mLayout->constants) {
+		glVertexAttrib4fv(constant.location, constant.value);
+	}
+}
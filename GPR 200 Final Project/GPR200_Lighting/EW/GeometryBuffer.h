@@ -0,0 +1,82 @@
+#pragma once
+#include "GL/glew.h"
+#include <vector>
+#include <stdint.h>
+#include "Mesh.h"
+#include "TlsfAllocator.h"
+
+//Returned by GeometryBuffer::add when the mesh can't be added
+typedef uint32_t GeometryHandle;
+const GeometryHandle INVALID_GEOMETRY = UINT32_MAX;
+
+//Starting sizes of a GeometryBuffer, in vertices and indices. Either doubles when it runs out
+const uint32_t GEOMETRY_DEFAULT_VERTEX_CAPACITY = 1 << 16;
+const uint32_t GEOMETRY_DEFAULT_INDEX_CAPACITY = 1 << 18;
+
+/// <summary>
+/// Where one level of detail of a mesh lives in a GeometryBuffer, as the draw command fields drawing it
+/// </summary>
+struct GeometryRange {
+	GLuint numIndices;
+	GLuint firstIndex;
+	GLint baseVertex;
+};
+
+/// <summary>
+/// One vertex buffer and one 32 bit index buffer shared by every mesh added to it, behind a single vertex array.
+/// Ranges of both are handed out by TlsfAllocators, so meshes can be removed and their space reused. Anything
+/// drawn from it can go in the same multi-draw (see IndirectRenderer)
+/// </summary>
+class GeometryBuffer {
+public:
+	//Every mesh added must use this layout
+	GeometryBuffer(const VertexLayout& layout, uint32_t vertexCapacity = GEOMETRY_DEFAULT_VERTEX_CAPACITY,
+		uint32_t indexCapacity = GEOMETRY_DEFAULT_INDEX_CAPACITY);
+	~GeometryBuffer();
+	template<typename V>
+	GeometryHandle add(const BasicMeshData<V>& meshData)
+	{
+		return add(VertexFormat<V>::layout(), meshData.vertices.data(), (uint32_t)meshData.vertices.size(),
+			{ { meshData.indices, 0.0f } });
+	}
+	//Every level shares the vertices, each gets its own range of indices
+	template<typename V>
+	GeometryHandle add(const BasicMeshLodChain<V>& lodChain)
+	{
+		return add(VertexFormat<V>::layout(), lodChain.vertices.data(), (uint32_t)lodChain.vertices.size(), lodChain.levels);
+	}
+	template<typename V, size_t NumVertices, size_t NumIndices>
+	GeometryHandle add(const StaticMeshData<V, NumVertices, NumIndices>& meshData)
+	{
+		return add(VertexFormat<V>::layout(), meshData.vertices.data(), (uint32_t)NumVertices,
+			{ { std::vector<unsigned int>(meshData.indices.begin(), meshData.indices.end()), 0.0f } });
+	}
+	GeometryHandle add(const VertexLayout& layout, const void* vertexData, uint32_t numVertices, const std::vector<MeshLod>& levels);
+	//Frees the mesh's ranges for later meshes. The handle may be handed out again
+	void remove(GeometryHandle geometry);
+	const GeometryRange& getRange(GeometryHandle geometry, int lod = 0) const { return mAllocations[geometry].levels[lod]; }
+	int getLodCount(GeometryHandle geometry) const { return (int)mAllocations[geometry].levels.size(); }
+	//Binds the vertex array and sets the layout's constant attributes, ready to draw from
+	void bind();
+	GLuint getVertexArray() const { return mVAO; }
+	const VertexLayout& getLayout() const { return *mLayout; }
+	uint32_t getVertexCapacity() const { return mVertexAllocator.getCapacity(); }
+	uint32_t getIndexCapacity() const { return mIndexAllocator.getCapacity(); }
+	uint32_t getVerticesUsed() const { return mVertexAllocator.getUsed(); }
+	uint32_t getIndicesUsed() const { return mIndexAllocator.getUsed(); }
+private:
+	//Blocks are TLSF_INVALID_BLOCK once removed
+	struct Allocation {
+		uint32_t vertexBlock;
+		uint32_t indexBlock;
+		std::vector<GeometryRange> levels;
+	};
+	GeometryBuffer(const GeometryBuffer& r) = delete;
+	uint32_t allocate(TlsfAllocator& allocator, GLenum target, GLuint& buffer, GLsizeiptr elementSize, uint32_t size);
+	GLuint mVAO, mVBO, mEBO;
+	const VertexLayout* mLayout;
+	TlsfAllocator mVertexAllocator;
+	TlsfAllocator mIndexAllocator;
+	std::vector<Allocation> mAllocations;
+	std::vector<GeometryHandle> mFreeHandles;
+};
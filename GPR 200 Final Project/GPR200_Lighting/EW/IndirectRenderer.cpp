@@ -0,0 +1,102 @@
+#include "IndirectRenderer.h"
+#include "GLState.h"
+#include "UniformBuffer.h"
+#include <algorithm>
+
+IndirectRenderer::IndirectRenderer(GeometryBuffer* geometry)
+{
+	mGeometry = geometry;
+	mCapacity = 0;
+	mPointedVertexArray = 0;
+	glGenBuffers(1, &mCommandBuffer);
+	glGenBuffers(1, &mDrawBuffer);
+	glGenBuffers(1, &mDrawIndexBuffer);
+}
+
+IndirectRenderer::~IndirectRenderer()
+{
+	GLState::deleteBuffer(mCommandBuffer);
+	GLState::deleteBuffer(mDrawBuffer);
+	GLState::deleteBuffer(mDrawIndexBuffer);
+}
+
+bool IndirectRenderer::isSupported()
+{
+	return GLEW_VERSION_4_3 || (GLEW_ARB_multi_draw_indirect && GLEW_ARB_base_instance &&
+		GLEW_ARB_shader_storage_buffer_object && GLEW_ARB_program_interface_query);
+}
+
+const VertexLayout& IndirectRenderer::drawIndexLayout()
+{
+	static const VertexLayout drawIndexLayout = {
+		{
+			{ "in_DrawIndex", DRAW_INDEX_LOCATION, 1, GL_UNSIGNED_INT, GL_FALSE, 0, GL_UNSIGNED_INT }
+		},
+		sizeof(GLuint),
+		{},
+		1
+	};
+	return drawIndexLayout;
+}
+
+void IndirectRenderer::clear()
+{
+	mCommands.clear();
+	mDraws.clear();
+}
+
+void IndirectRenderer::add(GeometryHandle geometry, const glm::mat4& model, int lod, uint32_t materialIndex)
+{
+	const GeometryRange& range = mGeometry->getRange(geometry, lod);
+	DrawElementsIndirectCommand command = { range.numIndices, 1, range.firstIndex, range.baseVertex, (GLuint)mCommands.size() };
+	mCommands.push_back(command);
+	InstanceData draw = {};
+	draw.model = model;
+	draw.materialIndex = materialIndex;
+	mDraws.push_back(draw);
+}
+
+void IndirectRenderer::draw(bool drawAsPoints)
+{
+	draw(mCommands.data(), mDraws.data(), mCommands.size(), drawAsPoints);
+}
+
+void IndirectRenderer::draw(const DrawElementsIndirectCommand* commands, const InstanceData* draws, size_t count, bool drawAsPoints)
+{
+	if (count == 0) {
+		return;
+	}
+
+	//The draw indices only change when there is room for more draws
+	if (count > mCapacity) {
+		mCapacity = std::max(count, mCapacity * 2);
+		std::vector<GLuint> drawIndices(mCapacity);
+		for (size_t i = 0; i < mCapacity; i++) {
+			drawIndices[i] = (GLuint)i;
+		}
+		GLState::bindBuffer(GL_ARRAY_BUFFER, mDrawIndexBuffer);
+		glBufferData(GL_ARRAY_BUFFER, mCapacity * sizeof(GLuint), drawIndices.data(), GL_STATIC_DRAW);
+	}
+
+	//Orphaned like InstanceBuffer, so last frame's draw can still read the old storage
+	GLState::bindBuffer(GL_DRAW_INDIRECT_BUFFER, mCommandBuffer);
+	glBufferData(GL_DRAW_INDIRECT_BUFFER, mCapacity * sizeof(DrawElementsIndirectCommand), NULL, GL_STREAM_DRAW);
+	glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, count * sizeof(DrawElementsIndirectCommand), commands);
+	GLState::bindBuffer(GL_SHADER_STORAGE_BUFFER, mDrawBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, mCapacity * sizeof(InstanceData), NULL, GL_STREAM_DRAW);
+	glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, count * sizeof(InstanceData), draws);
+	GLState::bindBufferBase(GL_SHADER_STORAGE_BUFFER, DRAW_BLOCK_BINDING, mDrawBuffer);
+
+	mGeometry->bind();
+	if (mPointedVertexArray != mGeometry->getVertexArray()) {
+		const VertexLayout& layout = drawIndexLayout();
+		GLState::bindBuffer(GL_ARRAY_BUFFER, mDrawIndexBuffer);
+		for (const VertexAttribute& attribute : layout.attributes) {
+			setAttributePointer(attribute, layout.stride, layout.divisor);
+		}
+		mPointedVertexArray = mGeometry->getVertexArray();
+	}
+
+	glMultiDrawElementsIndirect(drawAsPoints ? GL_POINTS : GL_TRIANGLES, GL_UNSIGNED_INT, NULL, (GLsizei)count, 0);
+	GLState::bindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
@@ -0,0 +1,57 @@
+#pragma once
+#include "GL/glew.h"
+#include <glm/glm.hpp>
+#include <vector>
+#include <stdint.h>
+#include "GeometryBuffer.h"
+#include "InstanceBuffer.h"
+
+//Location of in_DrawIndex in the INDIRECT variant of defaultLit.vert, after InstanceData's
+const GLuint DRAW_INDEX_LOCATION = FIRST_INSTANCE_LOCATION + 5;
+
+/// <summary>
+/// Layout of one command in GL_DRAW_INDIRECT_BUFFER, as glMultiDrawElementsIndirect reads it
+/// </summary>
+struct DrawElementsIndirectCommand {
+	GLuint count;
+	GLuint instanceCount;
+	GLuint firstIndex;
+	GLint baseVertex;
+	//Set to the command's own index, which is how the shader finds its entry in DrawBlock
+	GLuint baseInstance;
+};
+
+/// <summary>
+/// Draws everything added to it since clear() from one GeometryBuffer in a single glMultiDrawElementsIndirect,
+/// however many objects there are. Each draw's model matrix and material index go in a shader storage buffer
+/// bound to DrawBlock. Draw with the INDIRECT variant of defaultLit.vert
+/// </summary>
+class IndirectRenderer {
+public:
+	IndirectRenderer(GeometryBuffer* geometry);
+	~IndirectRenderer();
+	//GL 4.3, or multi-draw indirect, base instance, shader storage buffers and program interface queries as extensions
+	static bool isSupported();
+	//in_DrawIndex, the per instance input the INDIRECT shader variant indexes DrawBlock with
+	static const VertexLayout& drawIndexLayout();
+	void clear();
+	void add(GeometryHandle geometry, const glm::mat4& model, int lod = 0, uint32_t materialIndex = 0);
+	//Uploads the draws added since clear() and submits them all in one call
+	void draw(bool drawAsPoints = false);
+	//Same, for draws built somewhere else (see CommandBuffer::addIndirect). Each command's baseInstance indexes draws
+	void draw(const DrawElementsIndirectCommand* commands, const InstanceData* draws, size_t count, bool drawAsPoints = false);
+	size_t getDrawCount() const { return mCommands.size(); }
+	GeometryBuffer* getGeometry() const { return mGeometry; }
+private:
+	IndirectRenderer(const IndirectRenderer& r) = delete;
+	GeometryBuffer* mGeometry;
+	std::vector<DrawElementsIndirectCommand> mCommands;
+	std::vector<InstanceData> mDraws;
+	GLuint mCommandBuffer;
+	GLuint mDrawBuffer;
+	//Holds 0, 1, 2... so in_DrawIndex reads each command's baseInstance
+	GLuint mDrawIndexBuffer;
+	size_t mCapacity;
+	//Vertex array whose in_DrawIndex was last pointed at mDrawIndexBuffer
+	GLuint mPointedVertexArray;
+};
@@ -0,0 +1,43 @@
+#include "InstanceBuffer.h"
+#include "GLState.h"
+#include <cstddef>
+
+const VertexLayout& InstanceData::layout()
+{
+	static const VertexLayout instanceLayout = {
+		{
+			{ "in_Model", FIRST_INSTANCE_LOCATION, 4, GL_FLOAT, GL_FALSE, offsetof(InstanceData, model), GL_FLOAT_MAT4 },
+			{ "in_MaterialIndex", FIRST_INSTANCE_LOCATION + 4, 1, GL_UNSIGNED_INT, GL_FALSE, offsetof(InstanceData, materialIndex), GL_UNSIGNED_INT }
+		},
+		sizeof(InstanceData),
+		{},
+		1
+	};
+	return instanceLayout;
+}
+
+InstanceBuffer::InstanceBuffer(size_t capacity)
+{
+	mCapacity = capacity;
+	mCount = 0;
+
+	glGenBuffers(1, &mVBO);
+	GLState::bindBuffer(GL_ARRAY_BUFFER, mVBO);
+	glBufferData(GL_ARRAY_BUFFER, mCapacity * sizeof(InstanceData), NULL, GL_STREAM_DRAW);
+}
+
+InstanceBuffer::~InstanceBuffer()
+{
+	GLState::deleteBuffer(mVBO);
+}
+
+void InstanceBuffer::upload(const InstanceData* instances, size_t count)
+{
+	if (count > mCapacity) {
+		mCapacity = count;
+	}
+	GLState::bindBuffer(GL_ARRAY_BUFFER, mVBO);
+	glBufferData(GL_ARRAY_BUFFER, mCapacity * sizeof(InstanceData), NULL, GL_STREAM_DRAW);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, count * sizeof(InstanceData), instances);
+	mCount = count;
+}
@@ -0,0 +1,42 @@
+#pragma once
+#include "GL/glew.h"
+#include <glm/glm.hpp>
+#include <vector>
+#include <stdint.h>
+#include "VertexLayout.h"
+
+//Size of the per-material arrays the instanced shaders index with materialIndex. Injected as MAX_INSTANCE_MATERIALS
+const int MAX_INSTANCE_MATERIALS = 8;
+
+/// <summary>
+/// What Mesh::drawInstanced reads once per instance. Fed to in_Model and in_MaterialIndex of the INSTANCED shader variants
+/// </summary>
+struct InstanceData {
+	glm::mat4 model;
+	//Which entry of the shader's per-material arrays this instance uses, below MAX_INSTANCE_MATERIALS
+	uint32_t materialIndex;
+	//Keeps every instance 16 byte aligned
+	uint32_t padding[3];
+	//Locations FIRST_INSTANCE_LOCATION (4, one per column of the model matrix) and FIRST_INSTANCE_LOCATION + 4
+	static const VertexLayout& layout();
+};
+
+/// <summary>
+/// Holds an OpenGL vertex buffer of InstanceData
+/// </summary>
+class InstanceBuffer {
+public:
+	InstanceBuffer(size_t capacity = 0);
+	~InstanceBuffer();
+	//Replaces every instance. The old storage is orphaned rather than overwritten, so draws still reading it don't stall
+	//the upload, and grows if count doesn't fit
+	void upload(const InstanceData* instances, size_t count);
+	void upload(const std::vector<InstanceData>& instances) { upload(instances.data(), instances.size()); }
+	GLuint getId() const { return mVBO; }
+	size_t getCount() const { return mCount; }
+private:
+	InstanceBuffer(const InstanceBuffer& r) = delete;
+	GLuint mVBO;
+	size_t mCapacity;
+	size_t mCount;
+};
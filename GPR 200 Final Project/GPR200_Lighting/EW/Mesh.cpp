@@ -1,45 +1,330 @@
 #include "Mesh.h"
-Mesh::Mesh(MeshData* meshData) {
+#include "GLState.h"
+#include "InstanceBuffer.h"
+#include <glm/gtc/packing.hpp>
+#include <algorithm>
+#include <climits>
+#include <math.h>
+
+void setAttributePointer(const VertexAttribute& attribute, GLsizei stride, GLuint divisor)
+{
+	GLuint numColumns = attribute.shaderType == GL_FLOAT_MAT4 ? 4 : 1;
+	GLuint columnSize = attribute.components * sizeof(GLfloat);
+	for (GLuint column = 0; column < numColumns; column++)
+	{
+		GLuint location = attribute.location + column;
+		const void* offset = (const void*)(size_t)(attribute.offset + column * columnSize);
+		if (attribute.shaderType == GL_UNSIGNED_INT || attribute.shaderType == GL_INT) {
+			glVertexAttribIPointer(location, attribute.components, attribute.type, stride, offset);
+		}
+		else {
+			glVertexAttribPointer(location, attribute.components, attribute.type, attribute.normalized, stride, offset);
+		}
+		glVertexAttribDivisor(location, divisor);
+		glEnableVertexAttribArray(location);
+	}
+}
+
+const VertexLayout& Vertex::layout()
+{
+	static const VertexLayout vertexLayout = {
+		{
+			{ "in_Pos", 0, 3, GL_FLOAT, GL_FALSE, offsetof(Vertex, position), GL_FLOAT_VEC3 },
+			{ "in_Color", 1, 3, GL_FLOAT, GL_FALSE, offsetof(Vertex, color), GL_FLOAT_VEC3 },
+			{ "in_Normal", 2, 3, GL_FLOAT, GL_FALSE, offsetof(Vertex, normal), GL_FLOAT_VEC3 }
+		},
+		sizeof(Vertex),
+		{}
+	};
+	return vertexLayout;
+}
+
+CompactVertex::CompactVertex(glm::vec3 position, glm::vec3, glm::vec3 normal)
+{
+	this->position[0] = glm::packHalf1x16(position.x);
+	this->position[1] = glm::packHalf1x16(position.y);
+	this->position[2] = glm::packHalf1x16(position.z);
+	this->position[3] = 0;
+	this->normal = glm::packSnorm3x10_1x2(glm::vec4(normal, 0.0f));
+}
+
+glm::vec3 CompactVertex::getPosition() const
+{
+	return glm::vec3(glm::unpackHalf1x16(position[0]), glm::unpackHalf1x16(position[1]), glm::unpackHalf1x16(position[2]));
+}
+
+const VertexLayout& CompactVertex::layout()
+{
+	static const VertexLayout vertexLayout = {
+		{
+			{ "in_Pos", 0, 3, GL_HALF_FLOAT, GL_FALSE, offsetof(CompactVertex, position), GL_FLOAT_VEC3 },
+			{ "in_Normal", 2, 4, GL_INT_2_10_10_10_REV, GL_TRUE, offsetof(CompactVertex, normal), GL_FLOAT_VEC3 }
+		},
+		sizeof(CompactVertex),
+		{
+			{ 1, { 1.0f, 1.0f, 1.0f, 1.0f } }
+		}
+	};
+	return vertexLayout;
+}
+
+Mesh::Mesh(const VertexLayout& layout, const void* vertexData, size_t vertexDataSize, GLsizei numVertices,
+	const std::vector<MeshLod>& levels, float boundingRadius, bool splitLargeMeshes) {
 	
-	glGenVertexArrays(1, &mVAO);
-	glBindVertexArray(mVAO);
+	createVertexBuffer(layout, vertexData, vertexDataSize);
 
-	glGenBuffers(1, &mVBO);
-	glBindBuffer(GL_ARRAY_BUFFER, mVBO);
-	glBufferData(GL_ARRAY_BUFFER, meshData->vertices.size() * sizeof(Vertex), &meshData->vertices[0], GL_STATIC_DRAW);
+	//Every level goes into one index buffer, one after the other
+	std::vector<unsigned short> shortIndices;
+	size_t firstIndex = 0;
+	mIndexType = GL_UNSIGNED_SHORT;
+	for (const MeshLod& level : levels)
+	{
+		Lod lod;
+		lod.error = level.error;
+		lod.firstVertex = 0;
+		lod.numVertices = 0;
+		if (!level.indices.empty()) {
+			auto range = std::minmax_element(level.indices.begin(), level.indices.end());
+			lod.firstVertex = (GLint)*range.first;
+			lod.numVertices = (GLsizei)(*range.second - *range.first + 1);
+		}
+
+		if ((size_t)numVertices <= MAX_SHORT_INDEX_VERTICES) {
+			shortIndices.insert(shortIndices.end(), level.indices.begin(), level.indices.end());
+			lod.submeshes.push_back({ (GLsizei)level.indices.size(), firstIndex, 0 });
+		}
+		else if (!splitLargeMeshes || !splitIntoSubmeshes(level.indices, firstIndex, shortIndices, lod.submeshes)) {
+			mIndexType = GL_UNSIGNED_INT;
+		}
+		firstIndex += level.indices.size();
+		mLods.push_back(lod);
+	}
+
+	glGenBuffers(1, &mEBO);
+	GLState::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, mEBO);
+	if (mIndexType == GL_UNSIGNED_SHORT) {
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, shortIndices.size() * sizeof(unsigned short), shortIndices.data(), GL_STATIC_DRAW);
+	}
+	else {
+		//A level couldn't be split, so every level is drawn in one go from 32 bit indices
+		std::vector<unsigned int> indices;
+		indices.reserve(firstIndex);
+		for (size_t i = 0; i < levels.size(); i++)
+		{
+			mLods[i].submeshes.assign(1, { (GLsizei)levels[i].indices.size(), indices.size(), 0 });
+			indices.insert(indices.end(), levels[i].indices.begin(), levels[i].indices.end());
+		}
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
+	}
+
+	mBoundingRadius = boundingRadius;
+}
+
+Mesh::Mesh(const VertexLayout& layout, const void* vertexData, size_t vertexDataSize, GLsizei numVertices,
+	const unsigned short* indices, GLsizei numIndices, float boundingRadius) {
+
+	createVertexBuffer(layout, vertexData, vertexDataSize);
 
 	glGenBuffers(1, &mEBO);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mEBO);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, meshData->indices.size() * sizeof(unsigned int), &meshData->indices[0], GL_STATIC_DRAW);
+	GLState::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, mEBO);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, numIndices * sizeof(unsigned short), indices, GL_STATIC_DRAW);
+	mIndexType = GL_UNSIGNED_SHORT;
 
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (const void*)(offsetof(Vertex, position)));
-	glEnableVertexAttribArray(0);
+	Lod lod;
+	lod.submeshes.push_back({ numIndices, 0, 0 });
+	lod.error = 0.0f;
+	lod.firstVertex = 0;
+	lod.numVertices = numVertices;
+	mLods.push_back(lod);
 
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (const void*)(offsetof(Vertex, color)));
-	glEnableVertexAttribArray(1);
+	mBoundingRadius = boundingRadius;
+}
 
-	glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (const void*)(offsetof(Vertex, normal)));
-	glEnableVertexAttribArray(2);
+//Creates the VAO and fills the vertex buffer. The VAO is left bound
+void Mesh::createVertexBuffer(const VertexLayout& layout, const void* vertexData, size_t vertexDataSize)
+{
+	glGenVertexArrays(1, &mVAO);
+	GLState::bindVertexArray(mVAO);
 
-	mNumIndices = (GLsizei)meshData->indices.size();
-	mNumVertices = (GLsizei)meshData->vertices.size();
+	glGenBuffers(1, &mVBO);
+	GLState::bindBuffer(GL_ARRAY_BUFFER, mVBO);
+	glBufferData(GL_ARRAY_BUFFER, vertexDataSize, vertexData, GL_STATIC_DRAW);
+
+	mLayout = &layout;
+	mEnabledAttributes = 0;
+	mInstanceBuffer = 0;
+	for (const VertexAttribute& attribute : mLayout->attributes)
+	{
+		setAttributePointer(attribute, mLayout->stride, 0);
+		mEnabledAttributes |= 1u << attribute.location;
+	}
+}
+
+//Walks the triangles in order, starting a new submesh whenever the vertices used so far would span more than
+//MAX_SHORT_INDEX_VERTICES. Generated meshes index their vertices roughly in order, so this splits them cleanly
+//without touching the vertex buffer. The indices are appended, starting at firstIndex. Returns false if a single
+//triangle is too wide to fit
+bool Mesh::splitIntoSubmeshes(const std::vector<unsigned int>& indices, size_t firstIndex,
+	std::vector<unsigned short>& shortIndices, std::vector<Submesh>& submeshes)
+{
+	size_t start = 0;
+	unsigned int minIndex = UINT_MAX;
+	unsigned int maxIndex = 0;
+	size_t firstSubmesh = submeshes.size();
+	for (size_t i = 0; i + 2 < indices.size(); i += 3)
+	{
+		unsigned int triangleMin = std::min(indices[i], std::min(indices[i + 1], indices[i + 2]));
+		unsigned int triangleMax = std::max(indices[i], std::max(indices[i + 1], indices[i + 2]));
+		if (triangleMax - triangleMin > MAX_SHORT_INDEX_VERTICES) {
+			return false;
+		}
+		if (std::max(maxIndex, triangleMax) - std::min(minIndex, triangleMin) > MAX_SHORT_INDEX_VERTICES) {
+			submeshes.push_back({ (GLsizei)(i - start), firstIndex + start, (GLint)minIndex });
+			start = i;
+			minIndex = UINT_MAX;
+			maxIndex = 0;
+		}
+		minIndex = std::min(minIndex, triangleMin);
+		maxIndex = std::max(maxIndex, triangleMax);
+	}
+	if (start < indices.size()) {
+		submeshes.push_back({ (GLsizei)(indices.size() - start), firstIndex + start, (GLint)minIndex });
+	}
+
+	for (size_t s = firstSubmesh; s < submeshes.size(); s++)
+	{
+		const Submesh& submesh = submeshes[s];
+		for (size_t i = submesh.firstIndex - firstIndex; i < submesh.firstIndex - firstIndex + submesh.numIndices; i++) {
+			shortIndices.push_back((unsigned short)(indices[i] - submesh.baseVertex));
+		}
+	}
+	return true;
 }
 
 Mesh::~Mesh()
 {
-	glDeleteVertexArrays(1, &mVAO);
-	glDeleteBuffers(1, &mVBO);
-	glDeleteBuffers(1, &mEBO);
+	GLState::deleteVertexArray(mVAO);
+	GLState::deleteBuffer(mVBO);
+	GLState::deleteBuffer(mEBO);
+}
+
+void Mesh::enableAttributes(uint32_t mask)
+{
+	if (mask == mEnabledAttributes) {
+		return;
+	}
+	GLState::bindVertexArray(mVAO);
+	for (const VertexAttribute& attribute : mLayout->attributes)
+	{
+		uint32_t bit = 1u << attribute.location;
+		if ((mask & bit) && !(mEnabledAttributes & bit)) {
+			glEnableVertexAttribArray(attribute.location);
+		}
+		else if (!(mask & bit) && (mEnabledAttributes & bit)) {
+			glDisableVertexAttribArray(attribute.location);
+		}
+	}
+	mEnabledAttributes = mask;
+}
+
+void Mesh::draw(bool drawAsPoints, int lod)
+{
+	GLState::bindVertexArray(mVAO);
+	drawLod(lod, drawAsPoints, 0);
+}
+
+void Mesh::bind()
+{
+	GLState::bindVertexArray(mVAO);
+}
+
+void Mesh::drawBound(bool drawAsPoints, int lod)
+{
+	drawLod(lod, drawAsPoints, 0);
 }
 
-void Mesh::draw(bool drawAsPoints)
+void Mesh::drawInstanced(const InstanceBuffer& instanceBuffer, GLsizei count, bool drawAsPoints, int lod)
 {
-	glBindVertexArray(mVAO);
+	GLState::bindVertexArray(mVAO);
+	//The VAO remembers which buffer the instance attributes read, so only re-point them when it changes
+	if (mInstanceBuffer != instanceBuffer.getId()) {
+		const VertexLayout& instanceLayout = InstanceData::layout();
+		GLState::bindBuffer(GL_ARRAY_BUFFER, instanceBuffer.getId());
+		for (const VertexAttribute& attribute : instanceLayout.attributes) {
+			setAttributePointer(attribute, instanceLayout.stride, instanceLayout.divisor);
+		}
+		mInstanceBuffer = instanceBuffer.getId();
+	}
+	drawLod(lod, drawAsPoints, count);
+}
+
+void Mesh::drawLod(int lod, bool drawAsPoints, GLsizei instanceCount)
+{
+	const Lod& level = mLods[lod];
+	//Generic attribute values aren't part of the VAO, so set them for every draw
+	for (const VertexConstant& constant : mLayout->constants) {
+		glVertexAttrib4fv(constant.location, constant.value);
+	}
 	GLenum mode = drawAsPoints ? GL_POINTS : GL_TRIANGLES;
 	if (drawAsPoints) {
-		glDrawArrays(mode, 0, mNumVertices);
+		if (instanceCount > 0) {
+			glDrawArraysInstanced(mode, level.firstVertex, level.numVertices, instanceCount);
+		}
+		else {
+			glDrawArrays(mode, level.firstVertex, level.numVertices);
+		}
 	}
 	else {
-		glDrawElements(mode, mNumIndices, GL_UNSIGNED_INT, 0);
+		size_t indexSize = mIndexType == GL_UNSIGNED_SHORT ? sizeof(unsigned short) : sizeof(unsigned int);
+		for (const Submesh& submesh : level.submeshes)
+		{
+			void* offset = (void*)(submesh.firstIndex * indexSize);
+			if (instanceCount > 0) {
+				glDrawElementsInstancedBaseVertex(mode, submesh.numIndices, mIndexType, offset, instanceCount, submesh.baseVertex);
+			}
+			else if (submesh.baseVertex == 0) {
+				glDrawElements(mode, submesh.numIndices, mIndexType, offset);
+			}
+			else {
+				glDrawElementsBaseVertex(mode, submesh.numIndices, mIndexType, offset, submesh.baseVertex);
+			}
+		}
+	}
+}
+
+namespace
+{
+	//Shared by Mesh::selectLod and selectLod for LOD chains. levelError(lod) is the error of that level
+	template<typename LevelError>
+	int selectLevel(int numLevels, LevelError levelError, float projectedSize, int currentLod, float bias)
+	{
+		int lastLod = numLevels - 1;
+		currentLod = std::max(0, std::min(currentLod, lastLod));
+		//Errors are fractions of the bounding radius, half the projected size
+		float pixelsPerError = projectedSize * 0.5f;
+		float allowedError = LOD_PIXEL_ERROR * exp2f(bias);
+
+		//Too coarse up close: go to the coarsest level that is fine enough
+		if (levelError(currentLod) * pixelsPerError > allowedError * (1.0f + LOD_HYSTERESIS)) {
+			while (currentLod > 0 && levelError(currentLod) * pixelsPerError > allowedError) {
+				currentLod--;
+			}
+			return currentLod;
+		}
+		//Finer than needed: only coarsen once the next level is comfortably within the allowed error
+		while (currentLod < lastLod && levelError(currentLod + 1) * pixelsPerError <= allowedError * (1.0f - LOD_HYSTERESIS)) {
+			currentLod++;
+		}
+		return currentLod;
 	}
 }
+
+int Mesh::selectLod(float projectedSize, int currentLod, float bias) const
+{
+	return selectLevel((int)mLods.size(), [this](int lod) { return mLods[lod].error; }, projectedSize, currentLod, bias);
+}
+
+int selectLod(const std::vector<MeshLod>& levels, float projectedSize, int currentLod, float bias)
+{
+	return selectLevel((int)levels.size(), [&levels](int lod) { return levels[lod].error; }, projectedSize, currentLod, bias);
+}
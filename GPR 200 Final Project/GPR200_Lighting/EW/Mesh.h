@@ -2,21 +2,118 @@
 #include <GL/glew.h>
 #include <glm/glm.hpp>
 #include <vector>
+#include <array>
+#include <stdint.h>
+#include "VertexLayout.h"
+
+class InstanceBuffer;
 
 struct Vertex {
 	glm::vec3 position;
 	glm::vec3 color;
 	glm::vec3 normal;
-	Vertex(glm::vec3 position, glm::vec3 color, glm::vec3 normal) 
+	constexpr Vertex(glm::vec3 position, glm::vec3 color, glm::vec3 normal) 
 		: position(position), color(color), normal(normal) {};
+	//Locations 0/1/2, matching the inputs of defaultLit.vert
+	static const VertexLayout& layout();
+};
+
+/// <summary>
+/// 12 byte vertex: half float position and a 10:10:10 signed normalized normal. Color is dropped,
+/// shaders that read in_Color get white
+/// </summary>
+struct CompactVertex {
+	//x, y, z as half floats. The 4th is padding so the normal stays 4 byte aligned
+	uint16_t position[4];
+	//GL_INT_2_10_10_10_REV
+	uint32_t normal;
+	CompactVertex(glm::vec3 position, glm::vec3 color, glm::vec3 normal);
+	//Already packed, for vertices built at compile time (see StaticShapeGen.h)
+	constexpr CompactVertex(uint16_t x, uint16_t y, uint16_t z, uint32_t normal)
+		: position{ x, y, z, 0 }, normal(normal) {};
+	glm::vec3 getPosition() const;
+	static const VertexLayout& layout();
+};
+static_assert(sizeof(CompactVertex) == 12, "CompactVertex should be 12 bytes");
+
+//How Mesh finds the layout of a vertex type, and mesh passes its position. Specialize it for vertex types
+//that don't have a static layout() or a position member
+template<typename V>
+struct VertexFormat {
+	static const VertexLayout& layout() { return V::layout(); }
+	static glm::vec3 position(const V& vertex) { return vertex.position; }
+};
+
+template<>
+struct VertexFormat<CompactVertex> {
+	static const VertexLayout& layout() { return CompactVertex::layout(); }
+	static glm::vec3 position(const CompactVertex& vertex) { return vertex.getPosition(); }
 };
 
 /// <summary>
 /// Just holds a bunch of vertex + face (indices) data
 /// </summary>
-struct MeshData {
-	std::vector<Vertex> vertices;
+template<typename V>
+struct BasicMeshData {
+	std::vector<V> vertices;
+	std::vector<unsigned int> indices;
+};
+typedef BasicMeshData<Vertex> MeshData;
+
+/// <summary>
+/// One level of detail, as indices into the vertices shared by every level of its chain
+/// </summary>
+struct MeshLod {
 	std::vector<unsigned int> indices;
+	//Furthest this level strays from the full detail surface, as a fraction of the mesh's bounding radius
+	float error;
+};
+
+/// <summary>
+/// Vertices and the levels of detail drawn from them, finest first
+/// </summary>
+template<typename V>
+struct BasicMeshLodChain {
+	std::vector<V> vertices;
+	std::vector<MeshLod> levels;
+};
+typedef BasicMeshLodChain<Vertex> MeshLodChain;
+
+//Distance from the origin to the furthest vertex. Generated shapes are centered on the origin
+template<typename V>
+float computeBoundingRadius(const std::vector<V>& vertices)
+{
+	float radius = 0.0f;
+	for (const V& vertex : vertices) {
+		radius = glm::max(radius, glm::length(VertexFormat<V>::position(vertex)));
+	}
+	return radius;
+}
+
+//How far, in pixels, a level may stray from the full detail surface on screen before a finer one is drawn
+const float LOD_PIXEL_ERROR = 1.0f;
+//Fraction the projected error has to move past a switch point before the level changes, so levels don't flicker
+const float LOD_HYSTERESIS = 0.2f;
+
+//Mesh::selectLod for levels that aren't in a Mesh, such as a LOD chain added to a GeometryBuffer
+int selectLod(const std::vector<MeshLod>& levels, float projectedSize, int currentLod, float bias = 0.0f);
+
+//Points an attribute of the bound vertex array at the bound GL_ARRAY_BUFFER and enables it. Matrices take one location
+//per column. divisor 0 advances once per vertex, 1 once per instance
+void setAttributePointer(const VertexAttribute& attribute, GLsizei stride, GLuint divisor);
+
+//Largest vertex count whose indices fit in 16 bits
+const size_t MAX_SHORT_INDEX_VERTICES = 65535;
+
+/// <summary>
+/// Vertex and 16 bit index tables sized at compile time, built by the make* functions in StaticShapeGen.h
+/// </summary>
+template<typename V, size_t NumVertices, size_t NumIndices>
+struct StaticMeshData {
+	static_assert(NumVertices <= MAX_SHORT_INDEX_VERTICES, "Static meshes use 16 bit indices");
+	std::array<V, NumVertices> vertices;
+	std::array<unsigned short, NumIndices> indices;
+	float boundingRadius;
 };
 
 /// <summary>
@@ -24,11 +121,76 @@ struct MeshData {
 /// </summary>
 class Mesh {
 public:
-	Mesh(MeshData* meshData);
+	//Indices are stored as 16 bit when every vertex fits. Bigger meshes are split into submeshes that each
+	//span at most MAX_SHORT_INDEX_VERTICES vertices, drawn with a base vertex. If splitLargeMeshes is false,
+	//or a single triangle spans more than that, they fall back to 32 bit indices
+	template<typename V>
+	Mesh(const BasicMeshData<V>* meshData, bool splitLargeMeshes = true)
+		: Mesh(VertexFormat<V>::layout(), meshData->vertices.data(), meshData->vertices.size() * sizeof(V),
+			(GLsizei)meshData->vertices.size(), { { meshData->indices, 0.0f } }, computeBoundingRadius(meshData->vertices),
+			splitLargeMeshes) {};
+	//Every level goes into the same buffers
+	template<typename V>
+	Mesh(const BasicMeshLodChain<V>* lodChain, bool splitLargeMeshes = true)
+		: Mesh(VertexFormat<V>::layout(), lodChain->vertices.data(), lodChain->vertices.size() * sizeof(V),
+			(GLsizei)lodChain->vertices.size(), lodChain->levels, computeBoundingRadius(lodChain->vertices),
+			splitLargeMeshes) {};
+	//Uploads both tables as they are, without copying or converting them first
+	template<typename V, size_t NumVertices, size_t NumIndices>
+	Mesh(const StaticMeshData<V, NumVertices, NumIndices>* meshData)
+		: Mesh(VertexFormat<V>::layout(), meshData->vertices.data(), sizeof(meshData->vertices), (GLsizei)NumVertices,
+			meshData->indices.data(), (GLsizei)NumIndices, meshData->boundingRadius) {};
+	Mesh(const VertexLayout& layout, const void* vertexData, size_t vertexDataSize, GLsizei numVertices,
+		const std::vector<MeshLod>& levels, float boundingRadius, bool splitLargeMeshes = true);
+	Mesh(const VertexLayout& layout, const void* vertexData, size_t vertexDataSize, GLsizei numVertices,
+		const unsigned short* indices, GLsizei numIndices, float boundingRadius);
 	~Mesh();
-	void draw(bool drawAsPoints);
+	void draw(bool drawAsPoints, int lod = 0);
+	//Binds the vertex array. A run of draws of this mesh can bind once, then call drawBound for each
+	void bind();
+	//draw() without binding the vertex array first
+	void drawBound(bool drawAsPoints, int lod = 0);
+	//Draws count instances in one call, each reading its model matrix and material index from instanceBuffer.
+	//Use the INSTANCED variant of the shader
+	void drawInstanced(const InstanceBuffer& instanceBuffer, GLsizei count, bool drawAsPoints = false, int lod = 0);
+	//The level to draw at projectedSize, the diameter of the bounding sphere in pixels (see WB::Camera::getProjectedSize).
+	//Pass the level last picked for the same object, it is kept until the error moves LOD_HYSTERESIS past a switch point.
+	//Each step of bias doubles the error allowed
+	int selectLod(float projectedSize, int currentLod, float bias = 0.0f) const;
+	int getLodCount() const { return (int)mLods.size(); }
+	float getBoundingRadius() const { return mBoundingRadius; }
+	//Only attributes whose location bit is set are fetched, the rest read a constant. Pass the union of
+	//Shader::getActiveAttributeMask() over every shader that draws this mesh. Only touches GL when the mask changes
+	void enableAttributes(uint32_t mask);
+	const VertexLayout& getLayout() const { return *mLayout; }
+	//GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+	GLenum getIndexType() const { return mIndexType; }
+	size_t getSubmeshCount(int lod = 0) const { return mLods[lod].submeshes.size(); }
 private:
+	//A range of the index buffer, with indices relative to baseVertex
+	struct Submesh {
+		GLsizei numIndices;
+		size_t firstIndex;
+		GLint baseVertex;
+	};
+	struct Lod {
+		std::vector<Submesh> submeshes;
+		float error;
+		//The vertices the level uses, drawn when drawing as points
+		GLint firstVertex;
+		GLsizei numVertices;
+	};
+	void createVertexBuffer(const VertexLayout& layout, const void* vertexData, size_t vertexDataSize);
+	//instanceCount 0 draws without instancing
+	void drawLod(int lod, bool drawAsPoints, GLsizei instanceCount);
+	static bool splitIntoSubmeshes(const std::vector<unsigned int>& indices, size_t firstIndex,
+		std::vector<unsigned short>& shortIndices, std::vector<Submesh>& submeshes);
 	GLuint mVAO, mVBO, mEBO;
-	GLsizei mNumIndices;
-	GLsizei mNumVertices;
-};
\ No newline at end of file
+	const VertexLayout* mLayout;
+	uint32_t mEnabledAttributes;
+	//Instance buffer the VAO's per-instance attributes last pointed at, 0 if none
+	GLuint mInstanceBuffer;
+	GLenum mIndexType;
+	std::vector<Lod> mLods;
+	float mBoundingRadius;
+};
@@ -0,0 +1,200 @@
+#include "MeshCleanup.h"
+#include <glm/gtc/packing.hpp>
+#include <math.h>
+#include <string.h>
+#include <stdint.h>
+#include <algorithm>
+#include <array>
+#include <unordered_map>
+
+namespace
+{
+	//Welding only compares vertices in the same or a neighbouring cell of a grid over their positions
+	const float WELD_MIN_CELL_SIZE = 1e-6f;
+
+	uint64_t hashCell(int64_t x, int64_t y, int64_t z)
+	{
+		return (uint64_t)x * 73856093u ^ (uint64_t)y * 19349663u ^ (uint64_t)z * 83492791u;
+	}
+
+	//Sign extends a 10 or 2 bit field
+	int signedField(uint32_t value, int shift, int bits)
+	{
+		int field = (int)((value >> shift) & ((1u << bits) - 1));
+		return field >= (1 << (bits - 1)) ? field - (1 << bits) : field;
+	}
+}
+
+std::vector<float> decodeVertexAttributes(const void* vertices, size_t numVertices, const VertexLayout& layout,
+	unsigned int& componentsPerVertex)
+{
+	componentsPerVertex = 0;
+	for (const VertexAttribute& attribute : layout.attributes) {
+		componentsPerVertex += attribute.components;
+	}
+
+	std::vector<float> attributes(numVertices * componentsPerVertex, 0.0f);
+	const unsigned char* bytes = (const unsigned char*)vertices;
+	for (size_t i = 0; i < numVertices; i++)
+	{
+		const unsigned char* vertex = bytes + i * layout.stride;
+		float* out = &attributes[i * componentsPerVertex];
+		for (const VertexAttribute& attribute : layout.attributes)
+		{
+			const unsigned char* data = vertex + attribute.offset;
+			if (attribute.type == GL_FLOAT) {
+				memcpy(out, data, attribute.components * sizeof(float));
+			}
+			else if (attribute.type == GL_HALF_FLOAT) {
+				for (GLint c = 0; c < attribute.components; c++)
+				{
+					uint16_t half;
+					memcpy(&half, data + c * sizeof(uint16_t), sizeof(uint16_t));
+					out[c] = glm::unpackHalf1x16(half);
+				}
+			}
+			else if (attribute.type == GL_INT_2_10_10_10_REV) {
+				uint32_t packed;
+				memcpy(&packed, data, sizeof(uint32_t));
+				int fields[4] = { signedField(packed, 0, 10), signedField(packed, 10, 10), signedField(packed, 20, 10), signedField(packed, 30, 2) };
+				for (GLint c = 0; c < attribute.components && c < 4; c++) {
+					//Normalized fields map to -1..1, the lowest value clamps to -1
+					out[c] = attribute.normalized ? std::max(-1.0f, fields[c] / (c < 3 ? 511.0f : 1.0f)) : (float)fields[c];
+				}
+			}
+			out += attribute.components;
+		}
+	}
+	return attributes;
+}
+
+std::vector<unsigned int> cleanupMesh(std::vector<unsigned int>& indices, const std::vector<float>& attributes,
+	unsigned int componentsPerVertex, const std::vector<glm::vec3>& positions, float epsilon, MeshCleanupStats& stats)
+{
+	stats = MeshCleanupStats();
+	size_t numVertices = positions.size();
+
+	//Weld: every vertex either becomes the representative of its attributes or maps to an earlier one. Only
+	//representatives go into the grid, chained per cell
+	std::vector<unsigned int> remap(numVertices);
+	std::vector<unsigned int> nextInCell(numVertices, UINT32_MAX);
+	std::unordered_map<uint64_t, unsigned int> cells;
+	cells.reserve(numVertices);
+	float cellSize = std::max(epsilon, WELD_MIN_CELL_SIZE);
+	for (size_t i = 0; i < numVertices; i++)
+	{
+		const float* vertex = &attributes[i * componentsPerVertex];
+		int64_t cx = (int64_t)floorf(positions[i].x / cellSize);
+		int64_t cy = (int64_t)floorf(positions[i].y / cellSize);
+		int64_t cz = (int64_t)floorf(positions[i].z / cellSize);
+
+		unsigned int match = UINT32_MAX;
+		for (int n = 0; n < 27 && match == UINT32_MAX; n++)
+		{
+			auto cell = cells.find(hashCell(cx + n % 3 - 1, cy + n / 3 % 3 - 1, cz + n / 9 - 1));
+			for (unsigned int other = cell == cells.end() ? UINT32_MAX : cell->second; other != UINT32_MAX; other = nextInCell[other])
+			{
+				const float* candidate = &attributes[other * componentsPerVertex];
+				unsigned int c = 0;
+				while (c < componentsPerVertex && fabsf(vertex[c] - candidate[c]) <= epsilon) {
+					c++;
+				}
+				if (c == componentsPerVertex) {
+					match = other;
+					break;
+				}
+			}
+		}
+
+		if (match != UINT32_MAX) {
+			remap[i] = match;
+			stats.weldedVertices++;
+		}
+		else {
+			remap[i] = (unsigned int)i;
+			auto cell = cells.emplace(hashCell(cx, cy, cz), (unsigned int)i);
+			if (!cell.second) {
+				nextInCell[i] = cell.first->second;
+				cell.first->second = (unsigned int)i;
+			}
+		}
+	}
+
+	//Degenerate triangles. The rest are also kept rotated so the lowest index comes first, which keeps the winding,
+	//to find duplicates below
+	std::vector<std::array<unsigned int, 3>> triangles;
+	std::vector<std::array<unsigned int, 3>> rotated;
+	triangles.reserve(indices.size() / 3);
+	rotated.reserve(indices.size() / 3);
+	for (size_t i = 0; i + 2 < indices.size(); i += 3)
+	{
+		unsigned int a = remap[indices[i]];
+		unsigned int b = remap[indices[i + 1]];
+		unsigned int c = remap[indices[i + 2]];
+		float doubleArea = glm::length(glm::cross(positions[b] - positions[a], positions[c] - positions[a]));
+		if (a == b || b == c || c == a || doubleArea <= epsilon * epsilon) {
+			stats.degenerateTriangles++;
+			continue;
+		}
+		triangles.push_back({ a, b, c });
+		if (b < a && b < c) {
+			rotated.push_back({ b, c, a });
+		}
+		else if (c < a && c < b) {
+			rotated.push_back({ c, a, b });
+		}
+		else {
+			rotated.push_back({ a, b, c });
+		}
+	}
+
+	//Duplicates: sorted, equal triangles end up next to each other. The first one in the index buffer is kept
+	std::vector<unsigned int> order(triangles.size());
+	for (size_t i = 0; i < order.size(); i++) {
+		order[i] = (unsigned int)i;
+	}
+	std::sort(order.begin(), order.end(), [&rotated](unsigned int l, unsigned int r) {
+		return rotated[l] != rotated[r] ? rotated[l] < rotated[r] : l < r;
+	});
+	std::vector<bool> duplicate(triangles.size(), false);
+	for (size_t i = 1; i < order.size(); i++)
+	{
+		if (rotated[order[i]] == rotated[order[i - 1]]) {
+			duplicate[order[i]] = true;
+			stats.duplicateTriangles++;
+		}
+	}
+
+	//Compact: vertices keep their order, so a fetch optimized order survives
+	std::vector<unsigned int> newIndex(numVertices, UINT32_MAX);
+	for (size_t i = 0; i < triangles.size(); i++)
+	{
+		if (!duplicate[i]) {
+			for (unsigned int vertex : triangles[i]) {
+				newIndex[vertex] = 0;
+			}
+		}
+	}
+	std::vector<unsigned int> kept;
+	for (size_t i = 0; i < numVertices; i++)
+	{
+		if (newIndex[i] != UINT32_MAX) {
+			newIndex[i] = (unsigned int)kept.size();
+			kept.push_back((unsigned int)i);
+		}
+	}
+	stats.removedVertices = (unsigned int)(numVertices - kept.size());
+
+	std::vector<unsigned int> cleaned;
+	cleaned.reserve(triangles.size() * 3);
+	for (size_t i = 0; i < triangles.size(); i++)
+	{
+		if (!duplicate[i]) {
+			for (unsigned int vertex : triangles[i]) {
+				cleaned.push_back(newIndex[vertex]);
+			}
+		}
+	}
+	indices.swap(cleaned);
+	return kept;
+}
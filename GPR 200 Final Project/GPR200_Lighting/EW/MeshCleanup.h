@@ -0,0 +1,50 @@
+#pragma once
+#include "Mesh.h"
+#include "MeshOptimizer.h"
+#include <vector>
+
+//How far apart, per component and in the units of each attribute, two vertices may be and still be welded
+const float WELD_DEFAULT_EPSILON = 1e-5f;
+
+/// <summary>
+/// What cleanupMesh removed
+/// </summary>
+struct MeshCleanupStats {
+	//Vertices merged into an earlier one with the same attributes
+	unsigned int weldedVertices;
+	//Triangles using a vertex twice, or with no area
+	unsigned int degenerateTriangles;
+	//Triangles repeating an earlier one with the same winding. The same three vertices wound the other way are kept
+	unsigned int duplicateTriangles;
+	//Vertices no triangle used anymore, welded ones included
+	unsigned int removedVertices;
+};
+
+//Every attribute of every vertex as floats, in layout order: GL_FLOAT, GL_HALF_FLOAT and GL_INT_2_10_10_10_REV are
+//decoded, other types read as 0. componentsPerVertex is set to the number of floats per vertex
+std::vector<float> decodeVertexAttributes(const void* vertices, size_t numVertices, const VertexLayout& layout,
+	unsigned int& componentsPerVertex);
+
+//Welds vertices whose attributes (componentsPerVertex floats each) are all within epsilon of an earlier vertex's,
+//then drops degenerate and duplicate triangles, then drops the vertices left unused. Rewrites the indices and returns
+//the old index of each vertex kept, in their original order. Area is measured with positions
+std::vector<unsigned int> cleanupMesh(std::vector<unsigned int>& indices, const std::vector<float>& attributes,
+	unsigned int componentsPerVertex, const std::vector<glm::vec3>& positions, float epsilon, MeshCleanupStats& stats);
+
+//Runs the cleanup on meshData, comparing every attribute in the vertex type's layout
+template<typename V>
+MeshCleanupStats cleanupMesh(BasicMeshData<V>& meshData, float epsilon = WELD_DEFAULT_EPSILON)
+{
+	unsigned int componentsPerVertex = 0;
+	std::vector<float> attributes = decodeVertexAttributes(meshData.vertices.data(), meshData.vertices.size(),
+		VertexFormat<V>::layout(), componentsPerVertex);
+	MeshCleanupStats stats;
+	std::vector<unsigned int> kept = cleanupMesh(meshData.indices, attributes, componentsPerVertex, getPositions(meshData), epsilon, stats);
+	std::vector<V> vertices;
+	vertices.reserve(kept.size());
+	for (unsigned int oldIndex : kept) {
+		vertices.push_back(meshData.vertices[oldIndex]);
+	}
+	meshData.vertices.swap(vertices);
+	return stats;
+}
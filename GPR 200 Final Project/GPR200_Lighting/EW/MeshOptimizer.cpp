@@ -0,0 +1,677 @@
+#include "MeshOptimizer.h"
+#include <math.h>
+#include <algorithm>
+#include <float.h>
+#include <queue>
+#include <map>
+#include <unordered_map>
+#include <tuple>
+#include <iterator>
+
+namespace
+{
+	//Forsyth's tuning. The cache modeled while ordering is LRU and larger than the one analyzed, which works well for both
+	const int FORSYTH_CACHE_SIZE = 32;
+	const float FORSYTH_LAST_TRIANGLE_SCORE = 0.75f;
+	const float FORSYTH_CACHE_DECAY_POWER = 1.5f;
+	const float FORSYTH_VALENCE_BOOST_SCALE = 2.0f;
+	const float FORSYTH_VALENCE_BOOST_POWER = 0.5f;
+
+	//cachePosition is -1 if the vertex isn't cached
+	float vertexScore(int cachePosition, unsigned int remainingTriangles)
+	{
+		if (remainingTriangles == 0) {
+			return -1.0f;
+		}
+
+		float score = 0.0f;
+		if (cachePosition >= 0) {
+			//The last triangle's vertices get a fixed score so the next triangle doesn't just reuse the same edge
+			if (cachePosition < 3) {
+				score = FORSYTH_LAST_TRIANGLE_SCORE;
+			}
+			else {
+				float scale = 1.0f / (FORSYTH_CACHE_SIZE - 3);
+				score = powf(1.0f - (cachePosition - 3) * scale, FORSYTH_CACHE_DECAY_POWER);
+			}
+		}
+
+		//Vertices with few triangles left are finished off first, so they don't linger as stragglers
+		score += FORSYTH_VALENCE_BOOST_SCALE * powf((float)remainingTriangles, -FORSYTH_VALENCE_BOOST_POWER);
+		return score;
+	}
+
+	//Resolution of each view analyzeOverdraw renders
+	const int OVERDRAW_GRID_SIZE = 256;
+
+	//One view of analyzeOverdraw: a depth buffer, and how many times each pixel passed the depth test
+	struct OverdrawView {
+		std::vector<float> depth;
+		std::vector<unsigned int> shaded;
+	};
+
+	float edgeFunction(const glm::vec3& a, const glm::vec3& b, float x, float y)
+	{
+		return (b.x - a.x) * (y - a.y) - (b.y - a.y) * (x - a.x);
+	}
+
+	//x and y are in pixels, z is depth. Pixel centers inside the triangle are shaded if they pass a GL_LESS depth test
+	void rasterizeTriangle(OverdrawView& view, const glm::vec3& a, const glm::vec3& b, const glm::vec3& c)
+	{
+		float area = edgeFunction(a, b, c.x, c.y);
+		if (area == 0.0f) {
+			return;
+		}
+
+		int minX = std::max(0, (int)floorf(std::min(a.x, std::min(b.x, c.x))));
+		int maxX = std::min(OVERDRAW_GRID_SIZE - 1, (int)ceilf(std::max(a.x, std::max(b.x, c.x))));
+		int minY = std::max(0, (int)floorf(std::min(a.y, std::min(b.y, c.y))));
+		int maxY = std::min(OVERDRAW_GRID_SIZE - 1, (int)ceilf(std::max(a.y, std::max(b.y, c.y))));
+		for (int y = minY; y <= maxY; y++)
+		{
+			for (int x = minX; x <= maxX; x++)
+			{
+				float px = x + 0.5f;
+				float py = y + 0.5f;
+				//Barycentric weights, all the same sign as area when inside whichever way the triangle winds
+				float wa = edgeFunction(b, c, px, py) / area;
+				float wb = edgeFunction(c, a, px, py) / area;
+				float wc = edgeFunction(a, b, px, py) / area;
+				if (wa < 0.0f || wb < 0.0f || wc < 0.0f) {
+					continue;
+				}
+				float z = wa * a.z + wb * b.z + wc * c.z;
+				int pixel = y * OVERDRAW_GRID_SIZE + x;
+				if (z < view.depth[pixel]) {
+					view.depth[pixel] = z;
+					view.shaded[pixel]++;
+				}
+			}
+		}
+	}
+
+	//Sum of squared distances to a set of planes, weighted by triangle area. Divided by the total weight, evaluating it
+	//at a point gives the mean squared distance from the point to the planes
+	struct Quadric {
+		double a2 = 0, ab = 0, ac = 0, ad = 0, b2 = 0, bc = 0, bd = 0, c2 = 0, cd = 0, d2 = 0;
+		double weight = 0;
+
+		void addPlane(const glm::vec3& normal, float d, float planeWeight)
+		{
+			double a = normal.x, b = normal.y, c = normal.z;
+			a2 += a * a * planeWeight; ab += a * b * planeWeight; ac += a * c * planeWeight; ad += a * d * planeWeight;
+			b2 += b * b * planeWeight; bc += b * c * planeWeight; bd += b * d * planeWeight;
+			c2 += c * c * planeWeight; cd += c * d * planeWeight;
+			d2 += (double)d * d * planeWeight;
+			weight += planeWeight;
+		}
+		void add(const Quadric& other)
+		{
+			a2 += other.a2; ab += other.ab; ac += other.ac; ad += other.ad; b2 += other.b2; bc += other.bc;
+			bd += other.bd; c2 += other.c2; cd += other.cd; d2 += other.d2; weight += other.weight;
+		}
+		double evaluate(const glm::vec3& p) const
+		{
+			double x = p.x, y = p.y, z = p.z;
+			return a2 * x * x + 2 * ab * x * y + 2 * ac * x * z + 2 * ad * x
+				+ b2 * y * y + 2 * bc * y * z + 2 * bd * y
+				+ c2 * z * z + 2 * cd * z + d2;
+		}
+	};
+
+	//Moving vertex from onto vertex to. Stale once either vertex has changed since it was queued
+	struct Collapse {
+		float cost;
+		unsigned int from;
+		unsigned int to;
+		unsigned int fromVersion;
+		unsigned int toVersion;
+		bool operator>(const Collapse& other) const { return cost > other.cost; }
+	};
+
+	//FIFO post-transform cache. A vertex is still cached if fewer than cacheSize misses happened since it went in
+	struct FifoCache {
+		FifoCache(size_t numVertices, unsigned int cacheSize)
+			: timestamps(numVertices, 0), misses(cacheSize), cacheSize(cacheSize) {};
+		//Returns 1 on a miss
+		unsigned int access(unsigned int index)
+		{
+			if (misses - timestamps[index] < cacheSize) {
+				return 0;
+			}
+			misses++;
+			timestamps[index] = misses;
+			return 1;
+		}
+		unsigned int accessTriangle(const unsigned int* triangle)
+		{
+			return access(triangle[0]) + access(triangle[1]) + access(triangle[2]);
+		}
+		//Pushes everything out, as if starting a new draw
+		void flush() { misses += cacheSize; }
+
+		std::vector<unsigned int> timestamps;
+		//Starts at cacheSize so the zeroed timestamps read as long expired
+		unsigned int misses;
+		unsigned int cacheSize;
+	};
+}
+
+VertexCacheStats analyzeVertexCache(const std::vector<unsigned int>& indices, size_t numVertices, unsigned int cacheSize)
+{
+	FifoCache cache(numVertices, cacheSize);
+	std::vector<bool> used(numVertices, false);
+	unsigned int misses = 0;
+	unsigned int usedVertices = 0;
+
+	for (unsigned int index : indices)
+	{
+		if (!used[index]) {
+			used[index] = true;
+			usedVertices++;
+		}
+		misses += cache.access(index);
+	}
+
+	VertexCacheStats stats;
+	size_t numTriangles = indices.size() / 3;
+	stats.acmr = numTriangles > 0 ? (float)misses / numTriangles : 0.0f;
+	stats.atvr = usedVertices > 0 ? (float)misses / usedVertices : 0.0f;
+	return stats;
+}
+
+void optimizeVertexCache(std::vector<unsigned int>& indices, size_t numVertices)
+{
+	size_t numTriangles = indices.size() / 3;
+	if (numTriangles == 0) {
+		return;
+	}
+
+	//Triangles using each vertex, packed into one array. The first remainingTriangles of each vertex's range are
+	//the ones not emitted yet
+	std::vector<unsigned int> remainingTriangles(numVertices, 0);
+	for (size_t i = 0; i < numTriangles * 3; i++) {
+		remainingTriangles[indices[i]]++;
+	}
+	std::vector<unsigned int> firstTriangle(numVertices + 1, 0);
+	for (size_t v = 0; v < numVertices; v++) {
+		firstTriangle[v + 1] = firstTriangle[v] + remainingTriangles[v];
+	}
+	std::vector<unsigned int> vertexTriangles(numTriangles * 3);
+	std::vector<unsigned int> filled(numVertices, 0);
+	for (size_t i = 0; i < numTriangles * 3; i++) {
+		unsigned int v = indices[i];
+		vertexTriangles[firstTriangle[v] + filled[v]++] = (unsigned int)(i / 3);
+	}
+
+	std::vector<float> vertexScores(numVertices);
+	for (size_t v = 0; v < numVertices; v++) {
+		vertexScores[v] = vertexScore(-1, remainingTriangles[v]);
+	}
+	std::vector<float> triangleScores(numTriangles);
+	for (size_t t = 0; t < numTriangles; t++) {
+		triangleScores[t] = vertexScores[indices[t * 3]] + vertexScores[indices[t * 3 + 1]] + vertexScores[indices[t * 3 + 2]];
+	}
+	std::vector<bool> emitted(numTriangles, false);
+
+	std::vector<unsigned int> output;
+	output.reserve(numTriangles * 3);
+	//Most recently used first. Holds up to three extra vertices between pushing a triangle and trimming
+	std::vector<unsigned int> cache;
+	std::vector<unsigned int> newCache;
+	cache.reserve(FORSYTH_CACHE_SIZE + 3);
+	newCache.reserve(FORSYTH_CACHE_SIZE + 3);
+
+	int bestTriangle = (int)(std::max_element(triangleScores.begin(), triangleScores.end()) - triangleScores.begin());
+	size_t nextUnemitted = 0;
+	while (output.size() < numTriangles * 3)
+	{
+		//Nothing in the cache touches a remaining triangle, so start again from the next one in the input
+		if (bestTriangle < 0) {
+			while (emitted[nextUnemitted]) {
+				nextUnemitted++;
+			}
+			bestTriangle = (int)nextUnemitted;
+		}
+
+		const unsigned int* triangle = &indices[bestTriangle * 3];
+		emitted[bestTriangle] = true;
+		output.insert(output.end(), triangle, triangle + 3);
+
+		//Take the triangle off each of its vertices
+		for (int i = 0; i < 3; i++)
+		{
+			unsigned int v = triangle[i];
+			unsigned int* triangles = &vertexTriangles[firstTriangle[v]];
+			unsigned int* found = std::find(triangles, triangles + remainingTriangles[v], (unsigned int)bestTriangle);
+			std::swap(*found, triangles[remainingTriangles[v] - 1]);
+			remainingTriangles[v]--;
+		}
+
+		//The triangle's vertices move to the front, everything else shifts back
+		newCache.assign(triangle, triangle + 3);
+		for (unsigned int v : cache) {
+			if (v != triangle[0] && v != triangle[1] && v != triangle[2]) {
+				newCache.push_back(v);
+			}
+		}
+		cache.swap(newCache);
+
+		//Rescore every vertex in or just pushed out of the cache, and the triangles left on them
+		for (size_t i = 0; i < cache.size(); i++)
+		{
+			unsigned int v = cache[i];
+			int position = i < (size_t)FORSYTH_CACHE_SIZE ? (int)i : -1;
+			float score = vertexScore(position, remainingTriangles[v]);
+			float delta = score - vertexScores[v];
+			vertexScores[v] = score;
+			for (unsigned int j = 0; j < remainingTriangles[v]; j++) {
+				triangleScores[vertexTriangles[firstTriangle[v] + j]] += delta;
+			}
+		}
+		if (cache.size() > (size_t)FORSYTH_CACHE_SIZE) {
+			cache.resize(FORSYTH_CACHE_SIZE);
+		}
+
+		//The next triangle is the best one touching the cache
+		bestTriangle = -1;
+		float bestScore = -1.0f;
+		for (unsigned int v : cache)
+		{
+			for (unsigned int j = 0; j < remainingTriangles[v]; j++)
+			{
+				unsigned int t = vertexTriangles[firstTriangle[v] + j];
+				if (triangleScores[t] > bestScore) {
+					bestScore = triangleScores[t];
+					bestTriangle = (int)t;
+				}
+			}
+		}
+	}
+
+	indices.swap(output);
+}
+
+std::vector<unsigned int> optimizeVertexFetchRemap(std::vector<unsigned int>& indices, size_t numVertices)
+{
+	const unsigned int unassigned = ~0u;
+	std::vector<unsigned int> newIndex(numVertices, unassigned);
+	std::vector<unsigned int> order;
+	order.reserve(numVertices);
+
+	for (unsigned int& index : indices)
+	{
+		if (newIndex[index] == unassigned) {
+			newIndex[index] = (unsigned int)order.size();
+			order.push_back(index);
+		}
+		index = newIndex[index];
+	}
+
+	for (size_t v = 0; v < numVertices; v++) {
+		if (newIndex[v] == unassigned) {
+			order.push_back((unsigned int)v);
+		}
+	}
+	return order;
+}
+
+OverdrawStats analyzeOverdraw(const std::vector<unsigned int>& indices, const std::vector<glm::vec3>& positions, bool cullBackFaces)
+{
+	OverdrawStats stats = { 0.0f, 0, 0 };
+	if (positions.empty()) {
+		return stats;
+	}
+
+	glm::vec3 minBounds = positions[0];
+	glm::vec3 maxBounds = positions[0];
+	for (const glm::vec3& position : positions) {
+		minBounds = glm::min(minBounds, position);
+		maxBounds = glm::max(maxBounds, position);
+	}
+	//One scale for every axis so the mesh keeps its proportions, with a pixel of border
+	glm::vec3 extent = maxBounds - minBounds;
+	float scale = (OVERDRAW_GRID_SIZE - 2) / std::max(extent.x, std::max(extent.y, extent.z));
+
+	OverdrawView view;
+	//Looking down each axis from both sides
+	for (int axis = 0; axis < 3; axis++)
+	{
+		for (float side : { 1.0f, -1.0f })
+		{
+			view.depth.assign(OVERDRAW_GRID_SIZE * OVERDRAW_GRID_SIZE, FLT_MAX);
+			view.shaded.assign(OVERDRAW_GRID_SIZE * OVERDRAW_GRID_SIZE, 0);
+			for (size_t i = 0; i + 2 < indices.size(); i += 3)
+			{
+				glm::vec3 projected[3];
+				for (int j = 0; j < 3; j++)
+				{
+					glm::vec3 local = (positions[indices[i + j]] - minBounds) * scale + 1.0f;
+					//Depth grows away from the viewer, who looks along side * axis
+					projected[j] = glm::vec3(local[(axis + 1) % 3], local[(axis + 2) % 3], side * local[axis]);
+				}
+				if (cullBackFaces) {
+					//The projected winding is the normal along axis. A front face points back toward the viewer
+					float facing = edgeFunction(projected[0], projected[1], projected[2].x, projected[2].y) * side;
+					if (facing >= 0.0f) {
+						continue;
+					}
+				}
+				rasterizeTriangle(view, projected[0], projected[1], projected[2]);
+			}
+
+			for (unsigned int shaded : view.shaded)
+			{
+				if (shaded > 0) {
+					stats.pixelsCovered++;
+					stats.pixelsShaded += shaded;
+				}
+			}
+		}
+	}
+
+	stats.overdraw = stats.pixelsCovered > 0 ? (float)stats.pixelsShaded / stats.pixelsCovered : 0.0f;
+	return stats;
+}
+
+void optimizeOverdraw(std::vector<unsigned int>& indices, const std::vector<glm::vec3>& positions, float threshold)
+{
+	size_t numTriangles = indices.size() / 3;
+	if (numTriangles == 0) {
+		return;
+	}
+
+	//Hard boundaries: triangles where the optimized order already restarts, missing on all three vertices
+	FifoCache cache(positions.size(), VERTEX_CACHE_ANALYZE_SIZE);
+	std::vector<size_t> hardClusters;
+	for (size_t t = 0; t < numTriangles; t++) {
+		if (cache.accessTriangle(&indices[t * 3]) == 3) {
+			hardClusters.push_back(t);
+		}
+	}
+	hardClusters.push_back(numTriangles);
+
+	//Soft boundaries: inside each hard cluster, end a cluster wherever its ACMR so far, counted from a flushed cache,
+	//is within threshold of the hard cluster's
+	std::vector<size_t> clusters;
+	for (size_t h = 0; h + 1 < hardClusters.size(); h++)
+	{
+		size_t start = hardClusters[h];
+		size_t end = hardClusters[h + 1];
+		cache.flush();
+		unsigned int hardMisses = 0;
+		for (size_t t = start; t < end; t++) {
+			hardMisses += cache.accessTriangle(&indices[t * 3]);
+		}
+		float limit = threshold * hardMisses / (end - start);
+
+		size_t clusterStart = start;
+		unsigned int clusterMisses = 0;
+		cache.flush();
+		for (size_t t = start; t < end; t++)
+		{
+			clusterMisses += cache.accessTriangle(&indices[t * 3]);
+			if ((float)clusterMisses / (t + 1 - clusterStart) <= limit) {
+				clusters.push_back(clusterStart);
+				clusterStart = t + 1;
+				clusterMisses = 0;
+				cache.flush();
+			}
+		}
+		if (clusterStart < end) {
+			clusters.push_back(clusterStart);
+		}
+	}
+	clusters.push_back(numTriangles);
+
+	//Area weighted centroid and normal of each cluster and of the whole mesh
+	size_t numClusters = clusters.size() - 1;
+	std::vector<glm::vec3> clusterCentroids(numClusters, glm::vec3(0.0f));
+	std::vector<glm::vec3> clusterNormals(numClusters, glm::vec3(0.0f));
+	glm::vec3 meshCentroid = glm::vec3(0.0f);
+	float meshArea = 0.0f;
+	for (size_t c = 0; c < numClusters; c++)
+	{
+		float clusterArea = 0.0f;
+		for (size_t t = clusters[c]; t < clusters[c + 1]; t++)
+		{
+			const glm::vec3& a = positions[indices[t * 3]];
+			const glm::vec3& b = positions[indices[t * 3 + 1]];
+			const glm::vec3& d = positions[indices[t * 3 + 2]];
+			glm::vec3 normal = glm::cross(b - a, d - a);
+			float area = glm::length(normal);
+			clusterCentroids[c] += (a + b + d) * (area / 3.0f);
+			clusterNormals[c] += normal;
+			clusterArea += area;
+		}
+		meshCentroid += clusterCentroids[c];
+		meshArea += clusterArea;
+		if (clusterArea > 0.0f) {
+			clusterCentroids[c] /= clusterArea;
+		}
+	}
+	if (meshArea > 0.0f) {
+		meshCentroid /= meshArea;
+	}
+
+	//Clusters far out along their own normal are in front of the rest of the mesh from most directions they're seen
+	std::vector<float> sortKeys(numClusters);
+	std::vector<size_t> order(numClusters);
+	for (size_t c = 0; c < numClusters; c++)
+	{
+		float normalLength = glm::length(clusterNormals[c]);
+		glm::vec3 normal = normalLength > 0.0f ? clusterNormals[c] / normalLength : glm::vec3(0.0f);
+		sortKeys[c] = glm::dot(clusterCentroids[c] - meshCentroid, normal);
+		order[c] = c;
+	}
+	std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return sortKeys[a] > sortKeys[b]; });
+
+	std::vector<unsigned int> output;
+	output.reserve(numTriangles * 3);
+	for (size_t c : order) {
+		output.insert(output.end(), indices.begin() + clusters[c] * 3, indices.begin() + clusters[c + 1] * 3);
+	}
+	indices.swap(output);
+}
+
+std::vector<unsigned int> simplifyMesh(const std::vector<unsigned int>& indices, const std::vector<glm::vec3>& positions,
+	size_t targetIndexCount, float maxError, float* resultError)
+{
+	size_t numVertices = positions.size();
+	size_t numTriangles = indices.size() / 3;
+	std::vector<unsigned int> triangles(indices.begin(), indices.begin() + numTriangles * 3);
+	std::vector<bool> triangleAlive(numTriangles, true);
+	size_t aliveIndices = numTriangles * 3;
+
+	//Quadric of every triangle's plane on each of its vertices
+	std::vector<Quadric> quadrics(numVertices);
+	std::vector<std::vector<unsigned int>> vertexTriangles(numVertices);
+	for (size_t t = 0; t < numTriangles; t++)
+	{
+		const glm::vec3& a = positions[triangles[t * 3]];
+		glm::vec3 normal = glm::cross(positions[triangles[t * 3 + 1]] - a, positions[triangles[t * 3 + 2]] - a);
+		float area = glm::length(normal);
+		if (area > 0.0f) {
+			normal /= area;
+		}
+		for (int i = 0; i < 3; i++)
+		{
+			quadrics[triangles[t * 3 + i]].addPlane(normal, -glm::dot(normal, a), area);
+			vertexTriangles[triangles[t * 3 + i]].push_back((unsigned int)t);
+		}
+	}
+
+	//Edges used by a single triangle are on a border, or on a seam where vertices are split for their attributes
+	std::vector<bool> locked(numVertices, false);
+	std::unordered_map<uint64_t, unsigned int> edgeUses;
+	for (size_t t = 0; t < numTriangles; t++)
+	{
+		for (int i = 0; i < 3; i++)
+		{
+			uint64_t a = triangles[t * 3 + i];
+			uint64_t b = triangles[t * 3 + (i + 1) % 3];
+			edgeUses[std::min(a, b) << 32 | std::max(a, b)]++;
+		}
+	}
+	for (const auto& edge : edgeUses)
+	{
+		if (edge.second == 1) {
+			locked[edge.first >> 32] = true;
+			locked[edge.first & 0xFFFFFFFFu] = true;
+		}
+	}
+	//Split vertices that aren't on a border, like the tip of the cone, would tear if only one of them moved
+	std::map<std::tuple<float, float, float>, unsigned int> firstAtPosition;
+	for (size_t v = 0; v < numVertices; v++)
+	{
+		auto inserted = firstAtPosition.insert({ std::make_tuple(positions[v].x, positions[v].y, positions[v].z), (unsigned int)v });
+		if (!inserted.second) {
+			locked[v] = true;
+			locked[inserted.first->second] = true;
+		}
+	}
+
+	std::vector<unsigned int> version(numVertices, 0);
+	std::vector<bool> removed(numVertices, false);
+	std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse>> collapses;
+	auto queueCollapse = [&](unsigned int from, unsigned int to)
+	{
+		if (locked[from]) {
+			return;
+		}
+		Quadric combined = quadrics[from];
+		combined.add(quadrics[to]);
+		float cost = combined.weight > 0.0 ? (float)std::max(0.0, combined.evaluate(positions[to]) / combined.weight) : 0.0f;
+		collapses.push({ cost, from, to, version[from], version[to] });
+	};
+	for (size_t t = 0; t < numTriangles; t++)
+	{
+		for (int i = 0; i < 3; i++)
+		{
+			unsigned int a = triangles[t * 3 + i];
+			unsigned int b = triangles[t * 3 + (i + 1) % 3];
+			queueCollapse(a, b);
+			queueCollapse(b, a);
+		}
+	}
+
+	std::vector<unsigned int> fromNeighbors;
+	std::vector<unsigned int> toNeighbors;
+	auto gatherNeighbors = [&](unsigned int v, std::vector<unsigned int>& neighbors)
+	{
+		neighbors.clear();
+		for (unsigned int t : vertexTriangles[v])
+		{
+			for (int i = 0; i < 3; i++) {
+				if (triangles[t * 3 + i] != v) {
+					neighbors.push_back(triangles[t * 3 + i]);
+				}
+			}
+		}
+		std::sort(neighbors.begin(), neighbors.end());
+		neighbors.erase(std::unique(neighbors.begin(), neighbors.end()), neighbors.end());
+	};
+
+	float maxCost = 0.0f;
+	while (aliveIndices > targetIndexCount && !collapses.empty())
+	{
+		Collapse collapse = collapses.top();
+		if (collapse.cost > maxError * maxError) {
+			break;
+		}
+		collapses.pop();
+		unsigned int from = collapse.from;
+		unsigned int to = collapse.to;
+		if (removed[from] || removed[to] || version[from] != collapse.fromVersion || version[to] != collapse.toVersion) {
+			continue;
+		}
+
+		//Each triangle on the edge removes one shared neighbor. Any more and the surface would pinch
+		gatherNeighbors(from, fromNeighbors);
+		gatherNeighbors(to, toNeighbors);
+		unsigned int sharedTriangles = 0;
+		for (unsigned int t : vertexTriangles[from]) {
+			const unsigned int* triangle = &triangles[t * 3];
+			sharedTriangles += triangle[0] == to || triangle[1] == to || triangle[2] == to;
+		}
+		std::vector<unsigned int> sharedNeighbors;
+		std::set_intersection(fromNeighbors.begin(), fromNeighbors.end(), toNeighbors.begin(), toNeighbors.end(),
+			std::back_inserter(sharedNeighbors));
+		if (sharedTriangles == 0 || sharedNeighbors.size() != sharedTriangles) {
+			continue;
+		}
+
+		//Triangles that stay must not flip over
+		bool flips = false;
+		for (unsigned int t : vertexTriangles[from])
+		{
+			const unsigned int* triangle = &triangles[t * 3];
+			if (triangle[0] == to || triangle[1] == to || triangle[2] == to) {
+				continue;
+			}
+			glm::vec3 before[3];
+			glm::vec3 after[3];
+			for (int i = 0; i < 3; i++) {
+				before[i] = positions[triangle[i]];
+				after[i] = triangle[i] == from ? positions[to] : before[i];
+			}
+			glm::vec3 normalBefore = glm::cross(before[1] - before[0], before[2] - before[0]);
+			glm::vec3 normalAfter = glm::cross(after[1] - after[0], after[2] - after[0]);
+			if (glm::dot(normalBefore, normalAfter) <= 0.0f) {
+				flips = true;
+				break;
+			}
+		}
+		if (flips) {
+			continue;
+		}
+
+		maxCost = std::max(maxCost, collapse.cost);
+		quadrics[to].add(quadrics[from]);
+		removed[from] = true;
+		for (unsigned int t : vertexTriangles[from])
+		{
+			unsigned int* triangle = &triangles[t * 3];
+			if (triangle[0] == to || triangle[1] == to || triangle[2] == to) {
+				triangleAlive[t] = false;
+				aliveIndices -= 3;
+				//Take it off the other two vertices too
+				for (int i = 0; i < 3; i++) {
+					if (triangle[i] != from) {
+						std::vector<unsigned int>& others = vertexTriangles[triangle[i]];
+						others.erase(std::find(others.begin(), others.end(), t));
+					}
+				}
+				continue;
+			}
+			for (int i = 0; i < 3; i++) {
+				if (triangle[i] == from) {
+					triangle[i] = to;
+				}
+			}
+			vertexTriangles[to].push_back(t);
+		}
+		vertexTriangles[from].clear();
+
+		//Costs involving to have changed
+		version[to]++;
+		gatherNeighbors(to, toNeighbors);
+		for (unsigned int neighbor : toNeighbors)
+		{
+			queueCollapse(to, neighbor);
+			queueCollapse(neighbor, to);
+		}
+	}
+
+	std::vector<unsigned int> result;
+	result.reserve(aliveIndices);
+	for (size_t t = 0; t < numTriangles; t++) {
+		if (triangleAlive[t]) {
+			result.insert(result.end(), &triangles[t * 3], &triangles[t * 3] + 3);
+		}
+	}
+	if (resultError) {
+		*resultError = sqrtf(maxCost);
+	}
+	return result;
+}
@@ -0,0 +1,135 @@
+#pragma once
+#include "Mesh.h"
+#include <vector>
+#include <float.h>
+
+//Cache size the statistics simulate. A FIFO of 16 entries is roughly what current GPUs reuse within a batch
+const unsigned int VERTEX_CACHE_ANALYZE_SIZE = 16;
+
+/// <summary>
+/// How well a triangle order reuses transformed vertices
+/// </summary>
+struct VertexCacheStats {
+	//Average cache miss ratio: vertices transformed per triangle. 0.5 is the best possible, 3 the worst
+	float acmr;
+	//Average transform to vertex ratio: vertices transformed per vertex used. 1 is the best possible
+	float atvr;
+};
+
+/// <summary>
+/// How many times each covered pixel is shaded, averaged over the six axis-aligned views of the mesh
+/// </summary>
+struct OverdrawStats {
+	//Pixels shaded per pixel covered. 1 means no overdraw
+	float overdraw;
+	unsigned int pixelsCovered;
+	unsigned int pixelsShaded;
+};
+
+//How much worse than the vertex cache optimized order optimizeOverdraw may make the ACMR of each cluster
+const float OVERDRAW_DEFAULT_THRESHOLD = 1.05f;
+
+//Statistics of a mesh before and after optimizeMesh
+struct MeshOptimizationStats {
+	VertexCacheStats before;
+	VertexCacheStats after;
+};
+
+//Simulates a FIFO post-transform cache over the index buffer
+VertexCacheStats analyzeVertexCache(const std::vector<unsigned int>& indices, size_t numVertices, unsigned int cacheSize = VERTEX_CACHE_ANALYZE_SIZE);
+
+//Reorders triangles so they reuse recently transformed vertices (Tom Forsyth's linear-speed vertex cache optimization)
+void optimizeVertexCache(std::vector<unsigned int>& indices, size_t numVertices);
+
+//Renumbers vertices in the order the indices first use them, so vertex fetches walk the buffer forward.
+//Rewrites the indices and returns the old index of each new vertex. Unused vertices are kept at the end
+std::vector<unsigned int> optimizeVertexFetchRemap(std::vector<unsigned int>& indices, size_t numVertices);
+
+//Rasterizes the mesh in index order on the CPU, with a depth test like GL_LESS, and counts the pixels shaded.
+//Set cullBackFaces to match GL_CULL_FACE. Counter-clockwise triangles face forward
+OverdrawStats analyzeOverdraw(const std::vector<unsigned int>& indices, const std::vector<glm::vec3>& positions, bool cullBackFaces);
+
+//Splits a vertex cache optimized triangle order into clusters, then draws the clusters facing out from the center
+//of the mesh first, so the front of a convex mesh fills the depth buffer before its back. Clusters only end where
+//restarting the vertex cache keeps their ACMR within threshold times what it was (1.05 allows 5% more transforms)
+void optimizeOverdraw(std::vector<unsigned int>& indices, const std::vector<glm::vec3>& positions, float threshold = OVERDRAW_DEFAULT_THRESHOLD);
+
+//Quadric error metric simplification (Garland & Heckbert). Collapses edges onto one of their vertices, cheapest
+//first, until at most targetIndexCount indices are left, the next collapse would cost more than maxError, or nothing
+//more can go. Only the indices change, so the
+//result draws from the same vertices. Vertices on a border or seam, or sharing a position with another vertex, are
+//never removed. resultError is set to the largest error of any collapse made: the root mean square distance from the
+//vertex kept to the planes of the triangles merged into it, in the units of positions
+std::vector<unsigned int> simplifyMesh(const std::vector<unsigned int>& indices, const std::vector<glm::vec3>& positions,
+	size_t targetIndexCount, float maxError = FLT_MAX, float* resultError = nullptr);
+
+template<typename V>
+std::vector<glm::vec3> getPositions(const BasicMeshData<V>& meshData)
+{
+	std::vector<glm::vec3> positions;
+	positions.reserve(meshData.vertices.size());
+	for (const V& vertex : meshData.vertices) {
+		positions.push_back(VertexFormat<V>::position(vertex));
+	}
+	return positions;
+}
+
+template<typename V>
+OverdrawStats analyzeOverdraw(const BasicMeshData<V>& meshData, bool cullBackFaces)
+{
+	return analyzeOverdraw(meshData.indices, getPositions(meshData), cullBackFaces);
+}
+
+//Runs the vertex cache pass, the overdraw pass if overdrawThreshold isn't 0, then the vertex fetch pass
+template<typename V>
+MeshOptimizationStats optimizeMesh(BasicMeshData<V>& meshData, float overdrawThreshold = 0.0f)
+{
+	MeshOptimizationStats stats;
+	stats.before = analyzeVertexCache(meshData.indices, meshData.vertices.size());
+
+	optimizeVertexCache(meshData.indices, meshData.vertices.size());
+	if (overdrawThreshold > 0.0f) {
+		optimizeOverdraw(meshData.indices, getPositions(meshData), overdrawThreshold);
+	}
+	std::vector<unsigned int> order = optimizeVertexFetchRemap(meshData.indices, meshData.vertices.size());
+	std::vector<V> vertices;
+	vertices.reserve(meshData.vertices.size());
+	for (unsigned int oldIndex : order) {
+		vertices.push_back(meshData.vertices[oldIndex]);
+	}
+	meshData.vertices.swap(vertices);
+
+	stats.after = analyzeVertexCache(meshData.indices, meshData.vertices.size());
+	return stats;
+}
+
+//Most a simplified level of detail may stray from the full mesh, as a fraction of its bounding radius
+const float LOD_MAX_SIMPLIFY_ERROR = 0.1f;
+
+//Levels of detail made by simplifyMesh, each with about ratio times the triangles of the one before, stopping
+//after maxLevels or once a level can't get smaller within maxRelativeError. Every level shares meshData's vertices
+template<typename V>
+BasicMeshLodChain<V> buildLodChain(const BasicMeshData<V>& meshData, int maxLevels, float ratio = 0.5f,
+	float maxRelativeError = LOD_MAX_SIMPLIFY_ERROR)
+{
+	BasicMeshLodChain<V> lodChain;
+	lodChain.vertices = meshData.vertices;
+	lodChain.levels.push_back({ meshData.indices, 0.0f });
+
+	std::vector<glm::vec3> positions = getPositions(meshData);
+	float radius = computeBoundingRadius(meshData.vertices);
+	while ((int)lodChain.levels.size() < maxLevels)
+	{
+		size_t previousCount = lodChain.levels.back().indices.size();
+		size_t target = (size_t)(previousCount / 3 * ratio) * 3;
+		float error = 0.0f;
+		//Always from the full mesh, so the error is measured against it
+		std::vector<unsigned int> indices = simplifyMesh(meshData.indices, positions, target, radius * maxRelativeError, &error);
+		if (indices.size() >= previousCount) {
+			break;
+		}
+		optimizeVertexCache(indices, positions.size());
+		lodChain.levels.push_back({ indices, radius > 0.0f ? error / radius : 0.0f });
+	}
+	return lodChain;
+}
@@ -0,0 +1,251 @@
+#include "Meshlets.h"
+#include <algorithm>
+#include <float.h>
+#include <math.h>
+
+namespace
+{
+	//Meshlet vertex index of each mesh vertex in the meshlet being built, or this if it isn't in it
+	const unsigned char NOT_IN_MESHLET = 0xFF;
+
+	//Bounding sphere and normal cone of the last meshlet in meshletData
+	void computeBounds(MeshletData& meshletData, const std::vector<glm::vec3>& positions)
+	{
+		Meshlet& meshlet = meshletData.meshlets.back();
+
+		//Center of the bounding box, which is close to the smallest sphere for the small clusters built here
+		glm::vec3 minBounds = glm::vec3(FLT_MAX);
+		glm::vec3 maxBounds = glm::vec3(-FLT_MAX);
+		for (unsigned int i = 0; i < meshlet.numVertices; i++)
+		{
+			const glm::vec3& position = positions[meshletData.vertices[meshlet.firstVertex + i]];
+			minBounds = glm::min(minBounds, position);
+			maxBounds = glm::max(maxBounds, position);
+		}
+		meshlet.center = (minBounds + maxBounds) * 0.5f;
+		meshlet.radius = 0.0f;
+		for (unsigned int i = 0; i < meshlet.numVertices; i++) {
+			meshlet.radius = std::max(meshlet.radius, glm::length(positions[meshletData.vertices[meshlet.firstVertex + i]] - meshlet.center));
+		}
+
+		std::vector<glm::vec3> normals;
+		normals.reserve(meshlet.numTriangles);
+		glm::vec3 axis = glm::vec3(0.0f);
+		for (unsigned int t = 0; t < meshlet.numTriangles; t++)
+		{
+			const unsigned char* triangle = &meshletData.triangles[(meshlet.firstTriangle + t) * 3];
+			const glm::vec3& a = positions[meshletData.vertices[meshlet.firstVertex + triangle[0]]];
+			const glm::vec3& b = positions[meshletData.vertices[meshlet.firstVertex + triangle[1]]];
+			const glm::vec3& c = positions[meshletData.vertices[meshlet.firstVertex + triangle[2]]];
+			glm::vec3 normal = glm::cross(b - a, c - a);
+			float length = glm::length(normal);
+			if (length > 0.0f) {
+				normals.push_back(normal / length);
+				axis += normals.back();
+			}
+		}
+
+		float axisLength = glm::length(axis);
+		meshlet.coneAxis = axisLength > 0.0f ? axis / axisLength : glm::vec3(0.0f, 0.0f, 1.0f);
+		meshlet.coneCutoff = 1.0f;
+		if (axisLength == 0.0f) {
+			return;
+		}
+		float minDot = 1.0f;
+		for (const glm::vec3& normal : normals) {
+			minDot = std::min(minDot, glm::dot(normal, meshlet.coneAxis));
+		}
+		//A cone wider than a hemisphere faces the camera from everywhere
+		if (minDot > 0.0f) {
+			meshlet.coneCutoff = sqrtf(1.0f - minDot * minDot);
+		}
+	}
+}
+
+Frustum::Frustum(const glm::mat4& viewProjection)
+{
+	glm::mat4 m = glm::transpose(viewProjection);
+	planes[0] = m[3] + m[0];
+	planes[1] = m[3] - m[0];
+	planes[2] = m[3] + m[1];
+	planes[3] = m[3] - m[1];
+	planes[4] = m[3] + m[2];
+	planes[5] = m[3] - m[2];
+	for (glm::vec4& plane : planes) {
+		plane /= glm::length(glm::vec3(plane));
+	}
+}
+
+bool Frustum::intersectsSphere(const glm::vec3& center, float radius) const
+{
+	for (const glm::vec4& plane : planes)
+	{
+		if (glm::dot(glm::vec3(plane), center) + plane.w < -radius) {
+			return false;
+		}
+	}
+	return true;
+}
+
+MeshletData buildMeshlets(const std::vector<unsigned int>& indices, const std::vector<glm::vec3>& positions)
+{
+	MeshletData meshletData;
+	size_t numTriangles = indices.size() / 3;
+	if (numTriangles == 0) {
+		return meshletData;
+	}
+
+	//Triangles using each vertex, packed into one array
+	std::vector<unsigned int> firstTriangle(positions.size() + 1, 0);
+	for (size_t i = 0; i < numTriangles * 3; i++) {
+		firstTriangle[indices[i] + 1]++;
+	}
+	for (size_t v = 0; v < positions.size(); v++) {
+		firstTriangle[v + 1] += firstTriangle[v];
+	}
+	std::vector<unsigned int> vertexTriangles(numTriangles * 3);
+	std::vector<unsigned int> filled(positions.size(), 0);
+	for (size_t i = 0; i < numTriangles * 3; i++) {
+		unsigned int v = indices[i];
+		vertexTriangles[firstTriangle[v] + filled[v]++] = (unsigned int)(i / 3);
+	}
+
+	std::vector<glm::vec3> triangleCenters(numTriangles);
+	for (size_t t = 0; t < numTriangles; t++) {
+		triangleCenters[t] = (positions[indices[t * 3]] + positions[indices[t * 3 + 1]] + positions[indices[t * 3 + 2]]) / 3.0f;
+	}
+
+	std::vector<bool> emitted(numTriangles, false);
+	std::vector<unsigned char> meshletIndex(positions.size(), NOT_IN_MESHLET);
+	std::vector<unsigned int> candidates;
+	glm::vec3 centroidSum = glm::vec3(0.0f);
+	size_t nextSeed = 0;
+	size_t numEmitted = 0;
+
+	auto startMeshlet = [&]()
+	{
+		if (!meshletData.meshlets.empty()) {
+			computeBounds(meshletData, positions);
+			const Meshlet& last = meshletData.meshlets.back();
+			for (unsigned int i = 0; i < last.numVertices; i++) {
+				meshletIndex[meshletData.vertices[last.firstVertex + i]] = NOT_IN_MESHLET;
+			}
+		}
+		Meshlet meshlet = {};
+		meshlet.firstVertex = (unsigned int)meshletData.vertices.size();
+		meshlet.firstTriangle = (unsigned int)(meshletData.triangles.size() / 3);
+		meshletData.meshlets.push_back(meshlet);
+		candidates.clear();
+		centroidSum = glm::vec3(0.0f);
+	};
+	auto newVertexCount = [&](unsigned int t)
+	{
+		unsigned int count = 0;
+		for (int i = 0; i < 3; i++) {
+			count += meshletIndex[indices[t * 3 + i]] == NOT_IN_MESHLET;
+		}
+		return count;
+	};
+
+	auto addTriangle = [&](unsigned int t)
+	{
+		Meshlet& meshlet = meshletData.meshlets.back();
+		for (int i = 0; i < 3; i++)
+		{
+			unsigned int v = indices[t * 3 + i];
+			if (meshletIndex[v] == NOT_IN_MESHLET) {
+				meshletIndex[v] = (unsigned char)meshlet.numVertices++;
+				meshletData.vertices.push_back(v);
+				candidates.insert(candidates.end(), vertexTriangles.begin() + firstTriangle[v], vertexTriangles.begin() + firstTriangle[v + 1]);
+			}
+			meshletData.triangles.push_back(meshletIndex[v]);
+		}
+		centroidSum += triangleCenters[t];
+		meshlet.numTriangles++;
+		emitted[t] = true;
+		numEmitted++;
+	};
+
+	startMeshlet();
+	while (numEmitted < numTriangles)
+	{
+		const Meshlet& meshlet = meshletData.meshlets.back();
+
+		//Best neighbour: fewest new vertices, then closest to the meshlet's centroid
+		int best = -1;
+		unsigned int bestNew = 4;
+		float bestDistance = FLT_MAX;
+		glm::vec3 centroid = meshlet.numTriangles > 0 ? centroidSum / (float)meshlet.numTriangles : glm::vec3(0.0f);
+		//Emitted candidates are dropped as they're passed
+		size_t numCandidates = 0;
+		for (unsigned int t : candidates)
+		{
+			if (emitted[t]) {
+				continue;
+			}
+			candidates[numCandidates++] = t;
+			unsigned int numNew = newVertexCount(t);
+			if (numNew > bestNew) {
+				continue;
+			}
+			float distance = glm::length(triangleCenters[t] - centroid);
+			if (numNew < bestNew || distance < bestDistance) {
+				best = (int)t;
+				bestNew = numNew;
+				bestDistance = distance;
+			}
+		}
+		candidates.resize(numCandidates);
+		if (best < 0) {
+			//Nothing connected is left, carry on from the first unused triangle
+			while (emitted[nextSeed]) {
+				nextSeed++;
+			}
+			best = (int)nextSeed;
+			bestNew = newVertexCount(best);
+		}
+
+		//Full, so the best triangle seeds the next meshlet right beside this one
+		if (meshlet.numVertices + bestNew > MESHLET_MAX_VERTICES || meshlet.numTriangles + 1 > MESHLET_MAX_TRIANGLES) {
+			startMeshlet();
+		}
+
+		addTriangle((unsigned int)best);
+	}
+	computeBounds(meshletData, positions);
+	return meshletData;
+}
+
+size_t cullMeshlets(const MeshletData& meshletData, const glm::mat4& model, const glm::mat4& viewProjection,
+	const glm::vec3& cameraPosition, std::vector<unsigned int>& indices)
+{
+	Frustum frustum(viewProjection);
+	glm::mat3 rotationScale = glm::mat3(model);
+	float scale = glm::length(rotationScale[0]);
+	size_t kept = 0;
+
+	for (const Meshlet& meshlet : meshletData.meshlets)
+	{
+		glm::vec3 center = glm::vec3(model * glm::vec4(meshlet.center, 1.0f));
+		float radius = meshlet.radius * scale;
+		if (!frustum.intersectsSphere(center, radius)) {
+			continue;
+		}
+
+		//Back facing if the camera is behind every triangle's plane, tested against the whole bounding sphere
+		if (meshlet.coneCutoff < 1.0f) {
+			glm::vec3 axis = glm::normalize(rotationScale * meshlet.coneAxis);
+			glm::vec3 toCenter = center - cameraPosition;
+			if (glm::dot(toCenter, axis) >= meshlet.coneCutoff * glm::length(toCenter) + radius) {
+				continue;
+			}
+		}
+
+		for (unsigned int t = 0; t < meshlet.numTriangles * 3; t++) {
+			unsigned char local = meshletData.triangles[meshlet.firstTriangle * 3 + t];
+			indices.push_back(meshletData.vertices[meshlet.firstVertex + local]);
+		}
+		kept++;
+	}
+	return kept;
+}
@@ -0,0 +1,63 @@
+#pragma once
+#include "MeshOptimizer.h"
+#include <glm/glm.hpp>
+#include <vector>
+
+//Cluster limits. 124 triangles (not 128) keeps the local index data of a full meshlet a multiple of 4 bytes
+const unsigned int MESHLET_MAX_VERTICES = 64;
+const unsigned int MESHLET_MAX_TRIANGLES = 124;
+
+/// <summary>
+/// A small cluster of triangles, with bounds for culling it as a whole
+/// </summary>
+struct Meshlet {
+	//Ranges of MeshletData::vertices and MeshletData::triangles
+	unsigned int firstVertex;
+	unsigned int numVertices;
+	unsigned int firstTriangle;
+	unsigned int numTriangles;
+
+	//Bounding sphere
+	glm::vec3 center;
+	float radius;
+
+	//Every triangle's normal is within the cone around coneAxis. coneCutoff is the sine of the cone's half angle,
+	//or 1 (never culled) if the normals spread too far for the cone to cull anything
+	glm::vec3 coneAxis;
+	float coneCutoff;
+};
+
+/// <summary>
+/// A mesh split into meshlets
+/// </summary>
+struct MeshletData {
+	std::vector<Meshlet> meshlets;
+	//Mesh vertex index of each meshlet vertex
+	std::vector<unsigned int> vertices;
+	//Three meshlet vertex indices per triangle
+	std::vector<unsigned char> triangles;
+};
+
+/// <summary>
+/// The six planes of a view frustum, pointing in, taken from a view projection matrix (Gribb and Hartmann)
+/// </summary>
+struct Frustum {
+	explicit Frustum(const glm::mat4& viewProjection);
+	bool intersectsSphere(const glm::vec3& center, float radius) const;
+	glm::vec4 planes[6];
+};
+
+//Grows each meshlet from a seed triangle, adding the neighbouring triangle that needs the fewest new vertices, so
+//meshlets come out compact and their normal cones tight
+MeshletData buildMeshlets(const std::vector<unsigned int>& indices, const std::vector<glm::vec3>& positions);
+
+template<typename V>
+MeshletData buildMeshlets(const BasicMeshData<V>& meshData)
+{
+	return buildMeshlets(meshData.indices, getPositions(meshData));
+}
+
+//Appends the mesh indices of every meshlet that is inside the frustum and not facing away from the camera.
+//model may rotate, translate and scale uniformly. Returns how many meshlets were kept
+size_t cullMeshlets(const MeshletData& meshletData, const glm::mat4& model, const glm::mat4& viewProjection,
+	const glm::vec3& cameraPosition, std::vector<unsigned int>& indices);
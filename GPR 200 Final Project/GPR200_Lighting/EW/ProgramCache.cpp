@@ -0,0 +1,182 @@
+#include "ProgramCache.h"
+#include "GLState.h"
+#include <filesystem>
+#include <fstream>
+#include <vector>
+#include <stdio.h>
+
+namespace
+{
+	const uint32_t PROGRAM_CACHE_MAGIC = 0x42505745; //"EWPB"
+	const uint32_t PROGRAM_CACHE_VERSION = 1;
+
+	struct ProgramCacheHeader
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint64_t key;
+		uint32_t format;
+		uint32_t length;
+	};
+
+	bool supportsProgramBinaries()
+	{
+		if (!GLEW_VERSION_4_1 && !GLEW_ARB_get_program_binary) {
+			return false;
+		}
+		//Drivers are allowed to support the entry points with zero binary formats
+		GLint numFormats = 0;
+		glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &numFormats);
+		return numFormats > 0;
+	}
+
+	std::string glString(GLenum name)
+	{
+		const GLubyte* str = glGetString(name);
+		return str ? std::string((const char*)str) : std::string();
+	}
+}
+
+std::string ProgramCache::sDirectory;
+
+void ProgramCache::setDirectory(const std::string& directory)
+{
+	sDirectory = directory;
+	if (sDirectory.empty()) {
+		return;
+	}
+	if (!supportsProgramBinaries()) {
+		printf("Program binaries are not supported by this driver, program cache disabled\n");
+		sDirectory.clear();
+		return;
+	}
+	std::error_code error;
+	std::filesystem::create_directories(sDirectory, error);
+	if (error) {
+		printf("Failed to create program cache directory %s: %s\n", sDirectory.c_str(), error.message().c_str());
+		sDirectory.clear();
+	}
+}
+
+bool ProgramCache::isEnabled()
+{
+	return !sDirectory.empty();
+}
+
+uint64_t ProgramCache::makeKey(const std::string& vertexSource, const std::string& fragmentSource, const std::string& defines)
+{
+	//Separators keep ("ab","c") and ("a","bc") from hashing the same
+	uint64_t key = FNV64_OFFSET_BASIS;
+	key = hashString64(glString(GL_VENDOR), key);
+	key = hashString64(std::string_view("\0", 1), key);
+	key = hashString64(glString(GL_RENDERER), key);
+	key = hashString64(std::string_view("\0", 1), key);
+	key = hashString64(glString(GL_VERSION), key);
+	key = hashString64(std::string_view("\0", 1), key);
+	key = hashString64(defines, key);
+	key = hashString64(std::string_view("\0", 1), key);
+	key = hashString64(vertexSource, key);
+	key = hashString64(std::string_view("\0", 1), key);
+	key = hashString64(fragmentSource, key);
+	return key;
+}
+
+std::string ProgramCache::entryPath(uint64_t key)
+{
+	char fileName[32];
+	snprintf(fileName, sizeof(fileName), "%016llx.bin", (unsigned long long)key);
+	return (std::filesystem::path(sDirectory) / fileName).string();
+}
+
+GLuint ProgramCache::load(uint64_t key, bool separable)
+{
+	if (!isEnabled()) {
+		return 0;
+	}
+	std::string path = entryPath(key);
+	std::ifstream file(path, std::ios::binary);
+	if (!file.is_open()) {
+		return 0;
+	}
+
+	ProgramCacheHeader header = {};
+	file.read((char*)&header, sizeof(header));
+	std::vector<char> binary;
+	bool valid = file.good() && header.magic == PROGRAM_CACHE_MAGIC && header.version == PROGRAM_CACHE_VERSION && header.key == key;
+	//The binary is the rest of the file. A length that disagrees means a corrupt entry, so don't allocate for it
+	std::error_code sizeError;
+	uintmax_t fileSize = std::filesystem::file_size(path, sizeError);
+	valid = valid && !sizeError && fileSize - sizeof(header) == header.length;
+	if (valid) {
+		binary.resize(header.length);
+		file.read(binary.data(), header.length);
+		valid = file.good() && file.peek() == EOF;
+	}
+	file.close();
+
+	GLuint program = 0;
+	if (valid) {
+		program = glCreateProgram();
+		if (separable) {
+			glProgramParameteri(program, GL_PROGRAM_SEPARABLE, GL_TRUE);
+		}
+		glProgramBinary(program, (GLenum)header.format, binary.data(), (GLsizei)binary.size());
+		//The driver rejects binaries it didn't produce or no longer accepts
+		GLint success = 0;
+		glGetProgramiv(program, GL_LINK_STATUS, &success);
+		if (!success) {
+			GLState::deleteProgram(program);
+			program = 0;
+			valid = false;
+		}
+	}
+
+	if (!valid) {
+		std::error_code error;
+		std::filesystem::remove(path, error);
+	}
+	return program;
+}
+
+void ProgramCache::store(GLuint program, uint64_t key)
+{
+	if (!isEnabled()) {
+		return;
+	}
+	GLint length = 0;
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (length <= 0) {
+		return;
+	}
+
+	ProgramCacheHeader header = {};
+	std::vector<char> binary(length);
+	GLenum format = 0;
+	glGetProgramBinary(program, length, &length, &format, binary.data());
+	header.magic = PROGRAM_CACHE_MAGIC;
+	header.version = PROGRAM_CACHE_VERSION;
+	header.key = key;
+	header.format = format;
+	header.length = (uint32_t)length;
+
+	//Write to a temporary file and rename, so a crash or another process never sees a partial entry
+	std::string path = entryPath(key);
+	std::string tempPath = path + ".tmp";
+	std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+	if (!file.is_open()) {
+		return;
+	}
+	file.write((const char*)&header, sizeof(header));
+	file.write(binary.data(), length);
+	file.close();
+
+	std::error_code error;
+	if (file.fail()) {
+		std::filesystem::remove(tempPath, error);
+		return;
+	}
+	std::filesystem::rename(tempPath, path, error);
+	if (error) {
+		std::filesystem::remove(tempPath, error);
+	}
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include "GL/glew.h"
+#include <string>
+#include <string_view>
+#include <cstdint>
+
+const uint64_t FNV64_OFFSET_BASIS = 14695981039346656037ull;
+
+//FNV-1a 64 bit. Pass a previous result as the seed to hash several strings together
+constexpr uint64_t hashString64(std::string_view str, uint64_t seed = FNV64_OFFSET_BASIS)
+{
+	uint64_t hash = seed;
+	for (char c : str) {
+		hash ^= (uint8_t)c;
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+/// <summary>
+/// Stores linked programs on disk with glGetProgramBinary and reloads them with glProgramBinary.
+/// Entries are keyed by the shader sources, their defines and the driver, so a driver update invalidates them.
+/// </summary>
+class ProgramCache
+{
+public:
+	//Empty directory disables the cache
+	static void setDirectory(const std::string& directory);
+	static bool isEnabled();
+	static uint64_t makeKey(const std::string& vertexSource, const std::string& fragmentSource, const std::string& defines);
+	//Returns 0 when there is no usable entry. A corrupt or rejected entry is deleted.
+	//separable must match how the cached program was linked
+	static GLuint load(uint64_t key, bool separable = false);
+	static void store(GLuint program, uint64_t key);
+private:
+	static std::string entryPath(uint64_t key);
+	static std::string sDirectory;
+};
@@ -0,0 +1,153 @@
+#include "RenderQueue.h"
+#include "GLState.h"
+#include <string.h>
+
+namespace
+{
+	const uint64_t SORT_KEY_ID_MASK = (1ull << SORT_KEY_ID_BITS) - 1;
+	const uint64_t SORT_KEY_DEPTH_MASK = (1ull << SORT_KEY_DEPTH_BITS) - 1;
+	const uint64_t SORT_KEY_TRANSPARENT_BIT = 1ull << 63;
+
+	//The radix sort takes 8 bits per pass
+	const int RADIX_BITS = 8;
+	const int RADIX_BUCKETS = 1 << RADIX_BITS;
+
+	//Positive floats order the same as their bit patterns, so the top bits are a depth that sorts as an integer
+	uint64_t quantizeDepth(float depth)
+	{
+		if (!(depth > 0.0f)) {
+			return 0;
+		}
+		uint32_t bits;
+		memcpy(&bits, &depth, sizeof(bits));
+		return (bits >> (31 - SORT_KEY_DEPTH_BITS)) & SORT_KEY_DEPTH_MASK;
+	}
+}
+
+//Opaque:      0 | shader | material | mesh | depth
+//Transparent: 1 | inverted depth | shader | material | mesh
+uint64_t RenderQueue::makeSortKey(uint32_t shaderId, uint32_t materialId, uint32_t meshId, float depth, bool transparent)
+{
+	uint64_t state = ((shaderId & SORT_KEY_ID_MASK) << (2 * SORT_KEY_ID_BITS)) | ((materialId & SORT_KEY_ID_MASK) << SORT_KEY_ID_BITS) |
+		(meshId & SORT_KEY_ID_MASK);
+	uint64_t quantized = quantizeDepth(depth);
+	if (transparent) {
+		return SORT_KEY_TRANSPARENT_BIT | ((SORT_KEY_DEPTH_MASK - quantized) << (3 * SORT_KEY_ID_BITS)) | state;
+	}
+	return (state << SORT_KEY_DEPTH_BITS) | quantized;
+}
+
+uint32_t RenderQueue::getId(std::unordered_map<const void*, uint32_t>& ids, const void* object)
+{
+	if (!object) {
+		return 0;
+	}
+	auto id = ids.emplace(object, (uint32_t)ids.size() + 1);
+	return id.first->second;
+}
+
+void RenderQueue::clear()
+{
+	mItems.clear();
+	mKeys.clear();
+	mOrder.clear();
+}
+
+void RenderQueue::submit(const RenderItem& item)
+{
+	mOrder.push_back((uint32_t)mItems.size());
+	mItems.push_back(item);
+	mKeys.push_back(makeSortKey(getId(mShaderIds, item.shader), getId(mMaterialIds, item.material), getId(mMeshIds, item.mesh),
+		item.depth, item.transparent));
+}
+
+void RenderQueue::submit(Mesh* mesh, Shader* shader, UniformBuffer* material, const glm::mat4& model, float depth, int lod,
+	bool transparent)
+{
+	submit({ mesh, lod, shader, material, model, depth, transparent, nullptr, 0 });
+}
+
+void RenderQueue::submitInstanced(Mesh* mesh, Shader* shader, UniformBuffer* material, const InstanceBuffer* instances,
+	GLsizei instanceCount, float depth, int lod, bool transparent)
+{
+	submit({ mesh, lod, shader, material, glm::mat4(1.0f), depth, transparent, instances, instanceCount });
+}
+
+//LSD radix sort of (key, item) pairs, 8 bits at a time. It is stable, so equal keys draw in submission order.
+//Passes where every key has the same digit are skipped, which with few shaders, materials and meshes is most of them
+void RenderQueue::sort()
+{
+	size_t count = mOrder.size();
+	std::vector<uint64_t>& keys = mKeys;
+	mSortedKeys.resize(count);
+	mSortedOrder.resize(count);
+
+	for (int shift = 0; shift < 64; shift += RADIX_BITS)
+	{
+		size_t offsets[RADIX_BUCKETS] = {};
+		for (size_t i = 0; i < count; i++) {
+			offsets[(keys[i] >> shift) & (RADIX_BUCKETS - 1)]++;
+		}
+		if (count == 0 || offsets[(keys[0] >> shift) & (RADIX_BUCKETS - 1)] == count) {
+			continue;
+		}
+		size_t total = 0;
+		for (size_t& offset : offsets)
+		{
+			size_t bucketSize = offset;
+			offset = total;
+			total += bucketSize;
+		}
+		for (size_t i = 0; i < count; i++)
+		{
+			size_t destination = offsets[(keys[i] >> shift) & (RADIX_BUCKETS - 1)]++;
+			mSortedKeys[destination] = keys[i];
+			mSortedOrder[destination] = mOrder[i];
+		}
+		keys.swap(mSortedKeys);
+		mOrder.swap(mSortedOrder);
+	}
+}
+
+RenderQueueStats RenderQueue::execute(bool drawAsPoints)
+{
+	constexpr UniformKey modelKey("uModel");
+	mStats = {};
+	Shader* shader = nullptr;
+	UniformBuffer* material = nullptr;
+	Mesh* mesh = nullptr;
+	bool transparentPass = false;
+	GLState::apply(OPAQUE_RENDER_STATE);
+	for (uint32_t index : mOrder)
+	{
+		const RenderItem& item = mItems[index];
+		if (item.transparent && !transparentPass) {
+			GLState::apply(TRANSPARENT_RENDER_STATE);
+			transparentPass = true;
+		}
+		if (item.shader != shader) {
+			item.shader->use();
+			shader = item.shader;
+			mStats.programSwitches++;
+		}
+		if (item.material && item.material != material) {
+			item.material->bind();
+			material = item.material;
+			mStats.materialSwitches++;
+		}
+		if (item.mesh != mesh) {
+			item.mesh->bind();
+			mesh = item.mesh;
+			mStats.vertexArraySwitches++;
+		}
+		if (item.instances) {
+			item.mesh->drawInstanced(*item.instances, item.instanceCount, drawAsPoints, item.lod);
+		}
+		else {
+			item.shader->setMat4(modelKey, item.model);
+			item.mesh->drawBound(drawAsPoints, item.lod);
+		}
+		mStats.draws++;
+	}
+	return mStats;
+}
@@ -0,0 +1,82 @@
+#pragma once
+#include "GL/glew.h"
+#include <glm/glm.hpp>
+#include <vector>
+#include <unordered_map>
+#include <stdint.h>
+#include "Mesh.h"
+#include "Shader.h"
+#include "UniformBuffer.h"
+#include "InstanceBuffer.h"
+
+//Bits of the sort key given to each shader, material and mesh id, and to depth. Ids past what fits wrap around,
+//which only costs extra switches
+const int SORT_KEY_ID_BITS = 12;
+const int SORT_KEY_DEPTH_BITS = 24;
+
+/// <summary>
+/// One draw submitted to a RenderQueue
+/// </summary>
+struct RenderItem {
+	Mesh* mesh;
+	int lod;
+	Shader* shader;
+	//Bound to its binding point (MATERIAL_BLOCK_BINDING) before drawing. nullptr keeps whatever is bound
+	UniformBuffer* material;
+	//Set as uModel. Unused when drawing instances
+	glm::mat4 model;
+	//How far in front of the camera (see WB::Camera::getViewDepth)
+	float depth;
+	//Drawn after every opaque item, back to front
+	bool transparent;
+	//If set, drawn with Mesh::drawInstanced instead
+	const InstanceBuffer* instances;
+	GLsizei instanceCount;
+};
+
+/// <summary>
+/// How often executing a RenderQueue changed GL state
+/// </summary>
+struct RenderQueueStats {
+	unsigned int draws;
+	unsigned int programSwitches;
+	unsigned int vertexArraySwitches;
+	unsigned int materialSwitches;
+};
+
+/// <summary>
+/// Draws submitted in any order, sorted by a 64 bit key so draws sharing a shader, then a material, then a mesh
+/// run together and state only changes between runs. Opaque items come first, sorted by shader, material, mesh,
+/// then front to back. Transparent items follow, back to front
+/// </summary>
+class RenderQueue {
+public:
+	void clear();
+	void submit(const RenderItem& item);
+	void submit(Mesh* mesh, Shader* shader, UniformBuffer* material, const glm::mat4& model, float depth, int lod = 0,
+		bool transparent = false);
+	void submitInstanced(Mesh* mesh, Shader* shader, UniformBuffer* material, const InstanceBuffer* instances,
+		GLsizei instanceCount, float depth, int lod = 0, bool transparent = false);
+	//Radix sorts the items by key. Without it, execute() draws them in the order they were submitted
+	void sort();
+	//Per-frame uniforms (uProjection, uView...) should already be set on every shader submitted. Opaque items draw with
+	//OPAQUE_RENDER_STATE and transparent ones with TRANSPARENT_RENDER_STATE
+	RenderQueueStats execute(bool drawAsPoints = false);
+	size_t getItemCount() const { return mItems.size(); }
+	const RenderQueueStats& getStats() const { return mStats; }
+	static uint64_t makeSortKey(uint32_t shaderId, uint32_t materialId, uint32_t meshId, float depth, bool transparent);
+private:
+	uint32_t getId(std::unordered_map<const void*, uint32_t>& ids, const void* object);
+	std::vector<RenderItem> mItems;
+	//Indices into mItems in the order they are drawn, and the key of each. Sorting moves both together,
+	//then swaps them with the scratch space below
+	std::vector<uint32_t> mOrder;
+	std::vector<uint64_t> mKeys;
+	std::vector<uint64_t> mSortedKeys;
+	std::vector<uint32_t> mSortedOrder;
+	//Ids are handed out on first submission and kept, so the order stays the same from frame to frame. 0 is nullptr
+	std::unordered_map<const void*, uint32_t> mShaderIds;
+	std::unordered_map<const void*, uint32_t> mMaterialIds;
+	std::unordered_map<const void*, uint32_t> mMeshIds;
+	RenderQueueStats mStats = {};
+};
@@ -1,6 +1,13 @@
 #include "Shader.h"
+#include "GLState.h"
+#include "UniformBuffer.h"
+#include "ProgramCache.h"
+#include "EmbeddedShaders.h"
 #include <fstream>
 #include <sstream>
+#include <algorithm>
+#include <filesystem>
+#include <cstring>
 
 #include <glm/vec3.hpp> // glm::vec3
 #include <glm/vec4.hpp> // glm::vec4
@@ -8,70 +15,750 @@
 #include <glm/ext/matrix_transform.hpp> // glm::translate, glm::rotate, glm::scale
 #include <glm/gtc/type_ptr.hpp>
 
-Shader::Shader(std::string vertexShaderPath, std::string fragmentShaderPath)
+namespace
 {
-	std::string vertexShaderString = readFile(vertexShaderPath);
-	GLuint vertexShader = compileShader(vertexShaderString.c_str(), GL_VERTEX_SHADER);
+	//Nested #includes deeper than this are assumed to be a cycle
+	const int MAX_INCLUDE_DEPTH = 16;
 
-	std::string fragmentShaderString = readFile(fragmentShaderPath);
-	GLuint fragmentShader = compileShader(fragmentShaderString.c_str(), GL_FRAGMENT_SHADER);
+	//Embedded shaders get paths as if they were read from here, so #includes and the shader watcher work the same
+	const std::string EMBEDDED_SHADER_DIRECTORY = "shaders/";
 
-	//Create an empty shader program
-	m_id = glCreateProgram();
+	void sortDefines(ShaderDefines& defines)
+	{
+		std::stable_sort(defines.begin(), defines.end(),
+			[](const std::pair<std::string, std::string>& a, const std::pair<std::string, std::string>& b) { return a.first < b.first; });
+	}
+
+	std::string makeDefineKey(const ShaderDefines& defines)
+	{
+		std::string key;
+		for (const std::pair<std::string, std::string>& define : defines) {
+			key += define.first + "=" + define.second + "\n";
+		}
+		return key;
+	}
+
+	//Bytes kept for the last value of a uniform of this type. Only the types the setters can write need an exact size
+	uint32_t uniformValueSize(GLenum type)
+	{
+		switch (type) {
+		case GL_FLOAT_VEC2: return sizeof(glm::vec2);
+		case GL_FLOAT_VEC3: return sizeof(glm::vec3);
+		case GL_FLOAT_VEC4: return sizeof(glm::vec4);
+		case GL_FLOAT_MAT3: return sizeof(glm::mat3);
+		case GL_FLOAT_MAT4: return sizeof(glm::mat4);
+		default: return sizeof(float);
+		}
+	}
+
+	//True if name appears in source as a whole identifier
+	bool containsIdentifier(const std::string& source, const std::string& name)
+	{
+		auto isIdentifierChar = [](char c) { return isalnum((unsigned char)c) || c == '_'; };
+		for (size_t position = source.find(name); position != std::string::npos; position = source.find(name, position + 1))
+		{
+			size_t end = position + name.size();
+			if ((position == 0 || !isIdentifierChar(source[position - 1])) && (end == source.size() || !isIdentifierChar(source[end]))) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	uint64_t hashSources(const std::string& vertexSource, const std::string& fragmentSource)
+	{
+		return hashString64(fragmentSource, hashString64(std::string_view("\0", 1), hashString64(vertexSource)));
+	}
+
+	//GLSL spelling of the types vertex inputs can have, for mismatch reports
+	std::string glslTypeName(GLenum type)
+	{
+		switch (type) {
+		case GL_FLOAT: return "float";
+		case GL_FLOAT_VEC2: return "vec2";
+		case GL_FLOAT_VEC3: return "vec3";
+		case GL_FLOAT_VEC4: return "vec4";
+		case GL_INT: return "int";
+		case GL_INT_VEC2: return "ivec2";
+		case GL_INT_VEC3: return "ivec3";
+		case GL_INT_VEC4: return "ivec4";
+		case GL_UNSIGNED_INT: return "uint";
+		case GL_UNSIGNED_INT_VEC4: return "uvec4";
+		case GL_FLOAT_MAT3: return "mat3";
+		case GL_FLOAT_MAT4: return "mat4";
+		default: {
+			char hex[16];
+			snprintf(hex, sizeof(hex), "0x%04X", type);
+			return hex;
+		}
+		}
+	}
+}
+
+std::vector<Shader*> Shader::s_pendingShaders;
+bool Shader::s_hasCompletionStatus = false;
+UniformCallStats Shader::s_uniformStats = { 0, 0 };
+bool Shader::s_separable = false;
+std::map<std::string, std::weak_ptr<Shader>> Shader::s_stages;
+std::map<std::pair<const Shader*, const Shader*>, Shader::ProgramPipeline> Shader::s_pipelines;
+std::string Shader::s_embeddedOverrideDirectory;
+
+Shader::Shader(std::string vertexShaderPath, std::string fragmentShaderPath, const ShaderDefines& defines, bool async)
+	: Shader(0, vertexShaderPath, fragmentShaderPath, defines, async, false)
+{
+}
+
+Shader Shader::fromEmbedded(const std::string& vertexShaderName, const std::string& fragmentShaderName, const ShaderDefines& defines, bool async)
+{
+	return Shader(0, EMBEDDED_SHADER_DIRECTORY + vertexShaderName, EMBEDDED_SHADER_DIRECTORY + fragmentShaderName, defines, async, true);
+}
+
+void Shader::setEmbeddedOverrideDirectory(const std::string& directory)
+{
+	s_embeddedOverrideDirectory = directory;
+}
+
+//stage 0 builds a regular program, or a pipeline of shared stages once separable programs are enabled
+Shader::Shader(GLenum stage, std::string vertexShaderPath, std::string fragmentShaderPath, const ShaderDefines& defines, bool async, bool embedded)
+{
+	m_stage = stage;
+	m_embedded = embedded;
+	m_vertexPath = vertexShaderPath;
+	m_fragmentPath = fragmentShaderPath;
+	m_defines = defines;
+	sortDefines(m_defines);
+	m_defineKey = makeDefineKey(m_defines);
+	m_async = async;
+	m_readyFuture = m_readyPromise.get_future().share();
+
+	//Lookups before the program has linked find nothing rather than reading an empty table
+	m_uniforms.assign(1, UniformSlot{ 0, 0, 0, -1, 0, 0, 0, false });
+
+	if (stage == 0 && s_separable) {
+		m_vertexStage = getStage(GL_VERTEX_SHADER, vertexShaderPath, m_defines, async, embedded);
+		m_fragmentStage = getStage(GL_FRAGMENT_SHADER, fragmentShaderPath, m_defines, async, embedded);
+		std::pair<const Shader*, const Shader*> stages(m_vertexStage.get(), m_fragmentStage.get());
+		auto pipeline = s_pipelines.find(stages);
+		if (pipeline == s_pipelines.end()) {
+			ProgramPipeline newPipeline = { 0, 0, 0 };
+			glGenProgramPipelines(1, &newPipeline.id);
+			pipeline = s_pipelines.emplace(stages, newPipeline).first;
+		}
+		m_pipeline = &pipeline->second;
+		//Polled like a compiling shader until both stages are done, which resolves ready()
+		s_pendingShaders.push_back(this);
+		isReady();
+		return;
+	}
+
+	std::string vertexShaderString = vertexShaderPath.empty() ? std::string() : preprocess(vertexShaderPath);
+	std::string fragmentShaderString = fragmentShaderPath.empty() ? std::string() : preprocess(fragmentShaderPath);
+
+	startProgram(vertexShaderString, fragmentShaderString);
+	if (m_pending && !m_async) {
+		finishProgram();
+	}
+}
+
+void Shader::enableParallelCompile()
+{
+	//0xFFFFFFFF lets the driver pick the number of compiler threads
+	if (GLEW_KHR_parallel_shader_compile) {
+		glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+		s_hasCompletionStatus = true;
+	}
+	else if (GLEW_ARB_parallel_shader_compile) {
+		glMaxShaderCompilerThreadsARB(0xFFFFFFFF);
+		s_hasCompletionStatus = true;
+	}
+}
+
+bool Shader::enableSeparablePrograms()
+{
+	s_separable = GLEW_ARB_separate_shader_objects != 0;
+	return s_separable;
+}
+
+//Stages are shared by every shader using the same file with the same values for the defines that file uses
+std::shared_ptr<Shader> Shader::getStage(GLenum stage, const std::string& filePath, const ShaderDefines& defines, bool async, bool embedded)
+{
+	ShaderDefines stageDefines = usedDefines(filePath, defines, embedded);
+	std::string key = std::to_string(stage) + (embedded ? "|embedded|" : "|") + filePath + "|" + makeDefineKey(stageDefines);
+	std::shared_ptr<Shader> shader = s_stages[key].lock();
+	if (shader) {
+		if (!async) {
+			shader->waitUntilReady();
+		}
+		return shader;
+	}
+	if (stage == GL_VERTEX_SHADER) {
+		shader.reset(new Shader(stage, filePath, std::string(), stageDefines, async, embedded));
+	}
+	else {
+		shader.reset(new Shader(stage, std::string(), filePath, stageDefines, async, embedded));
+	}
+	shader->m_stageKey = key;
+	s_stages[key] = shader;
+	return shader;
+}
+
+//The defines named in the file or its includes, plus any named in the values of those. Shaders that only differ in
+//defines a stage never mentions end up sharing that stage
+ShaderDefines Shader::usedDefines(const std::string& filePath, const ShaderDefines& defines, bool embedded)
+{
+	std::string source;
+	std::vector<std::string> includedFiles;
+	std::vector<std::string> sourceFiles;
+	preprocessFile(filePath, ShaderDefines(), embedded, source, includedFiles, sourceFiles, 0);
+
+	std::vector<bool> isUsed(defines.size(), false);
+	bool changed = true;
+	while (changed)
+	{
+		changed = false;
+		for (size_t i = 0; i < defines.size(); i++)
+		{
+			if (isUsed[i]) continue;
+			bool found = containsIdentifier(source, defines[i].first);
+			for (size_t j = 0; j < defines.size() && !found; j++) {
+				found = isUsed[j] && containsIdentifier(defines[j].second, defines[i].first);
+			}
+			if (found) {
+				isUsed[i] = true;
+				changed = true;
+			}
+		}
+	}
+
+	ShaderDefines used;
+	for (size_t i = 0; i < defines.size(); i++) {
+		if (isUsed[i]) used.push_back(defines[i]);
+	}
+	return used;
+}
+
+void Shader::pollPending()
+{
+	//isReady removes finished shaders from the list, so walk a copy
+	std::vector<Shader*> pending = s_pendingShaders;
+	for (Shader* shader : pending) {
+		shader->isReady();
+	}
+}
+
+void Shader::resetUniformStats()
+{
+	s_uniformStats = { 0, 0 };
+}
+
+void Shader::startProgram(const std::string& vertexShaderString, const std::string& fragmentShaderString)
+{
+	//A cached binary skips compiling and linking entirely
+	m_sourceKey = hashSources(vertexShaderString, fragmentShaderString);
+	m_cacheKey = 0;
+	if (ProgramCache::isEnabled()) {
+		m_cacheKey = ProgramCache::makeKey(vertexShaderString, fragmentShaderString, m_defineKey);
+		GLuint cachedProgram = ProgramCache::load(m_cacheKey, m_stage != 0);
+		if (cachedProgram) {
+			m_pendingId = cachedProgram;
+			m_pendingFromCache = true;
+			finishProgram();
+			return;
+		}
+	}
+
+	//Nothing here asks for a compile or link status, so a driver with parallel compile can work in the background
+	//A separable stage only has one of the two sources
+	m_vertexShader = vertexShaderString.empty() ? 0 : compileShader(vertexShaderString.c_str(), GL_VERTEX_SHADER);
+	m_fragmentShader = fragmentShaderString.empty() ? 0 : compileShader(fragmentShaderString.c_str(), GL_FRAGMENT_SHADER);
+
+	//Create an empty shader program. It stays separate from m_id until it links, so a reload never draws with a broken program
+	m_pendingId = glCreateProgram();
 
 	//Attach our shader objects
-	glAttachShader(m_id, vertexShader);
-	glAttachShader(m_id, fragmentShader);
+	if (m_vertexShader) glAttachShader(m_pendingId, m_vertexShader);
+	if (m_fragmentShader) glAttachShader(m_pendingId, m_fragmentShader);
+
+	if (m_stage) {
+		glProgramParameteri(m_pendingId, GL_PROGRAM_SEPARABLE, GL_TRUE);
+	}
+
+	//Ask the driver to keep the binary around so it can be cached
+	if (ProgramCache::isEnabled()) {
+		glProgramParameteri(m_pendingId, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	}
 
 	//Link program - will create an executable program with the attached shaders
-	glLinkProgram(m_id);
+	glLinkProgram(m_pendingId);
 
-	//Logging
-	int success;
-	glGetProgramiv(m_id, GL_LINK_STATUS, &success);
-	if (!success) {
+	m_pending = true;
+	s_pendingShaders.push_back(this);
+}
+
+void Shader::finishProgram()
+{
+	bool success = m_pendingFromCache;
+	std::string log;
+	if (!m_pendingFromCache) {
+		if (m_vertexShader) log += getCompileLog(m_vertexShader, GL_VERTEX_SHADER);
+		if (m_fragmentShader) log += getCompileLog(m_fragmentShader, GL_FRAGMENT_SHADER);
+
+		//Logging
+		GLint linked;
+		glGetProgramiv(m_pendingId, GL_LINK_STATUS, &linked);
+		if (!linked) {
+			GLint logLength = 0;
+			glGetProgramiv(m_pendingId, GL_INFO_LOG_LENGTH, &logLength);
+			std::string infoLog(std::max(logLength, 1), '\0');
+			glGetProgramInfoLog(m_pendingId, (GLsizei)infoLog.size(), NULL, &infoLog[0]);
+			log += "Failed to link shader program: " + std::string(infoLog.c_str()) + "\n";
+		}
+		else {
+			ProgramCache::store(m_pendingId, m_cacheKey);
+		}
+		success = linked != 0;
+
+		if (m_vertexShader) glDetachShader(m_pendingId, m_vertexShader);
+		if (m_fragmentShader) glDetachShader(m_pendingId, m_fragmentShader);
+		glDeleteShader(m_vertexShader);
+		glDeleteShader(m_fragmentShader);
+		m_vertexShader = 0;
+		m_fragmentShader = 0;
+
+		m_pending = false;
+		s_pendingShaders.erase(std::remove(s_pendingShaders.begin(), s_pendingShaders.end(), this), s_pendingShaders.end());
+	}
+	m_pendingFromCache = false;
+
+	if (success) {
+		//Cleared first, as building the uniform table can log hash collisions
+		m_errorLog.clear();
+		swapProgram(m_pendingId);
+	}
+	else {
+		GLState::deleteProgram(m_pendingId);
+		//A failed reload keeps the old program running, and its log is shown by the app through getErrorLog()
+		if (!m_linked) {
+			printf("%s", log.c_str());
+		}
+		m_errorLog = log;
+	}
+	m_pendingId = 0;
 
-		GLchar infoLog[512];
-		glGetProgramInfoLog(m_id, 512, NULL, infoLog);
-		printf("Failed to link shader program: %s", infoLog);
+	if (!m_readyResolved) {
+		m_readyResolved = true;
+		m_readyPromise.set_value(m_linked);
 	}
+}
 
-	glDeleteShader(vertexShader);
-	glDeleteShader(fragmentShader);
+//Drops a compile that hasn't finished, leaving the current program as it is
+void Shader::abandonPending()
+{
+	if (!m_pending) {
+		return;
+	}
+	s_pendingShaders.erase(std::remove(s_pendingShaders.begin(), s_pendingShaders.end(), this), s_pendingShaders.end());
+	glDeleteShader(m_vertexShader);
+	glDeleteShader(m_fragmentShader);
+	GLState::deleteProgram(m_pendingId);
+	m_vertexShader = 0;
+	m_fragmentShader = 0;
+	m_pendingId = 0;
+	m_pending = false;
+}
+
+//Makes a linked program current, carrying over every uniform value that still exists in it
+void Shader::swapProgram(GLuint program)
+{
+	std::vector<UniformSlot> oldUniforms;
+	std::string oldNames;
+	std::vector<unsigned char> oldValues;
+	oldUniforms.swap(m_uniforms);
+	oldNames.swap(m_uniformNames);
+	oldValues.swap(m_uniformValues);
+
+	GLState::deleteProgram(m_id);
+	m_id = program;
+	m_linked = true;
+	buildUniformTable();
+	bindUniformBlocks();
+	reflectAttributes();
+	for (const VertexLayout* layout : m_expectedLayouts) {
+		validateVertexLayout(*layout);
+	}
+	for (const std::pair<std::string, GLsizeiptr>& block : m_expectedBlocks) {
+		validateUniformBlock(block.first, block.second);
+	}
+
+	for (const UniformSlot& oldSlot : oldUniforms)
+	{
+		if (oldSlot.nameLength == 0) continue;
+		GLenum type;
+		memcpy(&type, &oldValues[oldSlot.valueOffset], sizeof(type));
+		if (type == 0) continue;
+		const UniformSlot* slot = findUniform(std::string_view(&oldNames[oldSlot.nameOffset], oldSlot.nameLength));
+		if (slot) {
+			setUniform(slot, type, &oldValues[oldSlot.valueOffset + sizeof(GLenum)], uniformValueSize(type));
+		}
+	}
+}
+
+bool Shader::isReady()
+{
+	if (m_pipeline) {
+		//Poll both, so one stage never waits on the other
+		bool vertexReady = m_vertexStage->isReady();
+		bool fragmentReady = m_fragmentStage->isReady();
+		if (!m_readyResolved && m_vertexStage->m_readyResolved && m_fragmentStage->m_readyResolved) {
+			m_readyResolved = true;
+			m_readyPromise.set_value(vertexReady && fragmentReady);
+			s_pendingShaders.erase(std::remove(s_pendingShaders.begin(), s_pendingShaders.end(), this), s_pendingShaders.end());
+		}
+		return vertexReady && fragmentReady;
+	}
+	if (m_pending) {
+		//Without parallel compile there is no way to ask without blocking, so finish on the first poll
+		if (s_hasCompletionStatus) {
+			GLint complete = GL_FALSE;
+			glGetProgramiv(m_pendingId, GL_COMPLETION_STATUS_KHR, &complete);
+			if (!complete) {
+				//During a reload the previous program is still usable
+				return m_linked;
+			}
+		}
+		finishProgram();
+	}
+	return m_linked;
+}
+
+void Shader::waitUntilReady()
+{
+	if (m_pipeline) {
+		m_vertexStage->waitUntilReady();
+		m_fragmentStage->waitUntilReady();
+		isReady();
+	}
+	if (m_pending) {
+		finishProgram();
+	}
+}
+
+void Shader::setFallback(Shader* fallback)
+{
+	m_fallback = fallback;
+}
+
+void Shader::reload()
+{
+	if (m_pipeline) {
+		m_vertexStage->reload();
+		m_fragmentStage->reload();
+	}
+	else {
+		//Rebuilt by preprocess, so newly included files are picked up
+		m_sourceFiles.clear();
+		std::string vertexShaderString = m_vertexPath.empty() ? std::string() : preprocess(m_vertexPath);
+		std::string fragmentShaderString = m_fragmentPath.empty() ? std::string() : preprocess(m_fragmentPath);
+		//Shared stages are asked once per shader using them, and saving a file doesn't always change the result
+		if (hashSources(vertexShaderString, fragmentShaderString) != m_sourceKey) {
+			abandonPending();
+			startProgram(vertexShaderString, fragmentShaderString);
+		}
+	}
+
+	for (std::pair<std::string, std::unique_ptr<Shader>>& variant : m_variants) {
+		variant.second->reload();
+	}
+}
+
+bool Shader::usesFile(const std::string& filePath) const
+{
+	if (m_pipeline) {
+		return m_vertexStage->usesFile(filePath) || m_fragmentStage->usesFile(filePath);
+	}
+	std::filesystem::path path = std::filesystem::path(filePath).lexically_normal();
+	for (const std::string& sourceFile : m_sourceFiles) {
+		if (std::filesystem::path(sourceFile).lexically_normal() == path) {
+			return true;
+		}
+	}
+	return false;
+}
+
+std::string Shader::getErrorLog() const
+{
+	std::string log = m_pipeline ? m_vertexStage->getErrorLog() + m_fragmentStage->getErrorLog() : m_errorLog;
+	for (const std::pair<std::string, std::unique_ptr<Shader>>& variant : m_variants)
+	{
+		std::string variantLog = variant.second->getErrorLog();
+		if (!variantLog.empty()) {
+			//The key is "NAME=VALUE\n" per define
+			std::string defines = variant.first;
+			defines.pop_back();
+			std::replace(defines.begin(), defines.end(), '\n', ' ');
+			log += "Variant " + defines + ":\n" + variantLog;
+		}
+	}
+	return log;
+}
+
+Shader::~Shader()
+{
+	if (m_pipeline) {
+		s_pendingShaders.erase(std::remove(s_pendingShaders.begin(), s_pendingShaders.end(), this), s_pendingShaders.end());
+	}
+	if (m_stage) {
+		s_stages.erase(m_stageKey);
+		//Every pipeline using this stage goes with it, the shaders that used them are already gone
+		for (auto pipeline = s_pipelines.begin(); pipeline != s_pipelines.end(); )
+		{
+			if (pipeline->first.first == this || pipeline->first.second == this) {
+				GLState::deleteProgramPipeline(pipeline->second.id);
+				pipeline = s_pipelines.erase(pipeline);
+			}
+			else {
+				++pipeline;
+			}
+		}
+	}
+	abandonPending();
+	GLState::deleteProgram(m_id);
+}
+
+Shader& Shader::getVariant(const ShaderDefines& defines)
+{
+	ShaderDefines merged = m_defines;
+	for (const std::pair<std::string, std::string>& define : defines)
+	{
+		auto existing = std::find_if(merged.begin(), merged.end(),
+			[&](const std::pair<std::string, std::string>& other) { return other.first == define.first; });
+		if (existing != merged.end()) {
+			existing->second = define.second;
+		}
+		else {
+			merged.push_back(define);
+		}
+	}
+	sortDefines(merged);
+	std::string key = makeDefineKey(merged);
+	if (key == m_defineKey) {
+		return *this;
+	}
+
+	for (std::pair<std::string, std::unique_ptr<Shader>>& variant : m_variants) {
+		if (variant.first == key) {
+			return *variant.second;
+		}
+	}
+	//Variants compile the same way as their parent and draw with it until they are ready
+	m_variants.emplace_back(key, std::unique_ptr<Shader>(new Shader(0, m_vertexPath, m_fragmentPath, merged, m_async, m_embedded)));
+	Shader& variant = *m_variants.back().second;
+	variant.setFallback(this);
+	for (const VertexLayout* layout : m_expectedLayouts) {
+		variant.expectVertexLayout(*layout);
+	}
+	for (const std::pair<std::string, GLsizeiptr>& block : m_expectedBlocks) {
+		variant.expectUniformBlock(block.first, block.second);
+	}
+	return variant;
 }
 
 void Shader::use()
 {
-	glUseProgram(m_id);
+	if (!isReady()) {
+		if (m_fallback) m_fallback->use();
+		return;
+	}
+	if (m_pipeline) {
+		//A stage that reloaded has a new program
+		if (m_pipeline->vertexProgram != m_vertexStage->m_id) {
+			m_pipeline->vertexProgram = m_vertexStage->m_id;
+			glUseProgramStages(m_pipeline->id, GL_VERTEX_SHADER_BIT, m_pipeline->vertexProgram);
+		}
+		if (m_pipeline->fragmentProgram != m_fragmentStage->m_id) {
+			m_pipeline->fragmentProgram = m_fragmentStage->m_id;
+			glUseProgramStages(m_pipeline->id, GL_FRAGMENT_SHADER_BIT, m_pipeline->fragmentProgram);
+		}
+		//A program made current with glUseProgram would take priority over the pipeline
+		GLState::useProgram(0);
+		GLState::bindProgramPipeline(m_pipeline->id);
+		return;
+	}
+	GLState::useProgram(m_id);
 }
 
-void Shader::setFloat(std::string name, float value)
+template<typename Name>
+void Shader::setNamedUniform(Name name, GLenum type, const void* value, uint32_t size)
 {
-	glProgramUniform1f(m_id, glGetUniformLocation(m_id, name.c_str()), value);
+	if (!isReady()) {
+		if (m_fallback) m_fallback->setNamedUniform(name, type, value, size);
+		return;
+	}
+	if (m_pipeline) {
+		//A name declared in both stages is two uniforms, so set both
+		m_vertexStage->setNamedUniform(name, type, value, size);
+		m_fragmentStage->setNamedUniform(name, type, value, size);
+		return;
+	}
+	setUniform(findUniform(name), type, value, size);
 }
 
-void Shader::setInt(std::string name, int value)
+void Shader::setFloat(std::string_view name, float value)
 {
-	glProgramUniform1i(m_id, glGetUniformLocation(m_id, name.c_str()), value);
+	setNamedUniform(name, GL_FLOAT, &value, sizeof(value));
 }
 
-void Shader::setMat4(std::string name, const glm::mat4& value) { 
-	glProgramUniformMatrix4fv(m_id, glGetUniformLocation(m_id, name.c_str()), 1, false, glm::value_ptr(value));
+void Shader::setFloat(UniformKey key, float value)
+{
+	setNamedUniform(key, GL_FLOAT, &value, sizeof(value));
 }
 
-void Shader::setVec3(std::string name, const glm::vec3& value)
+void Shader::setInt(std::string_view name, int value)
 {
-	glProgramUniform3f(m_id, glGetUniformLocation(m_id, name.c_str()), value.x, value.y, value.z);
+	setNamedUniform(name, GL_INT, &value, sizeof(value));
 }
 
-void Shader::setVec2(std::string name, const glm::vec2& value)
+void Shader::setInt(UniformKey key, int value)
 {
-	glProgramUniform2f(m_id, glGetUniformLocation(m_id, name.c_str()), value.x, value.y);
+	setNamedUniform(key, GL_INT, &value, sizeof(value));
 }
 
+void Shader::setMat4(std::string_view name, const glm::mat4& value) {
+	setNamedUniform(name, GL_FLOAT_MAT4, glm::value_ptr(value), sizeof(value));
+}
+
+void Shader::setMat4(UniformKey key, const glm::mat4& value) {
+	setNamedUniform(key, GL_FLOAT_MAT4, glm::value_ptr(value), sizeof(value));
+}
+
+void Shader::setVec3(std::string_view name, const glm::vec3& value)
+{
+	setNamedUniform(name, GL_FLOAT_VEC3, glm::value_ptr(value), sizeof(value));
+}
+
+void Shader::setVec3(UniformKey key, const glm::vec3& value)
+{
+	setNamedUniform(key, GL_FLOAT_VEC3, glm::value_ptr(value), sizeof(value));
+}
+
+void Shader::setVec2(std::string_view name, const glm::vec2& value)
+{
+	setNamedUniform(name, GL_FLOAT_VEC2, glm::value_ptr(value), sizeof(value));
+}
+
+void Shader::setVec2(UniformKey key, const glm::vec2& value)
+{
+	setNamedUniform(key, GL_FLOAT_VEC2, glm::value_ptr(value), sizeof(value));
+}
+
+//In a pipeline the location belongs to whichever stage declares the uniform first, see getProgramId
+GLint Shader::getUniformLocation(std::string_view name) const
+{
+	if (m_pipeline) {
+		GLint location = m_vertexStage->getUniformLocation(name);
+		return location >= 0 ? location : m_fragmentStage->getUniformLocation(name);
+	}
+	const UniformSlot* slot = findUniform(name);
+	return slot ? slot->location : -1;
+}
+
+GLint Shader::getUniformLocation(UniformKey key) const
+{
+	if (m_pipeline) {
+		GLint location = m_vertexStage->getUniformLocation(key);
+		return location >= 0 ? location : m_fragmentStage->getUniformLocation(key);
+	}
+	const UniformSlot* slot = findUniform(key);
+	return slot ? slot->location : -1;
+}
+
+GLuint Shader::getProgramId(GLenum stage) const
+{
+	if (m_pipeline) {
+		return stage == GL_VERTEX_SHADER ? m_vertexStage->m_id : m_fragmentStage->m_id;
+	}
+	return m_id;
+}
+
+const std::string& Shader::getName() const
+{
+	return m_fragmentPath.empty() ? m_vertexPath : m_fragmentPath;
+}
+
+//Uploads the value unless it is bitwise identical to the last one set through the same setter type.
+//type is the GLenum matching the setter, not the uniform's own type
+void Shader::setUniform(const UniformSlot* slot, GLenum type, const void* value, uint32_t size)
+{
+	if (!slot) {
+		return;
+	}
+	if (size <= uniformValueSize(slot->type)) {
+		unsigned char* stored = &m_uniformValues[slot->valueOffset];
+		GLenum storedType;
+		memcpy(&storedType, stored, sizeof(storedType));
+		if (storedType == type && memcmp(stored + sizeof(type), value, size) == 0) {
+			s_uniformStats.skipped++;
+			return;
+		}
+		memcpy(stored, &type, sizeof(type));
+		memcpy(stored + sizeof(type), value, size);
+	}
+	uploadUniform(slot->location, type, value);
+	s_uniformStats.issued++;
+}
 
-std::string Shader::readFile(const std::string& filePath)
+void Shader::uploadUniform(GLint location, GLenum type, const void* value)
 {
+	//glProgramUniform* needs GL 4.1 or GL_ARB_separate_shader_objects. Without either the program is bound and set
+	//through glUniform*. Stage programs need the extension, so they never take that path
+	if (!GLEW_VERSION_4_1 && !GLEW_ARB_separate_shader_objects) {
+		GLState::useProgram(m_id);
+		switch (type) {
+		case GL_FLOAT: glUniform1fv(location, 1, (const GLfloat*)value); break;
+		case GL_INT: glUniform1iv(location, 1, (const GLint*)value); break;
+		case GL_FLOAT_VEC2: glUniform2fv(location, 1, (const GLfloat*)value); break;
+		case GL_FLOAT_VEC3: glUniform3fv(location, 1, (const GLfloat*)value); break;
+		case GL_FLOAT_MAT4: glUniformMatrix4fv(location, 1, GL_FALSE, (const GLfloat*)value); break;
+		}
+		return;
+	}
+	switch (type) {
+	case GL_FLOAT: glProgramUniform1fv(m_id, location, 1, (const GLfloat*)value); break;
+	case GL_INT: glProgramUniform1iv(m_id, location, 1, (const GLint*)value); break;
+	case GL_FLOAT_VEC2: glProgramUniform2fv(m_id, location, 1, (const GLfloat*)value); break;
+	case GL_FLOAT_VEC3: glProgramUniform3fv(m_id, location, 1, (const GLfloat*)value); break;
+	case GL_FLOAT_MAT4: glProgramUniformMatrix4fv(m_id, location, 1, GL_FALSE, (const GLfloat*)value); break;
+	}
+}
+
+std::string Shader::readFile(const std::string& filePath, bool embedded)
+{
+	if (embedded) {
+		std::string name = filePath.compare(0, EMBEDDED_SHADER_DIRECTORY.size(), EMBEDDED_SHADER_DIRECTORY) == 0
+			? filePath.substr(EMBEDDED_SHADER_DIRECTORY.size()) : filePath;
+		const EmbeddedShaderFile* file = findEmbeddedShader(name);
+		if (!s_embeddedOverrideDirectory.empty()) {
+			std::string overridePath = (std::filesystem::path(s_embeddedOverrideDirectory) / name).string();
+			std::error_code error;
+			if (std::filesystem::exists(overridePath, error)) {
+				std::string source = readFile(overridePath, false);
+				//Once per file, so a reload loop doesn't repeat it
+				static std::vector<std::string> reportedFiles;
+				if (file && hashString64(source) != file->hash
+					&& std::find(reportedFiles.begin(), reportedFiles.end(), name) == reportedFiles.end()) {
+					printf("Using %s from disk, it differs from the embedded copy until the next build\n", overridePath.c_str());
+					reportedFiles.push_back(name);
+				}
+				return source;
+			}
+		}
+		if (!file) {
+			printf("No embedded shader named %s\n", name.c_str());
+			return std::string();
+		}
+		return std::string(file->source, file->length);
+	}
+
 	std::ifstream fileStream;
 	fileStream.open(filePath);
 	if (!fileStream.is_open()) {
@@ -83,6 +770,91 @@ std::string Shader::readFile(const std::string& filePath)
 	return stringStream.str();
 }
 
+std::string Shader::preprocess(const std::string& filePath)
+{
+	std::string output;
+	std::vector<std::string> includedFiles;
+	preprocessFile(filePath, m_defines, m_embedded, output, includedFiles, m_sourceFiles, 0);
+	return output;
+}
+
+//Appends the file to output, expanding #include "file" (relative to the including file, each file at most once per stage)
+//and injecting the defines after #version, or at the top of a file without one. #line directives keep compile errors
+//pointing at the original file and line
+void Shader::preprocessFile(const std::string& filePath, const ShaderDefines& defines, bool embedded, std::string& output,
+	std::vector<std::string>& includedFiles, std::vector<std::string>& sourceFiles, int depth)
+{
+	if (depth > MAX_INCLUDE_DEPTH) {
+		printf("Shader #include depth exceeded at %s\n", filePath.c_str());
+		return;
+	}
+	if (std::find(includedFiles.begin(), includedFiles.end(), filePath) != includedFiles.end()) {
+		return;
+	}
+	includedFiles.push_back(filePath);
+
+	int fileIndex = sourceFileIndex(filePath, sourceFiles);
+	size_t directoryEnd = filePath.find_last_of("/\\");
+	std::string directory = directoryEnd == std::string::npos ? std::string() : filePath.substr(0, directoryEnd + 1);
+
+	if (depth > 0) {
+		output += "#line 1 " + std::to_string(fileIndex) + "\n";
+	}
+
+	std::istringstream source(readFile(filePath, embedded));
+	std::string line;
+	int lineNumber = 0;
+	size_t fileStart = output.size();
+	bool definesInjected = false;
+	std::string defineLines;
+	if (depth == 0) {
+		for (const std::pair<std::string, std::string>& define : defines) {
+			defineLines += "#define " + define.first + " " + define.second + "\n";
+		}
+	}
+	while (std::getline(source, line))
+	{
+		lineNumber++;
+		size_t directiveStart = line.find_first_not_of(" \t");
+		bool isDirective = directiveStart != std::string::npos && line[directiveStart] == '#';
+
+		if (isDirective && line.compare(directiveStart, 8, "#include") == 0) {
+			size_t nameStart = line.find('"', directiveStart + 8);
+			size_t nameEnd = nameStart == std::string::npos ? std::string::npos : line.find('"', nameStart + 1);
+			if (nameEnd == std::string::npos) {
+				printf("Malformed #include in %s(%d)\n", filePath.c_str(), lineNumber);
+				continue;
+			}
+			preprocessFile(directory + line.substr(nameStart + 1, nameEnd - nameStart - 1), defines, embedded, output, includedFiles, sourceFiles, depth + 1);
+			output += "#line " + std::to_string(lineNumber + 1) + " " + std::to_string(fileIndex) + "\n";
+			continue;
+		}
+
+		output += line;
+		output += '\n';
+
+		if (isDirective && depth == 0 && !definesInjected && line.compare(directiveStart, 8, "#version") == 0) {
+			output += defineLines;
+			output += "#line " + std::to_string(lineNumber + 1) + " " + std::to_string(fileIndex) + "\n";
+			definesInjected = true;
+		}
+	}
+
+	if (depth == 0 && !definesInjected && !defines.empty()) {
+		output.insert(fileStart, defineLines + "#line 1 " + std::to_string(fileIndex) + "\n");
+	}
+}
+
+int Shader::sourceFileIndex(const std::string& filePath, std::vector<std::string>& sourceFiles)
+{
+	auto existing = std::find(sourceFiles.begin(), sourceFiles.end(), filePath);
+	if (existing != sourceFiles.end()) {
+		return (int)(existing - sourceFiles.begin());
+	}
+	sourceFiles.push_back(filePath);
+	return (int)sourceFiles.size() - 1;
+}
+
 GLuint Shader::compileShader(const char* shaderSource, GLenum shaderType)
 {
 	GLuint shader = glCreateShader(shaderType);
@@ -90,16 +862,342 @@ GLuint Shader::compileShader(const char* shaderSource, GLenum shaderType)
 	glShaderSource(shader, 1, &shaderSource, NULL);
 	//Compiles the shader source
 	glCompileShader(shader);
+	return shader;
+}
 
+std::string Shader::getCompileLog(GLuint shader, GLenum shaderType)
+{
 	//Get result of last compile - either GL_TRUE or GL_FALSE
 	GLint success;
 	glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
-	if (!success) {
-		const char* shaderName = shaderType == GL_VERTEX_SHADER ? "VERTEX" : "FRAGMENT";
-		//Dump logs into a char array - 512 is an arbitrary length
-		GLchar infoLog[512];
-		glGetShaderInfoLog(shader, 512, NULL, infoLog);
-		printf("Failed to compile %s shader: %s", shaderName, infoLog);
+	if (success) {
+		return std::string();
 	}
-	return shader;
+	const char* shaderName = shaderType == GL_VERTEX_SHADER ? "VERTEX" : "FRAGMENT";
+	GLint logLength = 0;
+	glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &logLength);
+	std::string infoLog(std::max(logLength, 1), '\0');
+	glGetShaderInfoLog(shader, (GLsizei)infoLog.size(), NULL, &infoLog[0]);
+	std::string log = std::string("Failed to compile ") + shaderName + " shader: " + infoLog.c_str();
+	//Log lines are prefixed with the file number from the #line directives
+	for (size_t i = 0; i < m_sourceFiles.size(); i++) {
+		log += "  file " + std::to_string(i) + " = " + m_sourceFiles[i] + "\n";
+	}
+	return log;
+}
+
+void Shader::buildUniformTable()
+{
+	m_uniforms.clear();
+	m_uniformNames.clear();
+	m_uniformValues.clear();
+
+	GLint numUniforms = 0;
+	glGetProgramiv(m_id, GL_ACTIVE_UNIFORMS, &numUniforms);
+	GLint maxNameLength = 0;
+	glGetProgramiv(m_id, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxNameLength);
+
+	//Arrays of basic types also get an entry per element, so leave headroom. Keep load factor under 0.5
+	uint32_t capacity = 16;
+	while (capacity < (uint32_t)numUniforms * 4) {
+		capacity *= 2;
+	}
+	m_uniforms.assign(capacity, UniformSlot{ 0, 0, 0, -1, 0, 0, 0, false });
+	m_uniformMask = capacity - 1;
+	m_uniformCount = 0;
+
+	std::string name(maxNameLength + 16, '\0');
+	for (GLint i = 0; i < numUniforms; i++)
+	{
+		GLsizei length = 0;
+		GLint size = 0;
+		GLenum type = 0;
+		glGetActiveUniform(m_id, (GLuint)i, maxNameLength, &length, &size, &type, &name[0]);
+
+		GLint location = glGetUniformLocation(m_id, name.c_str());
+		//Uniform block members have no location and can't be set individually
+		if (location < 0) {
+			continue;
+		}
+		uint32_t valueOffset = (uint32_t)m_uniformValues.size();
+		addUniform(name.c_str(), (uint32_t)length, location, type, size, valueOffset);
+
+		//Arrays are reported as "name[0]". Register "name" and every "name[i]" so lookups never hit the driver.
+		//"name" is the same uniform as "name[0]", so they share a stored value
+		if (length > 3 && name.compare(length - 3, 3, "[0]") == 0) {
+			std::string baseName = name.substr(0, length - 3);
+			addUniform(baseName.c_str(), (uint32_t)baseName.size(), location, type, size, valueOffset);
+			for (GLint element = 1; element < size; element++)
+			{
+				std::string elementName = baseName + "[" + std::to_string(element) + "]";
+				GLint elementLocation = glGetUniformLocation(m_id, elementName.c_str());
+				addUniform(elementName.c_str(), (uint32_t)elementName.size(), elementLocation, type, size - element, (uint32_t)m_uniformValues.size());
+			}
+		}
+	}
+}
+
+//valueOffset is the end of m_uniformValues for a new value, or an earlier offset to share one
+void Shader::addUniform(const char* name, uint32_t nameLength, GLint location, GLenum type, GLint size, uint32_t valueOffset)
+{
+	//Grow if this insert would push the load factor past 0.5
+	if ((m_uniformCount + 1) * 2 > (uint32_t)m_uniforms.size()) {
+		std::vector<UniformSlot> old;
+		old.swap(m_uniforms);
+		m_uniforms.assign(old.size() * 2, UniformSlot{ 0, 0, 0, -1, 0, 0, 0, false });
+		m_uniformMask = (uint32_t)m_uniforms.size() - 1;
+		for (const UniformSlot& slot : old) {
+			if (slot.nameLength == 0) continue;
+			uint32_t index = slot.hash & m_uniformMask;
+			while (m_uniforms[index].nameLength != 0) {
+				index = (index + 1) & m_uniformMask;
+			}
+			m_uniforms[index] = slot;
+		}
+	}
+
+	std::string_view nameView(name, nameLength);
+	uint32_t hash = hashUniformName(nameView);
+	uint32_t index = hash & m_uniformMask;
+	bool ambiguous = false;
+	while (m_uniforms[index].nameLength != 0) {
+		UniformSlot& other = m_uniforms[index];
+		if (other.hash == hash && other.nameLength == nameLength) {
+			std::string_view otherName(&m_uniformNames[other.nameOffset], other.nameLength);
+			if (nameView == otherName) {
+				return;
+			}
+			//Prehashed keys only compare hash + length, so neither can be found through one
+			std::string error = getName() + ": uniforms " + std::string(otherName) + " and " + std::string(nameView)
+				+ " have the same hash, set them by name\n";
+			printf("%s", error.c_str());
+			m_errorLog += error;
+			other.ambiguous = true;
+			ambiguous = true;
+		}
+		index = (index + 1) & m_uniformMask;
+	}
+
+	UniformSlot& slot = m_uniforms[index];
+	slot.hash = hash;
+	slot.nameOffset = (uint32_t)m_uniformNames.size();
+	slot.nameLength = nameLength;
+	slot.location = location;
+	slot.type = type;
+	slot.size = size;
+	slot.valueOffset = valueOffset;
+	slot.ambiguous = ambiguous;
+	m_uniformNames.append(name, nameLength);
+	if (valueOffset == m_uniformValues.size()) {
+		m_uniformValues.resize(m_uniformValues.size() + sizeof(GLenum) + uniformValueSize(type), 0);
+	}
+	m_uniformCount++;
+}
+
+const UniformSlot* Shader::findUniform(std::string_view name) const
+{
+	uint32_t hash = hashUniformName(name);
+	uint32_t index = hash & m_uniformMask;
+	while (m_uniforms[index].nameLength != 0) {
+		const UniformSlot& slot = m_uniforms[index];
+		if (slot.hash == hash && slot.nameLength == name.size()
+			&& name == std::string_view(&m_uniformNames[slot.nameOffset], slot.nameLength)) {
+			return &slot;
+		}
+		index = (index + 1) & m_uniformMask;
+	}
+	return nullptr;
+}
+
+const UniformSlot* Shader::findUniform(UniformKey key) const
+{
+	uint32_t index = key.hash & m_uniformMask;
+	while (m_uniforms[index].nameLength != 0) {
+		const UniformSlot& slot = m_uniforms[index];
+		if (slot.hash == key.hash && slot.nameLength == key.length) {
+			return slot.ambiguous ? nullptr : &slot;
+		}
+		index = (index + 1) & m_uniformMask;
+	}
+	return nullptr;
+}
+
+//Attaches every active block named in UNIFORM_BLOCK_NAMES to its binding point and records all active blocks.
+//Storage blocks named in STORAGE_BLOCK_NAMES are attached too, but not recorded
+void Shader::bindUniformBlocks()
+{
+	m_uniformBlocks.clear();
+	GLint numBlocks = 0;
+	glGetProgramiv(m_id, GL_ACTIVE_UNIFORM_BLOCKS, &numBlocks);
+	GLint maxNameLength = 0;
+	glGetProgramiv(m_id, GL_ACTIVE_UNIFORM_BLOCK_MAX_NAME_LENGTH, &maxNameLength);
+
+	std::string name(maxNameLength + 1, '\0');
+	for (GLint i = 0; i < numBlocks; i++)
+	{
+		GLsizei length = 0;
+		glGetActiveUniformBlockName(m_id, (GLuint)i, (GLsizei)name.size(), &length, &name[0]);
+		ShaderUniformBlock block = { name.substr(0, length), -1, 0 };
+		glGetActiveUniformBlockiv(m_id, (GLuint)i, GL_UNIFORM_BLOCK_DATA_SIZE, &block.dataSize);
+		for (const UniformBlockName& blockName : UNIFORM_BLOCK_NAMES)
+		{
+			if (block.name == blockName.name) {
+				glUniformBlockBinding(m_id, (GLuint)i, blockName.binding);
+				block.binding = (GLint)blockName.binding;
+			}
+		}
+		if (block.binding < 0) {
+			printf("%s: uniform block %s has no binding point in UNIFORM_BLOCK_NAMES\n", getName().c_str(), block.name.c_str());
+		}
+		m_uniformBlocks.push_back(block);
+	}
+
+	//Shader storage blocks the same way, through STORAGE_BLOCK_NAMES, when the driver has them
+	if (!GLEW_VERSION_4_3 && !(GLEW_ARB_shader_storage_buffer_object && GLEW_ARB_program_interface_query)) {
+		return;
+	}
+	glGetProgramInterfaceiv(m_id, GL_SHADER_STORAGE_BLOCK, GL_ACTIVE_RESOURCES, &numBlocks);
+	glGetProgramInterfaceiv(m_id, GL_SHADER_STORAGE_BLOCK, GL_MAX_NAME_LENGTH, &maxNameLength);
+	name.assign(maxNameLength + 1, '\0');
+	for (GLint i = 0; i < numBlocks; i++)
+	{
+		GLsizei length = 0;
+		glGetProgramResourceName(m_id, GL_SHADER_STORAGE_BLOCK, (GLuint)i, (GLsizei)name.size(), &length, &name[0]);
+		std::string blockName = name.substr(0, length);
+		bool bound = false;
+		for (const UniformBlockName& storageBlockName : STORAGE_BLOCK_NAMES)
+		{
+			if (blockName == storageBlockName.name) {
+				glShaderStorageBlockBinding(m_id, (GLuint)i, storageBlockName.binding);
+				bound = true;
+			}
+		}
+		if (!bound) {
+			printf("%s: storage block %s has no binding point in STORAGE_BLOCK_NAMES\n", getName().c_str(), blockName.c_str());
+		}
+	}
+}
+
+void Shader::reflectAttributes()
+{
+	m_attributes.clear();
+	m_attributeMask = 0;
+	GLint numAttributes = 0;
+	glGetProgramiv(m_id, GL_ACTIVE_ATTRIBUTES, &numAttributes);
+	GLint maxNameLength = 0;
+	glGetProgramiv(m_id, GL_ACTIVE_ATTRIBUTE_MAX_LENGTH, &maxNameLength);
+
+	std::string name(maxNameLength + 1, '\0');
+	for (GLint i = 0; i < numAttributes; i++)
+	{
+		GLsizei length = 0;
+		ShaderAttribute attribute = { std::string(), -1, 0, 0 };
+		glGetActiveAttrib(m_id, (GLuint)i, (GLsizei)name.size(), &length, &attribute.size, &attribute.type, &name[0]);
+		attribute.name = name.substr(0, length);
+		attribute.location = glGetAttribLocation(m_id, attribute.name.c_str());
+		//Built in inputs like gl_VertexID have no location
+		if (attribute.location < 0) {
+			continue;
+		}
+		m_attributeMask |= 1u << attribute.location;
+		m_attributes.push_back(attribute);
+	}
+}
+
+//Every input the shader reads needs vertex data of the right type at its location. Layout attributes the shader
+//doesn't read are fine, Mesh::enableAttributes can skip fetching them
+void Shader::validateVertexLayout(const VertexLayout& layout)
+{
+	for (const ShaderAttribute& attribute : m_attributes)
+	{
+		//Per-vertex and per-instance layouts each only feed their own side of FIRST_INSTANCE_LOCATION
+		if ((attribute.location >= (GLint)FIRST_INSTANCE_LOCATION) != (layout.divisor != 0)) {
+			continue;
+		}
+		const VertexAttribute* match = nullptr;
+		for (const VertexAttribute& vertexAttribute : layout.attributes) {
+			if ((GLint)vertexAttribute.location == attribute.location) {
+				match = &vertexAttribute;
+			}
+		}
+		if (!match) {
+			//A layout constant feeds the input a fixed value instead
+			bool isConstant = std::any_of(layout.constants.begin(), layout.constants.end(),
+				[&](const VertexConstant& constant) { return (GLint)constant.location == attribute.location; });
+			if (!isConstant) {
+				printf("%s: input %s (location %d) has no vertex data\n", m_vertexPath.c_str(), attribute.name.c_str(), attribute.location);
+			}
+			continue;
+		}
+		if (attribute.name != match->name) {
+			printf("%s: input %s (location %d) is fed %s\n", m_vertexPath.c_str(), attribute.name.c_str(), attribute.location, match->name);
+		}
+		if (attribute.type != match->shaderType) {
+			printf("%s: input %s is declared %s but the vertex layout has %s\n", m_vertexPath.c_str(), attribute.name.c_str(),
+				glslTypeName(attribute.type).c_str(), glslTypeName(match->shaderType).c_str());
+		}
+	}
+}
+
+void Shader::validateUniformBlock(const std::string& name, GLsizeiptr size)
+{
+	for (const ShaderUniformBlock& block : m_uniformBlocks)
+	{
+		if (block.name == name && block.dataSize != size) {
+			printf("%s: uniform block %s is %d bytes but its buffer is %d\n", getName().c_str(), name.c_str(), block.dataSize, (int)size);
+		}
+	}
+}
+
+void Shader::expectVertexLayout(const VertexLayout& layout)
+{
+	if (m_pipeline) {
+		m_vertexStage->expectVertexLayout(layout);
+	}
+	//Shared stages hear about the same layout from every shader using them
+	else if (std::find(m_expectedLayouts.begin(), m_expectedLayouts.end(), &layout) == m_expectedLayouts.end()) {
+		m_expectedLayouts.push_back(&layout);
+		if (m_linked) {
+			validateVertexLayout(layout);
+		}
+	}
+	for (std::pair<std::string, std::unique_ptr<Shader>>& variant : m_variants) {
+		variant.second->expectVertexLayout(layout);
+	}
+}
+
+void Shader::expectUniformBlock(const std::string& name, GLsizeiptr size)
+{
+	std::pair<std::string, GLsizeiptr> block(name, size);
+	if (m_pipeline) {
+		m_vertexStage->expectUniformBlock(name, size);
+		m_fragmentStage->expectUniformBlock(name, size);
+	}
+	else if (std::find(m_expectedBlocks.begin(), m_expectedBlocks.end(), block) == m_expectedBlocks.end()) {
+		m_expectedBlocks.push_back(block);
+		if (m_linked) {
+			validateUniformBlock(name, size);
+		}
+	}
+	for (std::pair<std::string, std::unique_ptr<Shader>>& variant : m_variants) {
+		variant.second->expectUniformBlock(name, size);
+	}
+}
+
+uint32_t Shader::getActiveAttributeMask()
+{
+	if (!isReady()) {
+		return m_fallback ? m_fallback->getActiveAttributeMask() : 0xFFFFFFFF;
+	}
+	return m_pipeline ? m_vertexStage->m_attributeMask : m_attributeMask;
+}
+
+std::vector<ShaderUniformBlock> Shader::getUniformBlocks() const
+{
+	if (!m_pipeline) {
+		return m_uniformBlocks;
+	}
+	std::vector<ShaderUniformBlock> blocks = m_vertexStage->m_uniformBlocks;
+	blocks.insert(blocks.end(), m_fragmentStage->m_uniformBlocks.begin(), m_fragmentStage->m_uniformBlocks.end());
+	return blocks;
 }
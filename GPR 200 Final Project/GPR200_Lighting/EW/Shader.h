@@ -2,21 +2,256 @@
 #include "GL/glew.h"
 #include <glm/glm.hpp>
 #include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <map>
+#include <future>
+#include <utility>
+#include <cstdint>
+#include "VertexLayout.h"
+
+//FNV-1a hash of a uniform name. constexpr so names used every frame can be hashed at compile time
+constexpr uint32_t hashUniformName(std::string_view name)
+{
+	uint32_t hash = 2166136261u;
+	for (char c : name) {
+		hash ^= (uint8_t)c;
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+/// <summary>
+/// Prehashed uniform name. Build it once (ideally as a constexpr) and pass it to the setters to skip hashing entirely
+/// </summary>
+struct UniformKey
+{
+	constexpr explicit UniformKey(std::string_view name)
+		: hash(hashUniformName(name)), length((uint32_t)name.size()) {};
+	uint32_t hash;
+	uint32_t length;
+private:
+	//Left uninitialized, for CommandBuffer to copy recorded keys back into
+	friend class CommandBuffer;
+	UniformKey() = default;
+};
+
+/// <summary>
+/// One active uniform, found by glGetActiveUniform after linking
+/// </summary>
+struct UniformSlot
+{
+	uint32_t hash;
+	uint32_t nameOffset;
+	uint32_t nameLength;
+	GLint location;
+	GLenum type;
+	GLint size;
+	//Where the last value set through this slot is kept, so it can be re-applied after a reload
+	uint32_t valueOffset;
+	//Another name has the same hash and length, so a UniformKey can't tell which one it means
+	bool ambiguous;
+};
+
+/// <summary>
+/// One active vertex input, found by glGetActiveAttrib after linking
+/// </summary>
+struct ShaderAttribute
+{
+	std::string name;
+	GLint location;
+	GLenum type;
+	GLint size;
+};
+
+/// <summary>
+/// One active uniform block, found after linking. binding is -1 if the name isn't in UNIFORM_BLOCK_NAMES
+/// </summary>
+struct ShaderUniformBlock
+{
+	std::string name;
+	GLint binding;
+	GLint dataSize;
+};
+
+//Uniform setter calls since Shader::resetUniformStats(). Skipped calls matched the value already set and never reached the driver
+struct UniformCallStats
+{
+	uint32_t issued;
+	uint32_t skipped;
+};
+
+//NAME, VALUE pairs injected as #defines right after the #version line
+typedef std::vector<std::pair<std::string, std::string>> ShaderDefines;
 
 class Shader
 {
 public:
-	Shader(std::string vertexShaderPath, std::string fragmentShaderPath);
+	//An async shader returns before its program has linked. Until then use() and the setters go to the fallback shader
+	Shader(std::string vertexShaderPath, std::string fragmentShaderPath, const ShaderDefines& defines = ShaderDefines(), bool async = false);
+	~Shader();
+	//Builds from the copies of shaders/ compiled into the executable by tools/embed_shaders.py, without touching the disk.
+	//Names are relative to shaders/, and so are #includes
+	static Shader fromEmbedded(const std::string& vertexShaderName, const std::string& fragmentShaderName,
+		const ShaderDefines& defines = ShaderDefines(), bool async = false);
+	//Embedded shaders read a file from this directory instead when it exists, so they can be edited without rebuilding.
+	//Empty (the default) never touches the disk
+	static void setEmbeddedOverrideDirectory(const std::string& directory);
+	//This shader with extra defines, overriding any with the same name. Each define set is compiled once and kept
+	Shader& getVariant(const ShaderDefines& defines);
+	//Let the driver compile on its own threads (GL_KHR/ARB_parallel_shader_compile). Call once after glewInit
+	static void enableParallelCompile();
+	//Shaders created after this compile each stage once into a separable program shared by every shader using the
+	//same file and defines, and draw through a program pipeline (GL_ARB_separate_shader_objects). Uniforms of a
+	//shared stage are shared too. Returns false, changing nothing, if the driver doesn't support it.
+	//A vertex stage linked without its fragment stage keeps every input active, even ones the fragment stage never
+	//reads, so getActiveAttributeMask() can't drop them. Off by default for that reason
+	static bool enableSeparablePrograms();
+	//Finishes every async shader whose program has linked. use() and the setters also do this for their own shader
+	static void pollPending();
+	//Counts over every shader. Reset once per frame to get per-frame numbers
+	static UniformCallStats getUniformStats() { return s_uniformStats; }
+	static void resetUniformStats();
+	//True once the program has linked. Only call on the GL thread
+	bool isReady();
+	//Blocks until the program has linked
+	void waitUntilReady();
+	//Resolves to whether the program linked. It is set on the GL thread by isReady(), use(), the setters or pollPending()
+	std::shared_future<bool> ready() const { return m_readyFuture; }
+	void setFallback(Shader* fallback);
+	//Recompiles from the source files in the background. The current program keeps drawing until the new one links,
+	//then the uniform values set so far are re-applied to it. Variants are reloaded too
+	void reload();
+	//True if filePath went into this program, directly or through an #include
+	bool usesFile(const std::string& filePath) const;
+	//Compile and link errors from the last build of this shader and its variants, empty if they all linked
+	std::string getErrorLog() const;
+	//Every time a program links (at startup and on reload) its vertex inputs are checked against the layout
+	//and any mismatch is printed once. Checks right away if the program has already linked
+	void expectVertexLayout(const VertexLayout& layout);
+	//Same, for a uniform block that will be fed from a buffer of this many bytes
+	void expectUniformBlock(const std::string& name, GLsizeiptr size);
+	//Bit n is set if the vertex input at location n is used. Asks the fallback while the program isn't ready
+	uint32_t getActiveAttributeMask();
+	const std::vector<ShaderAttribute>& getAttributes() const { return m_vertexStage ? m_vertexStage->m_attributes : m_attributes; }
+	std::vector<ShaderUniformBlock> getUniformBlocks() const;
 	void use();
-	void setFloat(std::string name, float value);
-	void setInt(std::string name, int value);
-	void setMat4(std::string name, const glm::mat4& value);
-	void setVec2(std::string name, const glm::vec2& value);
-	void setVec3(std::string name, const glm::vec3& value);
+	//Below GL 4.1 without GL_ARB_separate_shader_objects, setting a uniform makes this shader's program current
+	void setFloat(std::string_view name, float value);
+	void setFloat(UniformKey key, float value);
+	void setInt(std::string_view name, int value);
+	void setInt(UniformKey key, int value);
+	void setMat4(std::string_view name, const glm::mat4& value);
+	void setMat4(UniformKey key, const glm::mat4& value);
+	void setVec2(std::string_view name, const glm::vec2& value);
+	void setVec2(UniformKey key, const glm::vec2& value);
+	void setVec3(std::string_view name, const glm::vec3& value);
+	void setVec3(UniformKey key, const glm::vec3& value);
+	GLint getUniformLocation(std::string_view name) const;
+	GLint getUniformLocation(UniformKey key) const;
+	//The program, or the pipeline if this shader uses separable programs
+	GLuint getId() const { return m_pipeline ? m_pipeline->id : m_id; }
+	//The program running the given stage. Same as getId() unless this shader uses separable programs
+	GLuint getProgramId(GLenum stage) const;
 private:
+	//A program pipeline and the stage programs last attached to it
+	struct ProgramPipeline
+	{
+		GLuint id;
+		GLuint vertexProgram;
+		GLuint fragmentProgram;
+	};
+
+	//A single separable stage. The other path is empty
+	Shader(GLenum stage, std::string vertexShaderPath, std::string fragmentShaderPath, const ShaderDefines& defines, bool async, bool embedded);
 	Shader(const Shader& r) = delete;
-	std::string readFile(const std::string& filePath);
+	static std::shared_ptr<Shader> getStage(GLenum stage, const std::string& filePath, const ShaderDefines& defines, bool async, bool embedded);
+	static ShaderDefines usedDefines(const std::string& filePath, const ShaderDefines& defines, bool embedded);
+	template<typename Name> void setNamedUniform(Name name, GLenum type, const void* value, uint32_t size);
+	const std::string& getName() const;
+	static std::string readFile(const std::string& filePath, bool embedded);
+	std::string preprocess(const std::string& filePath);
+	static void preprocessFile(const std::string& filePath, const ShaderDefines& defines, bool embedded, std::string& output,
+		std::vector<std::string>& includedFiles, std::vector<std::string>& sourceFiles, int depth);
+	static int sourceFileIndex(const std::string& filePath, std::vector<std::string>& sourceFiles);
+	void startProgram(const std::string& vertexShaderString, const std::string& fragmentShaderString);
+	void finishProgram();
+	void abandonPending();
+	void swapProgram(GLuint program);
 	GLuint compileShader(const char* shaderSource, GLenum type);
-	GLuint m_id;
-};
+	std::string getCompileLog(GLuint shader, GLenum type);
+	void buildUniformTable();
+	void bindUniformBlocks();
+	void reflectAttributes();
+	void validateVertexLayout(const VertexLayout& layout);
+	void validateUniformBlock(const std::string& name, GLsizeiptr size);
+	void addUniform(const char* name, uint32_t nameLength, GLint location, GLenum type, GLint size, uint32_t valueOffset);
+	const UniformSlot* findUniform(std::string_view name) const;
+	const UniformSlot* findUniform(UniformKey key) const;
+	void setUniform(const UniformSlot* slot, GLenum type, const void* value, uint32_t size);
+	void uploadUniform(GLint location, GLenum type, const void* value);
+	//0 until the first program links. Only replaced once a newer program has linked
+	GLuint m_id = 0;
+
+	//Compile state between startProgram and finishProgram
+	bool m_async;
+	bool m_pending = false;
+	bool m_pendingFromCache = false;
+	bool m_linked = false;
+	GLuint m_pendingId = 0;
+	GLuint m_vertexShader = 0;
+	GLuint m_fragmentShader = 0;
+	uint64_t m_cacheKey = 0;
+	Shader* m_fallback = nullptr;
+	std::promise<bool> m_readyPromise;
+	std::shared_future<bool> m_readyFuture;
+	bool m_readyResolved = false;
+	std::string m_errorLog;
+	//Hash of the preprocessed sources last compiled, so a reload with nothing changed is skipped
+	uint64_t m_sourceKey = 0;
+	static std::vector<Shader*> s_pendingShaders;
+	static bool s_hasCompletionStatus;
+
+	//Separable programs. m_stage is 0 for a regular program that has both stages. A pipeline shader has no program
+	//of its own, only m_vertexStage and m_fragmentStage
+	GLenum m_stage = 0;
+	std::string m_stageKey;
+	std::shared_ptr<Shader> m_vertexStage;
+	std::shared_ptr<Shader> m_fragmentStage;
+	ProgramPipeline* m_pipeline = nullptr;
+	static bool s_separable;
+	//Keyed by stage, file and the defines the file uses
+	static std::map<std::string, std::weak_ptr<Shader>> s_stages;
+	static std::map<std::pair<const Shader*, const Shader*>, ProgramPipeline> s_pipelines;
+	static UniformCallStats s_uniformStats;
 
+	std::string m_vertexPath;
+	std::string m_fragmentPath;
+	//Paths of embedded shaders still start with shaders/, but are looked up in the embedded files
+	bool m_embedded = false;
+	static std::string s_embeddedOverrideDirectory;
+	//Sorted by name, so equal sets always produce the same key
+	ShaderDefines m_defines;
+	std::string m_defineKey;
+	//Every file that went into the program. #line directives refer to files by their index here
+	std::vector<std::string> m_sourceFiles;
+	std::vector<std::pair<std::string, std::unique_ptr<Shader>>> m_variants;
+
+	//Reflected after every link
+	std::vector<ShaderAttribute> m_attributes;
+	uint32_t m_attributeMask = 0;
+	std::vector<ShaderUniformBlock> m_uniformBlocks;
+	std::vector<const VertexLayout*> m_expectedLayouts;
+	std::vector<std::pair<std::string, GLsizeiptr>> m_expectedBlocks;
+
+	//Open addressed (linear probing) table of active uniforms, capacity is a power of two
+	std::vector<UniformSlot> m_uniforms;
+	uint32_t m_uniformMask = 0;
+	uint32_t m_uniformCount = 0;
+	//Every uniform name is interned here once, slots point into it
+	std::string m_uniformNames;
+	//Last value set per slot: the GLenum of the setter (0 if never set) followed by the value itself.
+	//Setting the same bytes again skips the GL call, and a reload re-applies them to the new program
+	std::vector<unsigned char> m_uniformValues;
+};
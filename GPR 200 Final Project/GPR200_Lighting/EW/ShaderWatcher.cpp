@@ -0,0 +1,130 @@
+#include "ShaderWatcher.h"
+#include "Shader.h"
+#include <algorithm>
+#include <filesystem>
+#include <chrono>
+#include <map>
+#include <stdio.h>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+	//How long the watcher thread sleeps between checks, so the destructor never waits long on a quiet directory
+	const int WATCH_INTERVAL_MS = 100;
+}
+
+ShaderWatcher::ShaderWatcher(const std::string& directory)
+	: mDirectory(directory), mRunning(true)
+{
+#ifdef __linux__
+	//Editors either rewrite a file in place or write a new one and rename it over the old one
+	mNotifyFd = inotify_init1(IN_CLOEXEC);
+	if (mNotifyFd < 0 || inotify_add_watch(mNotifyFd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+		printf("Failed to watch shader directory %s\n", directory.c_str());
+		return;
+	}
+#endif
+	mThread = std::thread(&ShaderWatcher::run, this);
+}
+
+ShaderWatcher::~ShaderWatcher()
+{
+	mRunning = false;
+	if (mThread.joinable()) {
+		mThread.join();
+	}
+#ifdef __linux__
+	if (mNotifyFd >= 0) {
+		close(mNotifyFd);
+	}
+#endif
+}
+
+void ShaderWatcher::watch(Shader* shader)
+{
+	mShaders.push_back(shader);
+}
+
+void ShaderWatcher::update()
+{
+	std::vector<std::string> changedFiles;
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		changedFiles.swap(mChangedFiles);
+	}
+	if (changedFiles.empty()) {
+		return;
+	}
+	//One save often shows up as several events
+	std::sort(changedFiles.begin(), changedFiles.end());
+	changedFiles.erase(std::unique(changedFiles.begin(), changedFiles.end()), changedFiles.end());
+
+	for (Shader* shader : mShaders)
+	{
+		for (const std::string& file : changedFiles)
+		{
+			if (shader->usesFile(file)) {
+				shader->reload();
+				break;
+			}
+		}
+	}
+}
+
+void ShaderWatcher::queueChange(const std::string& fileName)
+{
+	std::string path = (std::filesystem::path(mDirectory) / fileName).string();
+	std::lock_guard<std::mutex> lock(mMutex);
+	mChangedFiles.push_back(path);
+}
+
+void ShaderWatcher::run()
+{
+#ifdef __linux__
+	while (mRunning)
+	{
+		pollfd descriptor = { mNotifyFd, POLLIN, 0 };
+		if (poll(&descriptor, 1, WATCH_INTERVAL_MS) <= 0) {
+			continue;
+		}
+		alignas(inotify_event) char buffer[4096];
+		ssize_t length = read(mNotifyFd, buffer, sizeof(buffer));
+		for (ssize_t offset = 0; offset < length; )
+		{
+			const inotify_event* event = (const inotify_event*)(buffer + offset);
+			if (event->len > 0) {
+				queueChange(event->name);
+			}
+			offset += sizeof(inotify_event) + event->len;
+		}
+	}
+#else
+	//No change notifications here, so compare modification times
+	std::map<std::string, std::filesystem::file_time_type> writeTimes;
+	bool firstPass = true;
+	while (mRunning)
+	{
+		std::error_code error;
+		for (const std::filesystem::directory_entry& entry : std::filesystem::directory_iterator(mDirectory, error))
+		{
+			std::filesystem::file_time_type writeTime = entry.last_write_time(error);
+			if (error) continue;
+			std::string fileName = entry.path().filename().string();
+			auto existing = writeTimes.find(fileName);
+			if (existing == writeTimes.end() || existing->second != writeTime) {
+				writeTimes[fileName] = writeTime;
+				if (!firstPass) {
+					queueChange(fileName);
+				}
+			}
+		}
+		firstPass = false;
+		std::this_thread::sleep_for(std::chrono::milliseconds(WATCH_INTERVAL_MS));
+	}
+#endif
+}
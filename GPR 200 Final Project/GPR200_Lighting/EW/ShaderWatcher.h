@@ -0,0 +1,35 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+
+class Shader;
+
+/// <summary>
+/// Watches a shader directory on a background thread and reloads the shaders that use a file when it changes.
+/// Uses inotify on Linux and polls modification times everywhere else
+/// </summary>
+class ShaderWatcher
+{
+public:
+	ShaderWatcher(const std::string& directory);
+	~ShaderWatcher();
+	//Variants are reloaded with the shader they came from, so only the shaders created directly need watching
+	void watch(Shader* shader);
+	//Starts a reload of every watched shader that uses a file changed since the last call. Call once per frame on the GL thread
+	void update();
+private:
+	ShaderWatcher(const ShaderWatcher& r) = delete;
+	void run();
+	void queueChange(const std::string& fileName);
+	std::string mDirectory;
+	std::vector<Shader*> mShaders;
+	std::thread mThread;
+	std::atomic<bool> mRunning;
+	//Written by the watcher thread, drained by update()
+	std::mutex mMutex;
+	std::vector<std::string> mChangedFiles;
+	int mNotifyFd = -1;
+};
@@ -1,12 +1,71 @@
 #pragma once
 #include "Mesh.h"
+#include "MeshOptimizer.h"
+#include "MeshCleanup.h"
 #include <glm/gtc/type_ptr.hpp>
+#include <vector>
+#include <thread>
+#include <algorithm>
+#include <unordered_map>
+#include <stdint.h>
+
+//Post-processing passes the generators run on their output, combined as flags
+enum ShapeGenFlags : unsigned int
+{
+	//Reorders triangles and vertices for the post-transform cache and vertex fetch (see MeshOptimizer.h)
+	SHAPEGEN_OPTIMIZE_VERTEX_CACHE = 1 << 0,
+	//Also orders triangles to reduce overdraw, with OVERDRAW_DEFAULT_THRESHOLD
+	SHAPEGEN_OPTIMIZE_OVERDRAW = 1 << 1,
+	//Runs cleanupMesh first, welding duplicated vertices such as the sphere's seam (see MeshCleanup.h)
+	SHAPEGEN_CLEANUP = 1 << 2
+};
+
+//Rows of a shape each generator thread gets at least, so small shapes stay on the calling thread
+const unsigned int SHAPEGEN_ROWS_PER_THREAD = 64;
+
+//Calls body(first, last) over slices of [0, count) on up to one thread per core. Each slice has at least minPerThread
+template<typename Body>
+void parallelFor(unsigned int count, unsigned int minPerThread, const Body& body)
+{
+	unsigned int numThreads = std::max(1u, std::min(std::thread::hardware_concurrency(), count / std::max(1u, minPerThread)));
+	if (numThreads <= 1) {
+		body(0u, count);
+		return;
+	}
+	std::vector<std::thread> threads;
+	threads.reserve(numThreads - 1);
+	unsigned int perThread = (count + numThreads - 1) / numThreads;
+	for (unsigned int first = perThread; first < count; first += perThread) {
+		threads.emplace_back(body, first, std::min(count, first + perThread));
+	}
+	body(0u, std::min(count, perThread));
+	for (std::thread& thread : threads) {
+		thread.join();
+	}
+}
+
+template<typename V>
+void applyShapeGenFlags(BasicMeshData<V>& meshData, unsigned int flags)
+{
+	if (flags & SHAPEGEN_CLEANUP) {
+		cleanupMesh(meshData);
+	}
+	if (flags & SHAPEGEN_OPTIMIZE_OVERDRAW) {
+		optimizeMesh(meshData, OVERDRAW_DEFAULT_THRESHOLD);
+	}
+	else if (flags & SHAPEGEN_OPTIMIZE_VERTEX_CACHE) {
+		optimizeMesh(meshData);
+	}
+}
 
-void createCube(float width, float height, float depth, glm::vec3 color, MeshData& meshData);
-void createSphere(float radius, int numSegments, glm::vec3 color, MeshData& meshData);
-void createCone(float radius, float height, int numSegments, glm::vec3 color, MeshData& meshData);
+//Templated on the vertex type, which only needs a (position, color, normal) constructor
+template<typename V> void createCube(float width, float height, float depth, glm::vec3 color, BasicMeshData<V>& meshData, unsigned int flags = 0);
+template<typename V> void createSphere(float radius, int numSegments, glm::vec3 color, BasicMeshData<V>& meshData, unsigned int flags = 0);
+template<typename V> void createCone(float radius, float height, int numSegments, glm::vec3 color, BasicMeshData<V>& meshData, unsigned int flags = 0);
+template<typename V> void createIcosphere(float radius, int subdivisions, glm::vec3 color, BasicMeshData<V>& meshData, unsigned int flags = 0);
 
-void createCube(float width, float height, float depth, glm::vec3 color, MeshData& meshData)
+template<typename V>
+void createCube(float width, float height, float depth, glm::vec3 color, BasicMeshData<V>& meshData, unsigned int flags)
 {
 	meshData.vertices.clear();
 	meshData.indices.clear();
@@ -17,7 +76,7 @@ void createCube(float width, float height, float depth, glm::vec3 color, MeshDat
 
 	//VERTICES
 	//-------------
-	Vertex vertices[24] = {
+	V vertices[24] = {
 		//Front face
 		{glm::vec3(-halfWidth, -halfHeight, +halfDepth), color, glm::vec3(0,0,1)}, //BL
 		{glm::vec3(+halfWidth, -halfHeight, +halfDepth), color, glm::vec3(0,0,1)}, //BR
@@ -85,129 +144,165 @@ void createCube(float width, float height, float depth, glm::vec3 color, MeshDat
 		22, 23, 20
 	};
 	meshData.indices.assign(&indices[0], &indices[36]);
+
+	applyShapeGenFlags(meshData, flags);
 }
 
-void createSphere(float radius, int numSegments, glm::vec3 color, MeshData& meshData)
+template<typename V>
+void createSphere(float radius, int numSegments, glm::vec3 color, BasicMeshData<V>& meshData, unsigned int flags)
 {
-	meshData.vertices.clear();
-	meshData.indices.clear();
-
 	float topY = radius;
 	float bottomY = -radius;
 
+	//Exact counts: two poles, numSegments - 1 rings of numSegments + 1 (the first and last meet at the seam),
+	//a cap triangle per segment at each pole, and two triangles per quad between rings
+	unsigned int ringVertexCount = numSegments + 1;
+	unsigned int numRings = numSegments - 1;
 	unsigned int topIndex = 0;
-	meshData.vertices.push_back({ glm::vec3(0,topY,0),color,glm::vec3(0,1,0)});
+	unsigned int bottomIndex = 1 + numRings * ringVertexCount;
+	unsigned int numRowQuads = numSegments > 2 ? (numSegments - 2) * numSegments : 0;
+	size_t numIndices = (size_t)6 * numSegments + (size_t)6 * numRowQuads;
+	//Filled in place, so the vertex type needs no default constructor
+	meshData.vertices.assign(bottomIndex + 1, V(glm::vec3(0), color, glm::vec3(0)));
+	meshData.indices.resize(numIndices);
+
+	meshData.vertices[topIndex] = V(glm::vec3(0,topY,0),color,glm::vec3(0,1,0));
+	meshData.vertices[bottomIndex] = V(glm::vec3(0,bottomY,0),color,glm::vec3(0,-1,0));
 
 	//Angle between segments
 	float thetaStep = (2.0f * glm::pi<float>()) / (float)numSegments;
 	float phiStep = (glm::pi<float>()) / (float)numSegments;
 
-	for (int i = 1; i < numSegments; i++)
-	{
-		float phi = phiStep * i;
+	//Every ring uses the same column angles, and every vertex in a ring the same row angle
+	std::vector<float> sinTheta(ringVertexCount);
+	std::vector<float> cosTheta(ringVertexCount);
+	for (unsigned int j = 0; j < ringVertexCount; j++) {
+		float theta = thetaStep * j;
+		sinTheta[j] = sinf(theta);
+		cosTheta[j] = cosf(theta);
+	}
 
-		//Create row
-		for (int j = 0; j <= numSegments; ++j)
+	parallelFor(numRings, SHAPEGEN_ROWS_PER_THREAD, [&](unsigned int firstRing, unsigned int lastRing)
+	{
+		for (unsigned int ring = firstRing; ring < lastRing; ring++)
 		{
-			float theta = thetaStep * j;
-
-			float x = radius * sinf(phi) * sinf(theta);
+			float phi = phiStep * (ring + 1);
+			float sinPhi = sinf(phi);
 			float y = radius * cosf(phi);
-			float z = radius * sinf(phi) * cosf(theta);
 
-			glm::vec3 position = glm::vec3(x, y, z);
-			glm::vec3 normal = glm::normalize(glm::vec3(x, y, z));
+			//Create row
+			V* row = &meshData.vertices[1 + ring * ringVertexCount];
+			for (unsigned int j = 0; j < ringVertexCount; ++j)
+			{
+				float x = radius * sinPhi * sinTheta[j];
+				float z = radius * sinPhi * cosTheta[j];
 
-			meshData.vertices.push_back({ position, color, normal });
-		}
-	}
+				glm::vec3 position = glm::vec3(x, y, z);
+				glm::vec3 normal = glm::normalize(glm::vec3(x, y, z));
 
-	meshData.vertices.push_back({ glm::vec3(0,bottomY,0),color,glm::vec3(0,-1,0)});
-	unsigned int bottomIndex = (unsigned int)meshData.vertices.size() - 1;
-	unsigned int ringVertexCount = numSegments + 1;
+				row[j] = V(position, color, normal);
+			}
+		}
+	});
 
 	//TOP CAP
-	for (int i = 0; i < numSegments; ++i) {
-		meshData.indices.push_back(topIndex); //top cap center 
-		meshData.indices.push_back(i + 1);
-		meshData.indices.push_back(i + 2);
+	unsigned int* indices = meshData.indices.data();
+	for (unsigned int i = 0; i < (unsigned int)numSegments; ++i) {
+		indices[i * 3] = topIndex; //top cap center 
+		indices[i * 3 + 1] = i + 1;
+		indices[i * 3 + 2] = i + 2;
 	}
 
 	//RINGS
 	unsigned int start = 1;
+	unsigned int* rowIndices = indices + 3 * numSegments;
 
 	//Row index
 	//-2 to ignore poles
-	for (int y = 0; y < numSegments - 2; ++y)
+	unsigned int numRows = numSegments > 2 ? numSegments - 2 : 0;
+	parallelFor(numRows, SHAPEGEN_ROWS_PER_THREAD, [&](unsigned int firstRow, unsigned int lastRow)
 	{
-		//Column index
-		for (int x = 0; x < numSegments; ++x)
+		for (unsigned int y = firstRow; y < lastRow; ++y)
 		{
-			//Triangle 1
-			meshData.indices.push_back(start + y * ringVertexCount + x);
-			meshData.indices.push_back(start + (y + 1) * ringVertexCount + x);
-			meshData.indices.push_back(start + y * ringVertexCount + x + 1);
-
-			//Triangle 2
-			meshData.indices.push_back(start + y * ringVertexCount + x + 1);
-			meshData.indices.push_back(start + (y + 1) * ringVertexCount + x);
-			meshData.indices.push_back(start + (y + 1) * ringVertexCount + x + 1);
+			unsigned int* out = rowIndices + (size_t)6 * numSegments * y;
+			//Column index
+			for (unsigned int x = 0; x < (unsigned int)numSegments; ++x)
+			{
+				//Triangle 1
+				*out++ = start + y * ringVertexCount + x;
+				*out++ = start + (y + 1) * ringVertexCount + x;
+				*out++ = start + y * ringVertexCount + x + 1;
+
+				//Triangle 2
+				*out++ = start + y * ringVertexCount + x + 1;
+				*out++ = start + (y + 1) * ringVertexCount + x;
+				*out++ = start + (y + 1) * ringVertexCount + x + 1;
+			}
 		}
-	}
+	});
 
 	start = bottomIndex - ringVertexCount;
 
 	//BOTTOM CAP
-	for (unsigned int i = 0; i < ringVertexCount; ++i) {
-		meshData.indices.push_back(start + i + 1);
-		meshData.indices.push_back(start + i);
-		meshData.indices.push_back(bottomIndex); //bottom cap center 
+	unsigned int* capIndices = rowIndices + (size_t)6 * numRowQuads;
+	for (unsigned int i = 0; i < (unsigned int)numSegments; ++i) {
+		capIndices[i * 3] = start + i + 1;
+		capIndices[i * 3 + 1] = start + i;
+		capIndices[i * 3 + 2] = bottomIndex; //bottom cap center 
 	}
+
+	applyShapeGenFlags(meshData, flags);
 }
 
-inline void createCone(float radius, float height, int numSegments, glm::vec3 color, MeshData& meshData)
+template<typename V>
+void createCone(float radius, float height, int numSegments, glm::vec3 color, BasicMeshData<V>& meshData, unsigned int flags)
 {
-	meshData.vertices.clear();
-	meshData.indices.clear();
-
 	float topY = height * 0.5f;
 	float bottomY = height * -0.5f;
 
+	//Three vertices per segment and the base center. Each segment gets a cap and a side triangle
+	unsigned int ringVerticesLength = numSegments * 3;
+	unsigned int centerIndex = ringVerticesLength;
+	meshData.vertices.assign(ringVerticesLength + 1, V(glm::vec3(0), color, glm::vec3(0)));
+	meshData.indices.resize((size_t)6 * numSegments);
+
 	//Angle between segments
 	float thetaStep = (2.0f * glm::pi<float>()) / (float)numSegments;
 	glm::vec3 topPosition = glm::vec3(0, topY, 0);
 
-	for (int i = 0; i < numSegments; i++)
-	{
-		float theta = i * thetaStep;
-		float cos = cosf(theta);
-		float sin = sinf(theta);
-		float sideLength = sqrtf(radius * radius + height * height);
+	//The side normal only depends on the angle around the cone
+	float sideLength = sqrtf(radius * radius + height * height);
+	float coneX = radius / sideLength;
+	float coneY = -height / sideLength;
 
-		float coneX = radius / sideLength;
-		float coneY = -height / sideLength;
-
-		glm::vec3 ringPosition = glm::vec3(cos * radius, bottomY, sin * radius);
-
-		glm::vec3 normal = glm::vec3(-coneY*cos,coneX,-coneY*sin);
-		normal = glm::normalize(normal);
-		//bottom vertex down
-		meshData.vertices.push_back({ ringPosition, color, glm::vec3(0,-1,0) });
-		//bottom vertex side
-		meshData.vertices.push_back({ ringPosition, color, normal });
-		//top vertex w/ side normal
-		meshData.vertices.push_back({ topPosition, color, normal });
-	}
+	parallelFor(numSegments, SHAPEGEN_ROWS_PER_THREAD * 64, [&](unsigned int firstSegment, unsigned int lastSegment)
+	{
+		for (unsigned int i = firstSegment; i < lastSegment; i++)
+		{
+			float theta = i * thetaStep;
+			float cosTheta = cosf(theta);
+			float sinTheta = sinf(theta);
+
+			glm::vec3 ringPosition = glm::vec3(cosTheta * radius, bottomY, sinTheta * radius);
+
+			glm::vec3 normal = glm::vec3(-coneY*cosTheta,coneX,-coneY*sinTheta);
+			normal = glm::normalize(normal);
+			//bottom vertex down
+			meshData.vertices[i * 3] = V(ringPosition, color, glm::vec3(0,-1,0));
+			//bottom vertex side
+			meshData.vertices[i * 3 + 1] = V(ringPosition, color, normal);
+			//top vertex w/ side normal
+			meshData.vertices[i * 3 + 2] = V(topPosition, color, normal);
+		}
+	});
 
 	//Base center
-	meshData.vertices.push_back({ glm::vec3(0, bottomY, 0), color, glm::vec3(0,-1,0)});
-
-	unsigned int centerIndex = (unsigned int)meshData.vertices.size() - 1;
+	meshData.vertices[centerIndex] = V(glm::vec3(0, bottomY, 0), color, glm::vec3(0,-1,0));
 
 	//Indices
-	for (unsigned int i = 0; i <= (unsigned int)numSegments*3; i+=3)
+	unsigned int* out = meshData.indices.data();
+	for (unsigned int i = 0; i < ringVerticesLength; i+=3)
 	{
-		int ringVerticesLength = numSegments * 3;
 		unsigned int bottomRingIndex = i % ringVerticesLength;
 		unsigned int sideRingIndex = (i+1) % ringVerticesLength;
 		unsigned int topIndex = (i + 2) % ringVerticesLength;
@@ -215,13 +310,172 @@ inline void createCone(float radius, float height, int numSegments, glm::vec3 co
 		unsigned int nextSideRingIndex = (sideRingIndex + 3) % ringVerticesLength;
 
 		//Bottom cap triangle
-		meshData.indices.push_back(bottomRingIndex);
-		meshData.indices.push_back(nextBottomRingIndex);
-		meshData.indices.push_back(centerIndex);
+		*out++ = bottomRingIndex;
+		*out++ = nextBottomRingIndex;
+		*out++ = centerIndex;
 
 		//Side triangle
-		meshData.indices.push_back(nextSideRingIndex);
-		meshData.indices.push_back(sideRingIndex);
-		meshData.indices.push_back(topIndex);
+		*out++ = nextSideRingIndex;
+		*out++ = sideRingIndex;
+		*out++ = topIndex;
+	}
+
+	applyShapeGenFlags(meshData, flags);
+}
+
+//Starts from an icosahedron and splits every triangle into four, subdivisions times, pushing the new vertices out
+//onto the sphere. Each edge's midpoint is made once and looked up by its edge after that, so the triangles on both
+//sides share it. Unlike createSphere there is no seam and no pole: every vertex is shared by 5 or 6 triangles and
+//the triangles are all about the same size
+template<typename V>
+void createIcosphere(float radius, int subdivisions, glm::vec3 color, BasicMeshData<V>& meshData, unsigned int flags)
+{
+	//An icosahedron has 12 vertices and 20 faces. Every subdivision quadruples the faces and adds a vertex per edge
+	size_t numFaces = (size_t)20 << (2 * subdivisions);
+	size_t numVertices = numFaces / 2 + 2;
+
+	//Unit directions until the end, where they become both the position and the normal
+	std::vector<glm::vec3> directions;
+	directions.reserve(numVertices);
+	float t = (1.0f + sqrtf(5.0f)) * 0.5f;
+	glm::vec3 corners[12] = {
+		{ -1, t, 0 }, { 1, t, 0 }, { -1, -t, 0 }, { 1, -t, 0 },
+		{ 0, -1, t }, { 0, 1, t }, { 0, -1, -t }, { 0, 1, -t },
+		{ t, 0, -1 }, { t, 0, 1 }, { -t, 0, -1 }, { -t, 0, 1 }
+	};
+	for (const glm::vec3& corner : corners) {
+		directions.push_back(glm::normalize(corner));
+	}
+
+	std::vector<unsigned int> indices = {
+		0, 11, 5,	0, 5, 1,	0, 1, 7,	0, 7, 10,	0, 10, 11,
+		1, 5, 9,	5, 11, 4,	11, 10, 2,	10, 7, 6,	7, 1, 8,
+		3, 9, 4,	3, 4, 2,	3, 2, 6,	3, 6, 8,	3, 8, 9,
+		4, 9, 5,	2, 4, 11,	6, 2, 10,	8, 6, 7,	9, 8, 1
+	};
+	std::vector<unsigned int> subdivided;
+	//Keyed by the edge's two vertices, lowest first
+	std::unordered_map<uint64_t, unsigned int> midpoints;
+	auto getMidpoint = [&](unsigned int a, unsigned int b)
+	{
+		uint64_t key = a < b ? ((uint64_t)a << 32) | b : ((uint64_t)b << 32) | a;
+		auto found = midpoints.emplace(key, (unsigned int)directions.size());
+		if (found.second) {
+			directions.push_back(glm::normalize(directions[a] + directions[b]));
+		}
+		return found.first->second;
+	};
+
+	for (int i = 0; i < subdivisions; i++)
+	{
+		//Every edge is shared by two triangles, so there are half as many edges as indices
+		midpoints.clear();
+		midpoints.reserve(indices.size() / 2);
+		subdivided.clear();
+		subdivided.reserve(indices.size() * 4);
+		for (size_t j = 0; j < indices.size(); j += 3)
+		{
+			unsigned int a = indices[j];
+			unsigned int b = indices[j + 1];
+			unsigned int c = indices[j + 2];
+			unsigned int ab = getMidpoint(a, b);
+			unsigned int bc = getMidpoint(b, c);
+			unsigned int ca = getMidpoint(c, a);
+			unsigned int triangles[12] = { a, ab, ca,	b, bc, ab,	c, ca, bc,	ab, bc, ca };
+			subdivided.insert(subdivided.end(), triangles, triangles + 12);
+		}
+		indices.swap(subdivided);
+	}
+
+	meshData.vertices.clear();
+	meshData.vertices.reserve(directions.size());
+	for (const glm::vec3& direction : directions) {
+		meshData.vertices.push_back(V(direction * radius, color, direction));
+	}
+	meshData.indices = std::move(indices);
+
+	applyShapeGenFlags(meshData, flags);
+}
+
+//Furthest the flat triangles of a mesh whose vertices lie on a sphere around the origin dip inside it, as a fraction
+//of the radius. Degenerate triangles are skipped
+template<typename V>
+float computeSphereError(const BasicMeshData<V>& meshData, float radius)
+{
+	float minDistance = radius;
+	for (size_t i = 0; i + 2 < meshData.indices.size(); i += 3)
+	{
+		glm::vec3 a = VertexFormat<V>::position(meshData.vertices[meshData.indices[i]]);
+		glm::vec3 b = VertexFormat<V>::position(meshData.vertices[meshData.indices[i + 1]]);
+		glm::vec3 c = VertexFormat<V>::position(meshData.vertices[meshData.indices[i + 2]]);
+		glm::vec3 normal = glm::cross(b - a, c - a);
+		float length = glm::length(normal);
+		if (length > 0.0f) {
+			minDistance = glm::min(minDistance, fabsf(glm::dot(normal, a)) / length);
+		}
+	}
+	return 1.0f - minDistance / radius;
+}
+
+//Fewest segments a regenerated level of detail gets
+const int MIN_LOD_SEGMENTS = 4;
+
+//Appends meshData as the next level of detail. Its vertices are added to the chain's
+template<typename V>
+void appendLod(BasicMeshLodChain<V>& lodChain, const BasicMeshData<V>& meshData, float error)
+{
+	unsigned int firstVertex = (unsigned int)lodChain.vertices.size();
+	lodChain.vertices.insert(lodChain.vertices.end(), meshData.vertices.begin(), meshData.vertices.end());
+	MeshLod lod;
+	lod.error = error;
+	lod.indices.reserve(meshData.indices.size());
+	for (unsigned int index : meshData.indices) {
+		lod.indices.push_back(firstVertex + index);
+	}
+	lodChain.levels.push_back(lod);
+}
+
+//numLevels spheres, halving the segments each level. A ring of n segments strays at most 1 - cos(pi / n) of the
+//radius from the true sphere
+template<typename V>
+void createSphereLods(float radius, int numSegments, glm::vec3 color, int numLevels, BasicMeshLodChain<V>& lodChain, unsigned int flags = 0)
+{
+	lodChain.vertices.clear();
+	lodChain.levels.clear();
+	for (int level = 0; level < numLevels && numSegments >= MIN_LOD_SEGMENTS; level++, numSegments /= 2)
+	{
+		BasicMeshData<V> meshData;
+		createSphere(radius, numSegments, color, meshData, flags);
+		appendLod(lodChain, meshData, level == 0 ? 0.0f : 1.0f - cosf(glm::pi<float>() / numSegments));
+	}
+}
+
+//numLevels icospheres, one subdivision fewer each level
+template<typename V>
+void createIcosphereLods(float radius, int subdivisions, glm::vec3 color, int numLevels, BasicMeshLodChain<V>& lodChain, unsigned int flags = 0)
+{
+	lodChain.vertices.clear();
+	lodChain.levels.clear();
+	for (int level = 0; level < numLevels && subdivisions >= 0; level++, subdivisions--)
+	{
+		BasicMeshData<V> meshData;
+		createIcosphere(radius, subdivisions, color, meshData, flags);
+		appendLod(lodChain, meshData, level == 0 ? 0.0f : computeSphereError(meshData, radius));
+	}
+}
+
+//Same for the cone. Only the base ring is curved, and the bounding radius reaches the rim
+template<typename V>
+void createConeLods(float radius, float height, int numSegments, glm::vec3 color, int numLevels, BasicMeshLodChain<V>& lodChain, unsigned int flags = 0)
+{
+	lodChain.vertices.clear();
+	lodChain.levels.clear();
+	float boundingRadius = sqrtf(radius * radius + height * height * 0.25f);
+	for (int level = 0; level < numLevels && numSegments >= MIN_LOD_SEGMENTS; level++, numSegments /= 2)
+	{
+		BasicMeshData<V> meshData;
+		createCone(radius, height, numSegments, color, meshData, flags);
+		float ringError = radius * (1.0f - cosf(glm::pi<float>() / numSegments));
+		appendLod(lodChain, meshData, level == 0 ? 0.0f : ringError / boundingRadius);
 	}
 }
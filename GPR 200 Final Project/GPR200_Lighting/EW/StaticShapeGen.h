@@ -0,0 +1,332 @@
+#pragma once
+#include "Mesh.h"
+#include <array>
+#include <utility>
+#include <stdint.h>
+
+//Compile time versions of the ShapeGen generators. Use them with constexpr for shapes whose parameters are
+//constants, e.g. static constexpr auto sphere = makeSphere<16>(0.5f). The tables are built by the compiler,
+//end up in read-only memory and are uploaded as is, so nothing is generated or allocated at startup.
+//Segment counts are template parameters because they size the arrays. Compilers cap how much work a constant
+//expression may do (MSVC's /constexpr:steps, -fconstexpr-ops-limit, -fconstexpr-steps), so keep them low and
+//use createSphere/createCone for anything detailed
+
+//Math the standard library doesn't offer as constexpr. Accurate to within a float ulp or so of sinf, cosf and sqrtf
+constexpr double constexprSin(double x)
+{
+	const double twoPi = 6.283185307179586476925;
+	double turns = x / twoPi;
+	x -= twoPi * (double)(long long)(turns + (turns >= 0.0 ? 0.5 : -0.5));
+	double term = x;
+	double sum = x;
+	for (int n = 1; n < 12; n++)
+	{
+		term *= -x * x / ((2 * n) * (2 * n + 1));
+		sum += term;
+	}
+	return sum;
+}
+
+constexpr double constexprCos(double x)
+{
+	const double twoPi = 6.283185307179586476925;
+	double turns = x / twoPi;
+	x -= twoPi * (double)(long long)(turns + (turns >= 0.0 ? 0.5 : -0.5));
+	double term = 1.0;
+	double sum = 1.0;
+	for (int n = 1; n < 12; n++)
+	{
+		term *= -x * x / ((2 * n - 1) * (2 * n));
+		sum += term;
+	}
+	return sum;
+}
+
+constexpr double constexprSqrt(double x)
+{
+	if (x <= 0.0) {
+		return 0.0;
+	}
+	double root = x > 1.0 ? x : 1.0;
+	for (int i = 0; i < 64; i++)
+	{
+		double next = 0.5 * (root + x / root);
+		if (next >= root) {
+			break;
+		}
+		root = next;
+	}
+	return root;
+}
+
+//Same bits as glm::packHalf1x16 for finite values, except that -0 packs as +0
+constexpr uint16_t constexprPackHalf(float value)
+{
+	uint32_t sign = value < 0.0f ? 0x8000 : 0;
+	float magnitude = value < 0.0f ? -value : value;
+	//Anything under 2^-25 is flushed to zero, like glm does
+	if (magnitude < 1.0f / 33554432.0f) {
+		return (uint16_t)sign;
+	}
+	if (magnitude >= 65536.0f) {
+		return (uint16_t)(sign | 0x7c00);
+	}
+	//Split into magnitude = (1 + mantissa / 2^23) * 2^exponent. Scaling by 2 is exact, so this is too
+	int exponent = 0;
+	while (magnitude >= 2.0f) {
+		magnitude *= 0.5f;
+		exponent++;
+	}
+	while (magnitude < 1.0f) {
+		magnitude *= 2.0f;
+		exponent--;
+	}
+	uint32_t mantissa = (uint32_t)((magnitude - 1.0f) * 8388608.0f);
+
+	//The rest follows glm's toFloat16: round to nearest, 0.5 rounds up
+	int halfExponent = exponent + 15;
+	if (halfExponent <= 0) {
+		mantissa = (mantissa | 0x00800000) >> (1 - halfExponent);
+		if (mantissa & 0x00001000) {
+			mantissa += 0x00002000;
+		}
+		return (uint16_t)(sign | (mantissa >> 13));
+	}
+	if (mantissa & 0x00001000) {
+		mantissa += 0x00002000;
+		if (mantissa & 0x00800000) {
+			mantissa = 0;
+			halfExponent++;
+		}
+	}
+	if (halfExponent > 30) {
+		return (uint16_t)(sign | 0x7c00);
+	}
+	return (uint16_t)(sign | (halfExponent << 10) | (mantissa >> 13));
+}
+
+//Same bits as glm::packSnorm3x10_1x2 with w = 0
+constexpr uint32_t constexprPackSnorm3x10(float x, float y, float z)
+{
+	float components[3] = { x, y, z };
+	uint32_t packed = 0;
+	for (int i = 0; i < 3; i++)
+	{
+		float scaled = (components[i] < -1.0f ? -1.0f : components[i] > 1.0f ? 1.0f : components[i]) * 511.0f;
+		//Rounds half away from zero, like std::round
+		int rounded = (int)scaled;
+		float fraction = scaled - (float)rounded;
+		if (fraction >= 0.5f) {
+			rounded++;
+		}
+		else if (fraction <= -0.5f) {
+			rounded--;
+		}
+		packed |= ((uint32_t)rounded & 0x3ff) << (10 * i);
+	}
+	return packed;
+}
+
+/// <summary>
+/// A vertex before it is stored as its final type
+/// </summary>
+struct StaticVertex {
+	float position[3];
+	float normal[3];
+};
+
+//How the make* functions build a vertex type at compile time. By default through a constexpr (position, color, normal)
+//constructor. Specialize it for vertex types whose constructor can't be constexpr
+template<typename V>
+struct StaticVertexFormat {
+	static constexpr V make(const StaticVertex& vertex, glm::vec3 color)
+	{
+		return V(glm::vec3(vertex.position[0], vertex.position[1], vertex.position[2]), color,
+			glm::vec3(vertex.normal[0], vertex.normal[1], vertex.normal[2]));
+	}
+};
+
+template<>
+struct StaticVertexFormat<CompactVertex> {
+	//CompactVertex has no color
+	static constexpr CompactVertex make(const StaticVertex& vertex, glm::vec3)
+	{
+		return CompactVertex(constexprPackHalf(vertex.position[0]), constexprPackHalf(vertex.position[1]),
+			constexprPackHalf(vertex.position[2]), constexprPackSnorm3x10(vertex.normal[0], vertex.normal[1], vertex.normal[2]));
+	}
+};
+
+template<typename V, size_t NumVertices, size_t... I>
+constexpr std::array<V, NumVertices> makeStaticVertices(const std::array<StaticVertex, NumVertices>& vertices, glm::vec3 color,
+	std::index_sequence<I...>)
+{
+	return { { StaticVertexFormat<V>::make(vertices[I], color)... } };
+}
+
+template<typename V, size_t NumVertices, size_t NumIndices>
+constexpr StaticMeshData<V, NumVertices, NumIndices> makeStaticMeshData(const std::array<StaticVertex, NumVertices>& vertices,
+	const std::array<unsigned short, NumIndices>& indices, glm::vec3 color)
+{
+	double maxLengthSquared = 0.0;
+	for (const StaticVertex& vertex : vertices)
+	{
+		double lengthSquared = (double)vertex.position[0] * vertex.position[0]
+			+ (double)vertex.position[1] * vertex.position[1] + (double)vertex.position[2] * vertex.position[2];
+		maxLengthSquared = lengthSquared > maxLengthSquared ? lengthSquared : maxLengthSquared;
+	}
+	return { makeStaticVertices<V>(vertices, color, std::make_index_sequence<NumVertices>()), indices,
+		(float)constexprSqrt(maxLengthSquared) };
+}
+
+//Same vertices and triangles as createCube
+template<typename V = Vertex>
+constexpr StaticMeshData<V, 24, 36> makeCube(float width, float height, float depth, glm::vec3 color = glm::vec3(1.0f))
+{
+	float w = width / 2.0f;
+	float h = height / 2.0f;
+	float d = depth / 2.0f;
+
+	std::array<StaticVertex, 24> vertices = { {
+		//Front face
+		{ { -w, -h, +d }, { 0, 0, 1 } }, { { +w, -h, +d }, { 0, 0, 1 } }, { { +w, +h, +d }, { 0, 0, 1 } }, { { -w, +h, +d }, { 0, 0, 1 } },
+		//Back face
+		{ { +w, -h, -d }, { 0, 0, -1 } }, { { -w, -h, -d }, { 0, 0, -1 } }, { { -w, +h, -d }, { 0, 0, -1 } }, { { +w, +h, -d }, { 0, 0, -1 } },
+		//Right face
+		{ { +w, -h, +d }, { 1, 0, 0 } }, { { +w, -h, -d }, { 1, 0, 0 } }, { { +w, +h, -d }, { 1, 0, 0 } }, { { +w, +h, +d }, { 1, 0, 0 } },
+		//Left face
+		{ { -w, -h, -d }, { -1, 0, 0 } }, { { -w, -h, +d }, { -1, 0, 0 } }, { { -w, +h, +d }, { -1, 0, 0 } }, { { -w, +h, -d }, { -1, 0, 0 } },
+		//Top face
+		{ { -w, +h, +d }, { 0, 1, 0 } }, { { +w, +h, +d }, { 0, 1, 0 } }, { { +w, +h, -d }, { 0, 1, 0 } }, { { -w, +h, -d }, { 0, 1, 0 } },
+		//Bottom face
+		{ { -w, -h, -d }, { 0, -1, 0 } }, { { +w, -h, -d }, { 0, -1, 0 } }, { { +w, -h, +d }, { 0, -1, 0 } }, { { -w, -h, +d }, { 0, -1, 0 } }
+	} };
+	std::array<unsigned short, 36> indices = { {
+		0, 1, 2, 0, 2, 3,
+		4, 5, 6, 6, 7, 4,
+		8, 9, 10, 10, 11, 8,
+		12, 13, 14, 14, 15, 12,
+		16, 17, 18, 18, 19, 16,
+		20, 21, 22, 22, 23, 20
+	} };
+	return makeStaticMeshData<V>(vertices, indices, color);
+}
+
+//Same vertex layout and winding as createSphere: a vertex at each pole and NumSegments - 1 rings of NumSegments + 1
+template<int NumSegments, typename V = Vertex>
+constexpr StaticMeshData<V, 2 + (NumSegments - 1) * (NumSegments + 1), 6 * NumSegments * (NumSegments - 1)>
+	makeSphere(float radius, glm::vec3 color = glm::vec3(1.0f))
+{
+	static_assert(NumSegments >= 3, "A sphere needs at least 3 segments");
+	const unsigned short ringVertexCount = NumSegments + 1;
+	const unsigned short bottomIndex = 1 + (NumSegments - 1) * ringVertexCount;
+	const double pi = 3.14159265358979323846;
+	float thetaStep = (float)(2.0 * pi / NumSegments);
+	float phiStep = (float)(pi / NumSegments);
+
+	//Every ring uses the same column angles
+	std::array<float, NumSegments + 1> sinTheta = {};
+	std::array<float, NumSegments + 1> cosTheta = {};
+	for (int j = 0; j <= NumSegments; j++)
+	{
+		sinTheta[j] = (float)constexprSin(thetaStep * j);
+		cosTheta[j] = (float)constexprCos(thetaStep * j);
+	}
+
+	std::array<StaticVertex, 2 + (NumSegments - 1) * (NumSegments + 1)> vertices = {};
+	vertices[0] = { { 0, radius, 0 }, { 0, 1, 0 } };
+	vertices[bottomIndex] = { { 0, -radius, 0 }, { 0, -1, 0 } };
+	for (int i = 1; i < NumSegments; i++)
+	{
+		float sinPhi = (float)constexprSin(phiStep * i);
+		float y = radius * (float)constexprCos(phiStep * i);
+		for (int j = 0; j <= NumSegments; j++)
+		{
+			float x = radius * sinPhi * sinTheta[j];
+			float z = radius * sinPhi * cosTheta[j];
+			vertices[1 + (i - 1) * ringVertexCount + j] = { { x, y, z }, { x / radius, y / radius, z / radius } };
+		}
+	}
+
+	std::array<unsigned short, 6 * NumSegments * (NumSegments - 1)> indices = {};
+	size_t index = 0;
+	//TOP CAP
+	for (int i = 0; i < NumSegments; i++)
+	{
+		indices[index++] = 0;
+		indices[index++] = (unsigned short)(i + 1);
+		indices[index++] = (unsigned short)(i + 2);
+	}
+	//RINGS
+	for (int y = 0; y < NumSegments - 2; y++)
+	{
+		for (int x = 0; x < NumSegments; x++)
+		{
+			unsigned short current = (unsigned short)(1 + y * ringVertexCount + x);
+			unsigned short below = (unsigned short)(current + ringVertexCount);
+			indices[index++] = current;
+			indices[index++] = below;
+			indices[index++] = (unsigned short)(current + 1);
+			indices[index++] = (unsigned short)(current + 1);
+			indices[index++] = below;
+			indices[index++] = (unsigned short)(below + 1);
+		}
+	}
+	//BOTTOM CAP
+	unsigned short start = bottomIndex - ringVertexCount;
+	for (int i = 0; i < NumSegments; i++)
+	{
+		indices[index++] = (unsigned short)(start + i + 1);
+		indices[index++] = (unsigned short)(start + i);
+		indices[index++] = bottomIndex;
+	}
+	return makeStaticMeshData<V>(vertices, indices, color);
+}
+
+//Same vertex layout and winding as createCone: a base vertex, a side vertex and a tip per segment, then the base center
+template<int NumSegments, typename V = Vertex>
+constexpr StaticMeshData<V, 3 * NumSegments + 1, 6 * NumSegments>
+	makeCone(float radius, float height, glm::vec3 color = glm::vec3(1.0f))
+{
+	static_assert(NumSegments >= 3, "A cone needs at least 3 segments");
+	const unsigned short ringVerticesLength = 3 * NumSegments;
+	const unsigned short centerIndex = ringVerticesLength;
+	const double pi = 3.14159265358979323846;
+	float thetaStep = (float)(2.0 * pi / NumSegments);
+	float topY = height * 0.5f;
+	float bottomY = height * -0.5f;
+
+	//The side normal only depends on the angle around the cone, and is already unit length
+	float sideLength = (float)constexprSqrt((double)radius * radius + (double)height * height);
+	float coneX = radius / sideLength;
+	float coneY = -height / sideLength;
+
+	std::array<StaticVertex, 3 * NumSegments + 1> vertices = {};
+	for (int i = 0; i < NumSegments; i++)
+	{
+		float cosTheta = (float)constexprCos(thetaStep * i);
+		float sinTheta = (float)constexprSin(thetaStep * i);
+		float x = cosTheta * radius;
+		float z = sinTheta * radius;
+		StaticVertex side = { { x, bottomY, z }, { -coneY * cosTheta, coneX, -coneY * sinTheta } };
+		vertices[i * 3] = { { x, bottomY, z }, { 0, -1, 0 } };
+		vertices[i * 3 + 1] = side;
+		vertices[i * 3 + 2] = { { 0, topY, 0 }, { side.normal[0], side.normal[1], side.normal[2] } };
+	}
+	vertices[centerIndex] = { { 0, bottomY, 0 }, { 0, -1, 0 } };
+
+	std::array<unsigned short, 6 * NumSegments> indices = {};
+	size_t index = 0;
+	for (unsigned short i = 0; i < ringVerticesLength; i += 3)
+	{
+		unsigned short next = (unsigned short)((i + 3) % ringVerticesLength);
+		//Bottom cap triangle
+		indices[index++] = i;
+		indices[index++] = next;
+		indices[index++] = centerIndex;
+		//Side triangle
+		indices[index++] = (unsigned short)(next + 1);
+		indices[index++] = (unsigned short)(i + 1);
+		indices[index++] = (unsigned short)(i + 2);
+	}
+	return makeStaticMeshData<V>(vertices, indices, color);
+}
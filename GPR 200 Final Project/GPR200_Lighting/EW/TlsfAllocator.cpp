@@ -0,0 +1,240 @@
+#include "TlsfAllocator.h"
+#include <algorithm>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace
+{
+	//Position of the lowest and highest set bit. value must not be 0
+	uint32_t lowestBit(uint32_t value)
+	{
+#ifdef _MSC_VER
+		unsigned long index;
+		_BitScanForward(&index, value);
+		return index;
+#else
+		return (uint32_t)__builtin_ctz(value);
+#endif
+	}
+
+	uint32_t highestBit(uint32_t value)
+	{
+#ifdef _MSC_VER
+		unsigned long index;
+		_BitScanReverse(&index, value);
+		return index;
+#else
+		return 31 - (uint32_t)__builtin_clz(value);
+#endif
+	}
+}
+
+TlsfAllocator::TlsfAllocator(uint32_t capacity)
+{
+	mFirstLevelMap = 0;
+	std::fill(std::begin(mSecondLevelMaps), std::end(mSecondLevelMaps), 0u);
+	for (uint32_t (&bins)[SECOND_LEVEL_COUNT] : mFreeLists) {
+		std::fill(std::begin(bins), std::end(bins), TLSF_INVALID_BLOCK);
+	}
+	mLastBlock = TLSF_INVALID_BLOCK;
+	mCapacity = 0;
+	mUsed = 0;
+	grow(capacity);
+}
+
+//Sizes below SECOND_LEVEL_COUNT each get a bin of their own in first level 0. Above that, each power of two is split
+//into SECOND_LEVEL_COUNT bins
+void TlsfAllocator::mapping(uint32_t size, uint32_t& firstLevel, uint32_t& secondLevel)
+{
+	if (size < SECOND_LEVEL_COUNT) {
+		firstLevel = 0;
+		secondLevel = size;
+		return;
+	}
+	uint32_t bit = highestBit(size);
+	firstLevel = bit - SECOND_LEVEL_BITS + 1;
+	secondLevel = (size >> (bit - SECOND_LEVEL_BITS)) ^ SECOND_LEVEL_COUNT;
+}
+
+uint32_t TlsfAllocator::newBlock(uint32_t offset, uint32_t size)
+{
+	Block block = { offset, size, TLSF_INVALID_BLOCK, TLSF_INVALID_BLOCK, TLSF_INVALID_BLOCK, TLSF_INVALID_BLOCK, false };
+	if (!mUnusedBlocks.empty()) {
+		uint32_t id = mUnusedBlocks.back();
+		mUnusedBlocks.pop_back();
+		mBlocks[id] = block;
+		return id;
+	}
+	mBlocks.push_back(block);
+	return (uint32_t)mBlocks.size() - 1;
+}
+
+void TlsfAllocator::insertFree(uint32_t block)
+{
+	uint32_t firstLevel, secondLevel;
+	mapping(mBlocks[block].size, firstLevel, secondLevel);
+	uint32_t head = mFreeLists[firstLevel][secondLevel];
+	mBlocks[block].isFree = true;
+	mBlocks[block].prevFree = TLSF_INVALID_BLOCK;
+	mBlocks[block].nextFree = head;
+	if (head != TLSF_INVALID_BLOCK) {
+		mBlocks[head].prevFree = block;
+	}
+	mFreeLists[firstLevel][secondLevel] = block;
+	mFirstLevelMap |= 1u << firstLevel;
+	mSecondLevelMaps[firstLevel] |= 1u << secondLevel;
+}
+
+void TlsfAllocator::removeFree(uint32_t block)
+{
+	uint32_t firstLevel, secondLevel;
+	mapping(mBlocks[block].size, firstLevel, secondLevel);
+	Block& removed = mBlocks[block];
+	if (removed.prevFree != TLSF_INVALID_BLOCK) {
+		mBlocks[removed.prevFree].nextFree = removed.nextFree;
+	}
+	else {
+		mFreeLists[firstLevel][secondLevel] = removed.nextFree;
+	}
+	if (removed.nextFree != TLSF_INVALID_BLOCK) {
+		mBlocks[removed.nextFree].prevFree = removed.prevFree;
+	}
+	removed.isFree = false;
+	if (mFreeLists[firstLevel][secondLevel] == TLSF_INVALID_BLOCK) {
+		mSecondLevelMaps[firstLevel] &= ~(1u << secondLevel);
+		if (mSecondLevelMaps[firstLevel] == 0) {
+			mFirstLevelMap &= ~(1u << firstLevel);
+		}
+	}
+}
+
+//First block of the smallest bin whose every block fits size. The size is rounded up to the next bin first,
+//so the block found never needs checking
+uint32_t TlsfAllocator::findFree(uint32_t size) const
+{
+	uint64_t rounded = size;
+	if (size >= SECOND_LEVEL_COUNT) {
+		rounded += (1u << (highestBit(size) - SECOND_LEVEL_BITS)) - 1;
+	}
+	if (rounded > UINT32_MAX) {
+		return TLSF_INVALID_BLOCK;
+	}
+	uint32_t firstLevel, secondLevel;
+	mapping((uint32_t)rounded, firstLevel, secondLevel);
+
+	uint32_t secondLevelMap = mSecondLevelMaps[firstLevel] & (~0u << secondLevel);
+	if (secondLevelMap == 0) {
+		uint32_t firstLevelMap = firstLevel + 1 < 32 ? mFirstLevelMap & (~0u << (firstLevel + 1)) : 0;
+		if (firstLevelMap == 0) {
+			return TLSF_INVALID_BLOCK;
+		}
+		firstLevel = lowestBit(firstLevelMap);
+		secondLevelMap = mSecondLevelMaps[firstLevel];
+	}
+	return mFreeLists[firstLevel][lowestBit(secondLevelMap)];
+}
+
+uint32_t TlsfAllocator::allocate(uint32_t size)
+{
+	size = std::max(size, 1u);
+	uint32_t block = findFree(size);
+	if (block == TLSF_INVALID_BLOCK) {
+		return TLSF_INVALID_BLOCK;
+	}
+	removeFree(block);
+
+	//Whatever is left over goes back as a free block right after it
+	if (mBlocks[block].size > size) {
+		uint32_t remainder = newBlock(mBlocks[block].offset + size, mBlocks[block].size - size);
+		uint32_t next = mBlocks[block].nextPhysical;
+		mBlocks[remainder].prevPhysical = block;
+		mBlocks[remainder].nextPhysical = next;
+		if (next != TLSF_INVALID_BLOCK) {
+			mBlocks[next].prevPhysical = remainder;
+		}
+		else {
+			mLastBlock = remainder;
+		}
+		mBlocks[block].nextPhysical = remainder;
+		mBlocks[block].size = size;
+		insertFree(remainder);
+	}
+	mUsed += size;
+	return block;
+}
+
+void TlsfAllocator::free(uint32_t block)
+{
+	if (block == TLSF_INVALID_BLOCK || mBlocks[block].isFree) {
+		return;
+	}
+	mUsed -= mBlocks[block].size;
+
+	//Merge with the next and previous blocks if they are free, so free ranges never sit side by side
+	uint32_t next = mBlocks[block].nextPhysical;
+	if (next != TLSF_INVALID_BLOCK && mBlocks[next].isFree) {
+		removeFree(next);
+		mBlocks[block].size += mBlocks[next].size;
+		mBlocks[block].nextPhysical = mBlocks[next].nextPhysical;
+		if (mBlocks[next].nextPhysical != TLSF_INVALID_BLOCK) {
+			mBlocks[mBlocks[next].nextPhysical].prevPhysical = block;
+		}
+		else {
+			mLastBlock = block;
+		}
+		mUnusedBlocks.push_back(next);
+	}
+	uint32_t prev = mBlocks[block].prevPhysical;
+	if (prev != TLSF_INVALID_BLOCK && mBlocks[prev].isFree) {
+		removeFree(prev);
+		mBlocks[prev].size += mBlocks[block].size;
+		mBlocks[prev].nextPhysical = mBlocks[block].nextPhysical;
+		if (mBlocks[block].nextPhysical != TLSF_INVALID_BLOCK) {
+			mBlocks[mBlocks[block].nextPhysical].prevPhysical = prev;
+		}
+		else {
+			mLastBlock = prev;
+		}
+		mUnusedBlocks.push_back(block);
+		block = prev;
+	}
+	insertFree(block);
+}
+
+void TlsfAllocator::grow(uint32_t newCapacity)
+{
+	if (newCapacity <= mCapacity) {
+		return;
+	}
+	uint32_t added = newCapacity - mCapacity;
+	if (mLastBlock != TLSF_INVALID_BLOCK && mBlocks[mLastBlock].isFree) {
+		removeFree(mLastBlock);
+		mBlocks[mLastBlock].size += added;
+		insertFree(mLastBlock);
+	}
+	else {
+		uint32_t block = newBlock(mCapacity, added);
+		mBlocks[block].prevPhysical = mLastBlock;
+		if (mLastBlock != TLSF_INVALID_BLOCK) {
+			mBlocks[mLastBlock].nextPhysical = block;
+		}
+		mLastBlock = block;
+		insertFree(block);
+	}
+	mCapacity = newCapacity;
+}
+
+uint32_t TlsfAllocator::getLargestFree() const
+{
+	if (mFirstLevelMap == 0) {
+		return 0;
+	}
+	uint32_t firstLevel = highestBit(mFirstLevelMap);
+	uint32_t secondLevel = highestBit(mSecondLevelMaps[firstLevel]);
+	uint32_t largest = 0;
+	for (uint32_t block = mFreeLists[firstLevel][secondLevel]; block != TLSF_INVALID_BLOCK; block = mBlocks[block].nextFree) {
+		largest = std::max(largest, mBlocks[block].size);
+	}
+	return largest;
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include <vector>
+#include <stdint.h>
+
+//Returned by TlsfAllocator::allocate when no free range is big enough
+const uint32_t TLSF_INVALID_BLOCK = UINT32_MAX;
+
+/// <summary>
+/// Two-level segregated fit allocator over a range of [0, capacity) units. It only does the bookkeeping, the
+/// memory itself lives elsewhere (GeometryBuffer suballocates GL buffers with it). Free ranges are binned by the
+/// position of their highest bit, then by the next SECOND_LEVEL_BITS bits below it, so finding a big enough range
+/// and freeing one (merged with free neighbours) are both constant time
+/// </summary>
+class TlsfAllocator {
+public:
+	TlsfAllocator(uint32_t capacity = 0);
+	//A block of at least size units, or TLSF_INVALID_BLOCK. Blocks are ids, their offset never changes
+	uint32_t allocate(uint32_t size);
+	void free(uint32_t block);
+	uint32_t getOffset(uint32_t block) const { return mBlocks[block].offset; }
+	uint32_t getSize(uint32_t block) const { return mBlocks[block].size; }
+	//Adds free units at the end. Existing blocks keep their offsets
+	void grow(uint32_t newCapacity);
+	uint32_t getCapacity() const { return mCapacity; }
+	//Units in allocated blocks
+	uint32_t getUsed() const { return mUsed; }
+	//Size of the biggest free range, 0 if there is none
+	uint32_t getLargestFree() const;
+private:
+	static const uint32_t SECOND_LEVEL_BITS = 4;
+	static const uint32_t SECOND_LEVEL_COUNT = 1u << SECOND_LEVEL_BITS;
+	static const uint32_t FIRST_LEVEL_COUNT = 32 - SECOND_LEVEL_BITS + 1;
+
+	//One contiguous range, allocated or free. Neighbours in memory are linked so freeing can merge them,
+	//and free blocks are also linked into the list of their bin
+	struct Block {
+		uint32_t offset;
+		uint32_t size;
+		uint32_t prevPhysical;
+		uint32_t nextPhysical;
+		uint32_t prevFree;
+		uint32_t nextFree;
+		bool isFree;
+	};
+	static void mapping(uint32_t size, uint32_t& firstLevel, uint32_t& secondLevel);
+	uint32_t newBlock(uint32_t offset, uint32_t size);
+	void insertFree(uint32_t block);
+	void removeFree(uint32_t block);
+	uint32_t findFree(uint32_t size) const;
+	std::vector<Block> mBlocks;
+	//Ids of Block records no longer in use, reused before mBlocks grows
+	std::vector<uint32_t> mUnusedBlocks;
+	//Bit f is set if any bin of first level f has a free block, bit s of mSecondLevelMaps[f] if bin (f, s) has
+	uint32_t mFirstLevelMap;
+	uint32_t mSecondLevelMaps[FIRST_LEVEL_COUNT];
+	uint32_t mFreeLists[FIRST_LEVEL_COUNT][SECOND_LEVEL_COUNT];
+	//Block at the end of the range, TLSF_INVALID_BLOCK while the capacity is 0
+	uint32_t mLastBlock;
+	uint32_t mCapacity;
+	uint32_t mUsed;
+};
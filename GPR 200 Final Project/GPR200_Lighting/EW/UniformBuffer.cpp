@@ -0,0 +1,36 @@
+#include "UniformBuffer.h"
+#include "GLState.h"
+#include <stdio.h>
+
+UniformBuffer::UniformBuffer(UniformBlockBinding binding, GLsizeiptr size)
+{
+	mBinding = binding;
+	mSize = size;
+
+	glGenBuffers(1, &mUBO);
+	GLState::bindBuffer(GL_UNIFORM_BUFFER, mUBO);
+	glBufferData(GL_UNIFORM_BUFFER, mSize, NULL, GL_DYNAMIC_DRAW);
+	GLState::bindBuffer(GL_UNIFORM_BUFFER, 0);
+
+	bind();
+}
+
+UniformBuffer::~UniformBuffer()
+{
+	GLState::deleteBuffer(mUBO);
+}
+
+void UniformBuffer::upload(const void* data, GLsizeiptr size, GLintptr offset)
+{
+	if (offset + size > mSize) {
+		printf("Uniform buffer upload of %d bytes at %d overflows buffer of %d bytes", (int)size, (int)offset, (int)mSize);
+		return;
+	}
+	GLState::bindBuffer(GL_UNIFORM_BUFFER, mUBO);
+	glBufferSubData(GL_UNIFORM_BUFFER, offset, size, data);
+}
+
+void UniformBuffer::bind()
+{
+	GLState::bindBufferBase(GL_UNIFORM_BUFFER, mBinding, mUBO);
+}
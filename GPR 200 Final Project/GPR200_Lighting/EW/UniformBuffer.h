@@ -0,0 +1,49 @@
+#pragma once
+#include "GL/glew.h"
+
+//Fixed binding points shared by every shader. Shader binds any block with one of these names when it links,
+//so a single buffer feeds every program that declares the block
+enum UniformBlockBinding : GLuint
+{
+	LIGHT_BLOCK_BINDING = 0,
+	MATERIAL_BLOCK_BINDING = 1
+};
+
+struct UniformBlockName
+{
+	const char* name;
+	GLuint binding;
+};
+
+const UniformBlockName UNIFORM_BLOCK_NAMES[] = {
+	{ "LightBlock", LIGHT_BLOCK_BINDING },
+	{ "MaterialBlock", MATERIAL_BLOCK_BINDING }
+};
+
+//Same for shader storage blocks, bound through STORAGE_BLOCK_NAMES
+enum StorageBlockBinding : GLuint
+{
+	DRAW_BLOCK_BINDING = 0
+};
+
+const UniformBlockName STORAGE_BLOCK_NAMES[] = {
+	{ "DrawBlock", DRAW_BLOCK_BINDING }
+};
+
+/// <summary>
+/// Holds an OpenGL uniform buffer attached to one of the fixed binding points
+/// </summary>
+class UniformBuffer {
+public:
+	UniformBuffer(UniformBlockBinding binding, GLsizeiptr size);
+	~UniformBuffer();
+	void upload(const void* data, GLsizeiptr size, GLintptr offset = 0);
+	template<typename T>
+	void upload(const T& block) { upload(&block, sizeof(T)); }
+	void bind();
+private:
+	UniformBuffer(const UniformBuffer& r) = delete;
+	GLuint mUBO;
+	GLuint mBinding;
+	GLsizeiptr mSize;
+};
@@ -0,0 +1,40 @@
+#pragma once
+#include <GL/glew.h>
+#include <vector>
+
+//Locations from here up are fed once per instance (see InstanceBuffer.h). Per-vertex layouts stay below it
+const GLuint FIRST_INSTANCE_LOCATION = 3;
+
+/// <summary>
+/// One attribute in a vertex buffer, and the shader input it feeds
+/// </summary>
+struct VertexAttribute {
+	const char* name;
+	GLuint location;
+	GLint components;
+	GLenum type;
+	GLboolean normalized;
+	GLuint offset;
+	//What the shader should declare the input as, e.g. GL_FLOAT_VEC3 for a vec3. A GL_FLOAT_MAT4 takes one location
+	//per column, and integer types are read without conversion to float
+	GLenum shaderType;
+};
+
+/// <summary>
+/// A shader input the vertex doesn't store. Every vertex reads the same value
+/// </summary>
+struct VertexConstant {
+	GLuint location;
+	GLfloat value[4];
+};
+
+/// <summary>
+/// How vertices are laid out in a buffer. Mesh builds its VAO from this, and Shader checks its inputs against it
+/// </summary>
+struct VertexLayout {
+	std::vector<VertexAttribute> attributes;
+	GLsizei stride;
+	std::vector<VertexConstant> constants;
+	//0 if the attributes advance once per vertex, 1 if once per instance
+	GLuint divisor = 0;
+};
@@ -0,0 +1,960 @@
+#include "Benchmarks.h"
+#include "../EW/Mesh.h"
+#include "../EW/ShapeGen.h"
+#include "../EW/Meshlets.h"
+#include "../EW/MeshCleanup.h"
+#include "../EW/InstanceBuffer.h"
+#include "../EW/GeometryBuffer.h"
+#include "../EW/IndirectRenderer.h"
+#include "../EW/RenderQueue.h"
+#include "../EW/GLState.h"
+#include "../EW/CommandRecorder.h"
+#include "LightBlocks.h"
+
+#include <chrono>
+#include <random>
+#include <thread>
+#include <memory>
+#include <stdio.h>
+
+#include <glm/gtc/type_ptr.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+namespace
+{
+	typedef std::chrono::high_resolution_clock Clock;
+
+	double millisecondsSince(Clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	}
+
+	//The uniform path every setter used before the uniform table, kept here as the baseline. Binds directly, so
+	//GLState has to be invalidated afterwards
+	void legacySetVec3(GLuint program, std::string name, const glm::vec3& value)
+	{
+		glUseProgram(program);
+		glUniform3f(glGetUniformLocation(program, name.c_str()), value.x, value.y, value.z);
+	}
+
+	void legacySetMat4(GLuint program, std::string name, const glm::mat4& value)
+	{
+		glUseProgram(program);
+		glUniformMatrix4fv(glGetUniformLocation(program, name.c_str()), 1, false, glm::value_ptr(value));
+	}
+
+	double timeDraws(Mesh& mesh, int numDraws, int numFrames)
+	{
+		//Warm up so buffer uploads aren't timed
+		mesh.draw(false);
+		glFinish();
+		Clock::time_point start = Clock::now();
+		for (int frame = 0; frame < numFrames; frame++)
+		{
+			for (int i = 0; i < numDraws; i++)
+			{
+				mesh.draw(false);
+			}
+			glFinish();
+		}
+		return millisecondsSince(start) / numFrames;
+	}
+
+	//Runs frame numFrames + 1 times and returns the average milliseconds, glFinish included. The first run warms up
+	//and isn't timed. frame is passed the frame number, -1 for the warm up
+	template<typename Frame>
+	double runTimedFrames(int numFrames, Frame frame)
+	{
+		double totalMs = 0.0;
+		for (int i = -1; i < numFrames; i++)
+		{
+			Clock::time_point start = Clock::now();
+			frame(i);
+			glFinish();
+			if (i >= 0) {
+				totalMs += millisecondsSince(start);
+			}
+		}
+		return totalMs / numFrames;
+	}
+
+	//Models for objects in a square grid fieldSize across centered on the origin, each scaled to half the spacing.
+	//The default fills the screen from -1 to 1. A grid on the ground lies in XZ instead of XY
+	std::vector<glm::mat4> makeGridModels(int numObjects, float fieldSize = 2.0f, bool onGround = false)
+	{
+		int gridSize = (int)ceilf(sqrtf((float)numObjects));
+		float spacing = fieldSize / gridSize;
+		std::vector<glm::mat4> models;
+		models.reserve(numObjects);
+		for (int i = 0; i < numObjects; i++)
+		{
+			float across = -fieldSize * 0.5f + spacing * (i % gridSize + 0.5f);
+			float down = -fieldSize * 0.5f + spacing * (i / gridSize + 0.5f);
+			glm::vec3 position = onGround ? glm::vec3(across, 0.0f, down) : glm::vec3(across, down, 0.0f);
+			models.push_back(glm::scale(glm::translate(glm::mat4(1.0f), position), glm::vec3(spacing * 0.5f)));
+		}
+		return models;
+	}
+
+	//A sphere (3 to 1 subdivisions) and a cone (32, 16 and 8 segments), three levels each
+	void makeLodChains(BasicMeshLodChain<CompactVertex>& sphereChain, BasicMeshLodChain<CompactVertex>& coneChain)
+	{
+		createIcosphereLods(0.5f, 3, glm::vec3(1.0f), 3, sphereChain, SHAPEGEN_CLEANUP | SHAPEGEN_OPTIMIZE_VERTEX_CACHE);
+		createConeLods(0.75f, 1.0f, 32, glm::vec3(1.0f), 3, coneChain, SHAPEGEN_CLEANUP | SHAPEGEN_OPTIMIZE_VERTEX_CACHE);
+	}
+
+	//A material in its own buffer. The first eight indices each get a different diffuse color
+	std::unique_ptr<UniformBuffer> makeMaterialBlock(int index)
+	{
+		MaterialBlock materialBlock = {};
+		materialBlock.diffuse = glm::vec3((index & 1) ? 1.0f : 0.25f, (index & 2) ? 1.0f : 0.25f, (index & 4) ? 1.0f : 0.25f);
+		materialBlock.shininess = 32.0f;
+		std::unique_ptr<UniformBuffer> material(new UniformBuffer(MATERIAL_BLOCK_BINDING, sizeof(MaterialBlock)));
+		material->upload(materialBlock);
+		return material;
+	}
+
+	//createSphere and createCone as they were before counting up front, growing both vectors one element at a time.
+	//Kept here as the baseline, with the same triangles as the current ones
+	template<typename V>
+	void legacyCreateSphere(float radius, int numSegments, glm::vec3 color, BasicMeshData<V>& meshData)
+	{
+		meshData.vertices.clear();
+		meshData.indices.clear();
+
+		float thetaStep = (2.0f * glm::pi<float>()) / (float)numSegments;
+		float phiStep = (glm::pi<float>()) / (float)numSegments;
+
+		meshData.vertices.push_back({ glm::vec3(0,radius,0),color,glm::vec3(0,1,0) });
+		for (int i = 1; i < numSegments; i++)
+		{
+			float phi = phiStep * i;
+			for (int j = 0; j <= numSegments; ++j)
+			{
+				float theta = thetaStep * j;
+				float x = radius * sinf(phi) * sinf(theta);
+				float y = radius * cosf(phi);
+				float z = radius * sinf(phi) * cosf(theta);
+				meshData.vertices.push_back({ glm::vec3(x, y, z), color, glm::normalize(glm::vec3(x, y, z)) });
+			}
+		}
+		meshData.vertices.push_back({ glm::vec3(0,-radius,0),color,glm::vec3(0,-1,0) });
+
+		unsigned int bottomIndex = (unsigned int)meshData.vertices.size() - 1;
+		unsigned int ringVertexCount = numSegments + 1;
+		for (int i = 0; i < numSegments; ++i) {
+			meshData.indices.push_back(0);
+			meshData.indices.push_back(i + 1);
+			meshData.indices.push_back(i + 2);
+		}
+		for (int y = 0; y < numSegments - 2; ++y)
+		{
+			for (int x = 0; x < numSegments; ++x)
+			{
+				meshData.indices.push_back(1 + y * ringVertexCount + x);
+				meshData.indices.push_back(1 + (y + 1) * ringVertexCount + x);
+				meshData.indices.push_back(1 + y * ringVertexCount + x + 1);
+				meshData.indices.push_back(1 + y * ringVertexCount + x + 1);
+				meshData.indices.push_back(1 + (y + 1) * ringVertexCount + x);
+				meshData.indices.push_back(1 + (y + 1) * ringVertexCount + x + 1);
+			}
+		}
+		unsigned int start = bottomIndex - ringVertexCount;
+		for (int i = 0; i < numSegments; ++i) {
+			meshData.indices.push_back(start + i + 1);
+			meshData.indices.push_back(start + i);
+			meshData.indices.push_back(bottomIndex);
+		}
+	}
+
+	template<typename V>
+	void legacyCreateCone(float radius, float height, int numSegments, glm::vec3 color, BasicMeshData<V>& meshData)
+	{
+		meshData.vertices.clear();
+		meshData.indices.clear();
+
+		float bottomY = height * -0.5f;
+		float thetaStep = (2.0f * glm::pi<float>()) / (float)numSegments;
+		glm::vec3 topPosition = glm::vec3(0, height * 0.5f, 0);
+		for (int i = 0; i < numSegments; i++)
+		{
+			float theta = i * thetaStep;
+			float cosTheta = cosf(theta);
+			float sinTheta = sinf(theta);
+			float sideLength = sqrtf(radius * radius + height * height);
+			float coneX = radius / sideLength;
+			float coneY = -height / sideLength;
+			glm::vec3 ringPosition = glm::vec3(cosTheta * radius, bottomY, sinTheta * radius);
+			glm::vec3 normal = glm::normalize(glm::vec3(-coneY * cosTheta, coneX, -coneY * sinTheta));
+			meshData.vertices.push_back({ ringPosition, color, glm::vec3(0,-1,0) });
+			meshData.vertices.push_back({ ringPosition, color, normal });
+			meshData.vertices.push_back({ topPosition, color, normal });
+		}
+		meshData.vertices.push_back({ glm::vec3(0, bottomY, 0), color, glm::vec3(0,-1,0) });
+
+		unsigned int centerIndex = (unsigned int)meshData.vertices.size() - 1;
+		unsigned int ringVerticesLength = numSegments * 3;
+		for (unsigned int i = 0; i < ringVerticesLength; i += 3)
+		{
+			unsigned int bottomRingIndex = i % ringVerticesLength;
+			unsigned int sideRingIndex = (i + 1) % ringVerticesLength;
+			meshData.indices.push_back(bottomRingIndex);
+			meshData.indices.push_back((bottomRingIndex + 3) % ringVerticesLength);
+			meshData.indices.push_back(centerIndex);
+			meshData.indices.push_back((sideRingIndex + 3) % ringVerticesLength);
+			meshData.indices.push_back(sideRingIndex);
+			meshData.indices.push_back((i + 2) % ringVerticesLength);
+		}
+	}
+
+	//Angle in degrees between the normal interpolated across a triangle and the normal of the true sphere under the same
+	//pixel, looking straight down each axis both ways. Sampled on a grid over every triangle facing the view.
+	//Gives the largest and the root mean square
+	void measureShadingError(const MeshData& meshData, float radius, float& maxDegrees, float& rmsDegrees)
+	{
+		const int steps = 8;
+		const glm::vec3 views[6] = { { 1, 0, 0 }, { -1, 0, 0 }, { 0, 1, 0 }, { 0, -1, 0 }, { 0, 0, 1 }, { 0, 0, -1 } };
+		double maxAngle = 0.0;
+		double sumSquares = 0.0;
+		size_t numSamples = 0;
+		for (size_t i = 0; i + 2 < meshData.indices.size(); i += 3)
+		{
+			const Vertex& a = meshData.vertices[meshData.indices[i]];
+			const Vertex& b = meshData.vertices[meshData.indices[i + 1]];
+			const Vertex& c = meshData.vertices[meshData.indices[i + 2]];
+			glm::vec3 faceNormal = glm::cross(b.position - a.position, c.position - a.position);
+			for (const glm::vec3& view : views)
+			{
+				if (glm::dot(faceNormal, view) <= 0.0f) {
+					continue;
+				}
+				for (int u = 0; u <= steps; u++)
+				{
+					for (int v = 0; v <= steps - u; v++)
+					{
+						float wa = (float)u / steps;
+						float wb = (float)v / steps;
+						float wc = 1.0f - wa - wb;
+						glm::vec3 position = a.position * wa + b.position * wb + c.position * wc;
+						glm::vec3 normal = glm::normalize(a.normal * wa + b.normal * wb + c.normal * wc);
+						//Where the view ray through this point meets the true sphere
+						glm::vec3 across = (position - view * glm::dot(position, view)) / radius;
+						float depth = sqrtf(glm::max(0.0f, 1.0f - glm::dot(across, across)));
+						glm::vec3 trueNormal = across + view * depth;
+						double angle = acos(glm::clamp((double)glm::dot(normal, trueNormal), -1.0, 1.0));
+						maxAngle = glm::max(maxAngle, angle);
+						sumSquares += angle * angle;
+						numSamples++;
+					}
+				}
+			}
+		}
+		maxDegrees = (float)glm::degrees(maxAngle);
+		rmsDegrees = (float)glm::degrees(sqrt(sumSquares / glm::max((size_t)1, numSamples)));
+	}
+
+	//FNV-1a over the raw bytes of a mesh, to check two generators made the same one
+	template<typename V>
+	uint64_t hashMeshData(const BasicMeshData<V>& meshData)
+	{
+		uint64_t hash = 14695981039346656037ull;
+		auto hashBytes = [&hash](const void* data, size_t size)
+		{
+			const unsigned char* bytes = (const unsigned char*)data;
+			for (size_t i = 0; i < size; i++) {
+				hash ^= bytes[i];
+				hash *= 1099511628211ull;
+			}
+		};
+		hashBytes(meshData.vertices.data(), meshData.vertices.size() * sizeof(V));
+		hashBytes(meshData.indices.data(), meshData.indices.size() * sizeof(unsigned int));
+		return hash;
+	}
+}
+
+namespace WB
+{
+	void benchmarkUniformUploads(Shader& litShader, int numObjects, int numFrames)
+	{
+		const glm::mat4 view = glm::mat4(1.0f);
+		const glm::mat4 projection = glm::mat4(1.0f);
+		const glm::vec3 eyePos = glm::vec3(0.0f, 0.0f, 5.0f);
+		glm::mat4 model = glm::mat4(1.0f);
+
+		litShader.use();
+		glFinish();
+
+		//The matrices live in the vertex stage and uEyePos in the fragment stage. Both are the same program without pipelines
+		GLuint vertexProgram = litShader.getProgramId(GL_VERTEX_SHADER);
+		GLuint fragmentProgram = litShader.getProgramId(GL_FRAGMENT_SHADER);
+
+		//Old path: a std::string and a driver lookup per call
+		Clock::time_point start = Clock::now();
+		for (int frame = 0; frame < numFrames; frame++)
+		{
+			for (int i = 0; i < numObjects; i++)
+			{
+				model[3][0] = (float)i;
+				legacySetMat4(vertexProgram, "uModel", model);
+				legacySetMat4(vertexProgram, "uView", view);
+				legacySetMat4(vertexProgram, "uProjection", projection);
+				legacySetVec3(fragmentProgram, "uEyePos", eyePos);
+			}
+			glFinish();
+		}
+		double legacyMs = millisecondsSince(start) / numFrames;
+		GLState::invalidate();
+		litShader.use();
+
+		//Uniform table looked up by name, hashed at runtime. Unchanged values are skipped from here on
+		Shader::resetUniformStats();
+		start = Clock::now();
+		for (int frame = 0; frame < numFrames; frame++)
+		{
+			for (int i = 0; i < numObjects; i++)
+			{
+				model[3][0] = (float)i;
+				litShader.setMat4("uModel", model);
+				litShader.setMat4("uView", view);
+				litShader.setMat4("uProjection", projection);
+				litShader.setVec3("uEyePos", eyePos);
+			}
+			glFinish();
+		}
+		double tableMs = millisecondsSince(start) / numFrames;
+		UniformCallStats tableStats = Shader::getUniformStats();
+
+		//Uniform table looked up by prehashed key
+		constexpr UniformKey modelKey("uModel");
+		constexpr UniformKey viewKey("uView");
+		constexpr UniformKey projectionKey("uProjection");
+		constexpr UniformKey eyePosKey("uEyePos");
+		Shader::resetUniformStats();
+		start = Clock::now();
+		for (int frame = 0; frame < numFrames; frame++)
+		{
+			for (int i = 0; i < numObjects; i++)
+			{
+				model[3][0] = (float)i;
+				litShader.setMat4(modelKey, model);
+				litShader.setMat4(viewKey, view);
+				litShader.setMat4(projectionKey, projection);
+				litShader.setVec3(eyePosKey, eyePos);
+			}
+			glFinish();
+		}
+		double keyMs = millisecondsSince(start) / numFrames;
+		UniformCallStats keyStats = Shader::getUniformStats();
+
+		printf("Uniform uploads, %d objects, average of %d frames:\n", numObjects, numFrames);
+		printf("  string + glGetUniformLocation: %.3f ms/frame\n", legacyMs);
+		printf("  uniform table (string_view):   %.3f ms/frame, %u issued, %u skipped per frame\n",
+			tableMs, tableStats.issued / numFrames, tableStats.skipped / numFrames);
+		printf("  uniform table (UniformKey):    %.3f ms/frame, %u issued, %u skipped per frame\n",
+			keyMs, keyStats.issued / numFrames, keyStats.skipped / numFrames);
+	}
+
+	void benchmarkVertexFormats(Shader& litShader, int numSegments, int numDraws, int numFrames)
+	{
+		MeshData fullData;
+		createSphere(0.5f, numSegments, glm::vec3(1.0f), fullData);
+		BasicMeshData<CompactVertex> compactData;
+		createSphere(0.5f, numSegments, glm::vec3(1.0f), compactData);
+		Mesh fullMesh(&fullData);
+		Mesh compactMesh(&compactData);
+		fullMesh.enableAttributes(litShader.getActiveAttributeMask());
+		compactMesh.enableAttributes(litShader.getActiveAttributeMask());
+
+		litShader.use();
+		litShader.setMat4("uModel", glm::mat4(1.0f));
+		litShader.setMat4("uView", glm::mat4(1.0f));
+		litShader.setMat4("uProjection", glm::mat4(1.0f));
+
+		double fullMs = timeDraws(fullMesh, numDraws, numFrames);
+		double compactMs = timeDraws(compactMesh, numDraws, numFrames);
+
+		printf("Vertex formats, %d vertex sphere drawn %d times, average of %d frames:\n", (int)fullData.vertices.size(), numDraws, numFrames);
+		printf("  Vertex        (%2d bytes, %7.1f KB): %.3f ms/frame\n", (int)sizeof(Vertex),
+			fullData.vertices.size() * sizeof(Vertex) / 1024.0, fullMs);
+		printf("  CompactVertex (%2d bytes, %7.1f KB): %.3f ms/frame\n", (int)sizeof(CompactVertex),
+			compactData.vertices.size() * sizeof(CompactVertex) / 1024.0, compactMs);
+	}
+
+	void reportVertexCache()
+	{
+		MeshData cube, sphere, cone;
+		createCube(1.0f, 1.0f, 1.0f, glm::vec3(1.0f), cube);
+		createSphere(0.5f, 64, glm::vec3(1.0f), sphere);
+		createCone(0.75f, 1.0f, 64, glm::vec3(1.0f), cone);
+		const char* names[] = { "cube", "sphere", "cone" };
+		MeshData* meshes[] = { &cube, &sphere, &cone };
+
+		printf("Vertex cache (FIFO of %u):\n", VERTEX_CACHE_ANALYZE_SIZE);
+		for (int i = 0; i < 3; i++)
+		{
+			MeshOptimizationStats stats = optimizeMesh(*meshes[i]);
+			printf("  %-6s ACMR %.3f -> %.3f, ATVR %.3f -> %.3f\n", names[i],
+				stats.before.acmr, stats.after.acmr, stats.before.atvr, stats.after.atvr);
+		}
+	}
+
+	void reportOverdraw(const std::vector<float>& thresholds)
+	{
+		const char* names[] = { "cube", "sphere", "cone", "cluster" };
+
+		printf("Overdraw (shaded per covered pixel, 6 views), culled / not culled:\n");
+		for (int i = 0; i < 4; i++)
+		{
+			MeshData meshData;
+			if (i == 0) createCube(1.0f, 1.0f, 1.0f, glm::vec3(1.0f), meshData, SHAPEGEN_OPTIMIZE_VERTEX_CACHE);
+			if (i == 1) createSphere(0.5f, 64, glm::vec3(1.0f), meshData, SHAPEGEN_OPTIMIZE_VERTEX_CACHE);
+			if (i == 2) createCone(0.75f, 1.0f, 64, glm::vec3(1.0f), meshData, SHAPEGEN_OPTIMIZE_VERTEX_CACHE);
+			if (i == 3)
+			{
+				//Seven overlapping spheres, one in the middle and one out along each axis. Unlike the shapes above it isn't
+				//convex, so some orders draw hidden surfaces first even with back faces culled
+				const glm::vec3 offsets[] = { glm::vec3(0.0f), glm::vec3(0.7f, 0.0f, 0.0f), glm::vec3(-0.7f, 0.0f, 0.0f),
+					glm::vec3(0.0f, 0.7f, 0.0f), glm::vec3(0.0f, -0.7f, 0.0f), glm::vec3(0.0f, 0.0f, 0.7f), glm::vec3(0.0f, 0.0f, -0.7f) };
+				for (const glm::vec3& offset : offsets)
+				{
+					MeshData sphere;
+					createSphere(0.5f, 32, glm::vec3(1.0f), sphere);
+					unsigned int firstVertex = (unsigned int)meshData.vertices.size();
+					for (Vertex& vertex : sphere.vertices)
+					{
+						vertex.position += offset;
+						meshData.vertices.push_back(vertex);
+					}
+					for (unsigned int index : sphere.indices) {
+						meshData.indices.push_back(firstVertex + index);
+					}
+				}
+				optimizeVertexCache(meshData.indices, meshData.vertices.size());
+			}
+			std::vector<glm::vec3> positions = getPositions(meshData);
+
+			OverdrawStats culled = analyzeOverdraw(meshData.indices, positions, true);
+			OverdrawStats unculled = analyzeOverdraw(meshData.indices, positions, false);
+			VertexCacheStats cache = analyzeVertexCache(meshData.indices, positions.size());
+			printf("  %-7s vertex cache order:  %.3f / %.3f, ACMR %.3f\n", names[i], culled.overdraw, unculled.overdraw, cache.acmr);
+			for (float threshold : thresholds)
+			{
+				std::vector<unsigned int> indices = meshData.indices;
+				optimizeOverdraw(indices, positions, threshold);
+				culled = analyzeOverdraw(indices, positions, true);
+				unculled = analyzeOverdraw(indices, positions, false);
+				cache = analyzeVertexCache(indices, positions.size());
+				printf("  %-7s threshold %.2f:      %.3f / %.3f, ACMR %.3f\n", names[i], threshold, culled.overdraw, unculled.overdraw, cache.acmr);
+			}
+		}
+	}
+
+	void reportLods()
+	{
+		MeshLodChain regenerated;
+		createSphereLods(0.5f, 64, glm::vec3(1.0f), 4, regenerated);
+		MeshData sphere;
+		createSphere(0.5f, 64, glm::vec3(1.0f), sphere);
+		Clock::time_point start = Clock::now();
+		MeshLodChain simplified = buildLodChain(sphere, 4, 0.25f);
+		double simplifyMs = millisecondsSince(start);
+
+		const char* names[] = { "regenerated", "simplified" };
+		MeshLodChain* chains[] = { &regenerated, &simplified };
+		printf("Sphere levels of detail (error as a fraction of the radius):\n");
+		for (int i = 0; i < 2; i++)
+		{
+			printf("  %-11s", names[i]);
+			for (const MeshLod& level : chains[i]->levels) {
+				printf("  %5d tris %.4f", (int)level.indices.size() / 3, level.error);
+			}
+			printf("\n");
+		}
+		printf("  simplifying took %.2f ms\n", simplifyMs);
+	}
+
+	void benchmarkMeshletCulling(int numSegments, int numFrames)
+	{
+		MeshData sphere;
+		createSphere(0.5f, numSegments, glm::vec3(1.0f), sphere, SHAPEGEN_OPTIMIZE_VERTEX_CACHE);
+		Clock::time_point start = Clock::now();
+		MeshletData meshletData = buildMeshlets(sphere);
+		double buildMs = millisecondsSince(start);
+
+		//Close enough that the sides of the sphere leave the screen
+		glm::vec3 cameraPosition = glm::vec3(0.0f, 0.0f, 1.2f);
+		glm::mat4 viewProjection = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 100.0f)
+			* glm::lookAt(cameraPosition, glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+		std::vector<unsigned int> indices;
+		indices.reserve(sphere.indices.size());
+		size_t kept = 0;
+		start = Clock::now();
+		for (int frame = 0; frame < numFrames; frame++)
+		{
+			indices.clear();
+			kept = cullMeshlets(meshletData, glm::mat4(1.0f), viewProjection, cameraPosition, indices);
+		}
+		double cullMs = millisecondsSince(start) / numFrames;
+
+		size_t numTriangles = sphere.indices.size() / 3;
+		printf("Meshlet culling, %d segment sphere (%d triangles) seen from one side:\n", numSegments, (int)numTriangles);
+		printf("  %d meshlets, %.1f triangles and %.1f vertices each, built in %.2f ms\n", (int)meshletData.meshlets.size(),
+			(double)numTriangles / meshletData.meshlets.size(), (double)meshletData.vertices.size() / meshletData.meshlets.size(), buildMs);
+		printf("  %d meshlets kept, %.1f%% of triangles culled, %.3f ms/frame to cull\n", (int)kept,
+			100.0 * (1.0 - (double)indices.size() / sphere.indices.size()), cullMs);
+	}
+
+	void benchmarkShapeGen(const std::vector<int>& segmentCounts)
+	{
+		printf("Shape generation, legacy / current (ms), CompactVertex, %u threads:\n", std::thread::hardware_concurrency());
+		for (int numSegments : segmentCounts)
+		{
+			//One mesh alive at a time, a 4096 segment sphere is over half a gigabyte
+			BasicMeshData<CompactVertex> meshData;
+			Clock::time_point start = Clock::now();
+			legacyCreateSphere(0.5f, numSegments, glm::vec3(1.0f), meshData);
+			double legacySphereMs = millisecondsSince(start);
+			uint64_t legacySphereHash = hashMeshData(meshData);
+			meshData = BasicMeshData<CompactVertex>();
+			start = Clock::now();
+			createSphere(0.5f, numSegments, glm::vec3(1.0f), meshData);
+			double sphereMs = millisecondsSince(start);
+			bool sphereMatches = hashMeshData(meshData) == legacySphereHash;
+			meshData = BasicMeshData<CompactVertex>();
+
+			start = Clock::now();
+			legacyCreateCone(0.5f, 1.0f, numSegments, glm::vec3(1.0f), meshData);
+			double legacyConeMs = millisecondsSince(start);
+			uint64_t legacyConeHash = hashMeshData(meshData);
+			meshData = BasicMeshData<CompactVertex>();
+			start = Clock::now();
+			createCone(0.5f, 1.0f, numSegments, glm::vec3(1.0f), meshData);
+			double coneMs = millisecondsSince(start);
+			bool coneMatches = hashMeshData(meshData) == legacyConeHash;
+
+			printf("  %4d segments: sphere %9.3f / %9.3f%s, cone %7.3f / %7.3f%s\n", numSegments,
+				legacySphereMs, sphereMs, sphereMatches ? "" : " (MISMATCH)", legacyConeMs, coneMs, coneMatches ? "" : " (MISMATCH)");
+		}
+	}
+
+	void reportIcosphere(int maxSubdivisions)
+	{
+		const float radius = 0.5f;
+		printf("Icosphere against the UV sphere with the same silhouette error (error as a fraction of the radius,\n");
+		printf("shading error is the angle between the interpolated normal and the true one under the same pixel\n");
+		printf("in degrees, max / rms):\n");
+		for (int subdivisions = 1; subdivisions <= maxSubdivisions; subdivisions++)
+		{
+			MeshData icosphere;
+			createIcosphere(radius, subdivisions, glm::vec3(1.0f), icosphere);
+			float icosphereError = computeSphereError(icosphere, radius);
+			float icosphereMax, icosphereRms;
+			measureShadingError(icosphere, radius, icosphereMax, icosphereRms);
+
+			//Fewest segments that are at least as round. The error only shrinks as segments are added
+			int low = 3;
+			int high = 1024;
+			MeshData sphere;
+			while (low < high)
+			{
+				int middle = (low + high) / 2;
+				createSphere(radius, middle, glm::vec3(1.0f), sphere);
+				if (computeSphereError(sphere, radius) <= icosphereError) {
+					high = middle;
+				}
+				else {
+					low = middle + 1;
+				}
+			}
+			createSphere(radius, low, glm::vec3(1.0f), sphere);
+			float sphereMax, sphereRms;
+			measureShadingError(sphere, radius, sphereMax, sphereRms);
+
+			printf("  %d subdivisions: %6d tris %6d verts, error %.5f, shading %.3f / %.3f\n", subdivisions,
+				(int)icosphere.indices.size() / 3, (int)icosphere.vertices.size(), icosphereError, icosphereMax, icosphereRms);
+			printf("  %4d segments:   %6d tris %6d verts, error %.5f, shading %.3f / %.3f\n", low,
+				(int)sphere.indices.size() / 3, (int)sphere.vertices.size(), computeSphereError(sphere, radius), sphereMax, sphereRms);
+		}
+	}
+
+	void reportCleanup()
+	{
+		const char* names[] = { "cube", "sphere", "cone", "icosphere", "soup" };
+		printf("Mesh cleanup (vertices and triangles before -> after, and what was removed):\n");
+		for (int i = 0; i < 5; i++)
+		{
+			MeshData meshData;
+			if (i == 0) createCube(1.0f, 1.0f, 1.0f, glm::vec3(1.0f), meshData);
+			if (i == 1) createSphere(0.5f, 64, glm::vec3(1.0f), meshData);
+			if (i == 2) createCone(0.75f, 1.0f, 64, glm::vec3(1.0f), meshData);
+			if (i == 3) createIcosphere(0.5f, 4, glm::vec3(1.0f), meshData);
+			if (i == 4) {
+				//What an importer that doesn't share vertices gives: every triangle has its own three
+				MeshData sphere;
+				createSphere(0.5f, 64, glm::vec3(1.0f), sphere);
+				for (unsigned int index : sphere.indices)
+				{
+					meshData.indices.push_back((unsigned int)meshData.vertices.size());
+					meshData.vertices.push_back(sphere.vertices[index]);
+				}
+			}
+			size_t vertices = meshData.vertices.size();
+			size_t triangles = meshData.indices.size() / 3;
+			MeshCleanupStats stats = cleanupMesh(meshData);
+			printf("  %-9s %6d -> %6d verts, %6d -> %6d tris: %d welded, %d degenerate, %d duplicate, %d vertices removed\n",
+				names[i], (int)vertices, (int)meshData.vertices.size(), (int)triangles, (int)meshData.indices.size() / 3,
+				stats.weldedVertices, stats.degenerateTriangles, stats.duplicateTriangles, stats.removedVertices);
+		}
+	}
+
+	void benchmarkInstancing(Shader& litShader, int numObjects, int numFrames)
+	{
+		//Small cubes and icospheres alternate over a square grid filling the screen
+		BasicMeshData<CompactVertex> cubeData, sphereData;
+		createCube(1.0f, 1.0f, 1.0f, glm::vec3(1.0f), cubeData);
+		createIcosphere(0.5f, 1, glm::vec3(1.0f), sphereData, SHAPEGEN_CLEANUP | SHAPEGEN_OPTIMIZE_VERTEX_CACHE);
+		Mesh cubeMesh(&cubeData);
+		Mesh sphereMesh(&sphereData);
+		Mesh* meshes[2] = { &cubeMesh, &sphereMesh };
+
+		std::vector<glm::mat4> models = makeGridModels(numObjects);
+		std::vector<InstanceData> instances[2];
+		for (int i = 0; i < numObjects; i++)
+		{
+			InstanceData instance = {};
+			instance.model = models[i];
+			instances[i % 2].push_back(instance);
+		}
+		InstanceBuffer instanceBuffers[2];
+		instanceBuffers[0].upload(instances[0]);
+		instanceBuffers[1].upload(instances[1]);
+
+		Shader& instancedShader = litShader.getVariant({ { "INSTANCED", "1" } });
+		instancedShader.waitUntilReady();
+		for (Mesh* mesh : meshes) {
+			mesh->enableAttributes(litShader.getActiveAttributeMask() | instancedShader.getActiveAttributeMask());
+		}
+
+		//One uniform upload and one draw call per object
+		litShader.use();
+		litShader.setMat4("uView", glm::mat4(1.0f));
+		litShader.setMat4("uProjection", glm::mat4(1.0f));
+		constexpr UniformKey modelKey("uModel");
+		double perDrawMs = runTimedFrames(numFrames, [&](int) {
+			for (int m = 0; m < 2; m++)
+			{
+				for (const InstanceData& instance : instances[m])
+				{
+					litShader.setMat4(modelKey, instance.model);
+					meshes[m]->draw(false);
+				}
+			}
+		});
+
+		//One draw call per shape
+		instancedShader.use();
+		instancedShader.setMat4("uView", glm::mat4(1.0f));
+		instancedShader.setMat4("uProjection", glm::mat4(1.0f));
+		double instancedMs = runTimedFrames(numFrames, [&](int) {
+			for (int m = 0; m < 2; m++) {
+				meshes[m]->drawInstanced(instanceBuffers[m], (GLsizei)instanceBuffers[m].getCount());
+			}
+		});
+
+		printf("Instancing, %d cubes and icospheres (%d and %d triangles), average of %d frames:\n", numObjects,
+			(int)cubeData.indices.size() / 3, (int)sphereData.indices.size() / 3, numFrames);
+		printf("  one draw per object: %8.3f ms/frame, %d draw calls\n", perDrawMs, numObjects);
+		printf("  instanced:           %8.3f ms/frame, 2 draw calls\n", instancedMs);
+	}
+
+	void benchmarkIndirect(Shader& litShader, int numObjects, int numFrames)
+	{
+		if (!IndirectRenderer::isSupported()) {
+			printf("Multi-draw indirect: not supported by this driver\n");
+			return;
+		}
+
+		//Every level of a sphere and a cone as its own mesh, and both chains in one geometry buffer
+		BasicMeshLodChain<CompactVertex> sphereChain, coneChain;
+		makeLodChains(sphereChain, coneChain);
+		std::vector<std::unique_ptr<Mesh>> meshes;
+		GeometryBuffer geometry(CompactVertex::layout());
+		std::vector<std::pair<GeometryHandle, int>> ranges;
+		for (const BasicMeshLodChain<CompactVertex>* chain : { &sphereChain, &coneChain })
+		{
+			GeometryHandle handle = geometry.add(*chain);
+			for (int lod = 0; lod < (int)chain->levels.size(); lod++)
+			{
+				BasicMeshData<CompactVertex> meshData = { chain->vertices, chain->levels[lod].indices };
+				meshes.emplace_back(new Mesh(&meshData));
+				ranges.push_back({ handle, lod });
+			}
+		}
+
+		std::vector<glm::mat4> models = makeGridModels(numObjects);
+
+		Shader& indirectShader = litShader.getVariant({ { "INDIRECT", "1" } });
+		indirectShader.waitUntilReady();
+		for (std::unique_ptr<Mesh>& mesh : meshes) {
+			mesh->enableAttributes(litShader.getActiveAttributeMask());
+		}
+
+		//Each object binds its mesh, sets uModel and draws
+		litShader.use();
+		litShader.setMat4("uView", glm::mat4(1.0f));
+		litShader.setMat4("uProjection", glm::mat4(1.0f));
+		constexpr UniformKey modelKey("uModel");
+		double perDrawMs = runTimedFrames(numFrames, [&](int) {
+			for (int i = 0; i < numObjects; i++)
+			{
+				litShader.setMat4(modelKey, models[i]);
+				meshes[i % meshes.size()]->draw(false);
+			}
+		});
+
+		//The commands and transforms are rebuilt and uploaded every frame, as a scene that moves would
+		IndirectRenderer renderer(&geometry);
+		indirectShader.use();
+		indirectShader.setMat4("uView", glm::mat4(1.0f));
+		indirectShader.setMat4("uProjection", glm::mat4(1.0f));
+		double indirectMs = runTimedFrames(numFrames, [&](int) {
+			renderer.clear();
+			for (int i = 0; i < numObjects; i++) {
+				renderer.add(ranges[i % ranges.size()].first, models[i], ranges[i % ranges.size()].second);
+			}
+			renderer.draw();
+		});
+
+		printf("Multi-draw indirect, %d objects over %d meshes, average of %d frames:\n", numObjects, (int)meshes.size(), numFrames);
+		printf("  one draw per object: %8.3f ms/frame, %d draw calls\n", perDrawMs, numObjects);
+		printf("  multi-draw indirect: %8.3f ms/frame, 1 draw call, %u of %u vertices and %u of %u indices in use\n",
+			indirectMs, geometry.getVerticesUsed(), geometry.getVertexCapacity(), geometry.getIndicesUsed(), geometry.getIndexCapacity());
+	}
+
+	void benchmarkRenderQueue(Shader& litShader, int numObjects, int numFrames)
+	{
+		//Four light count variants, eight materials and every level of a sphere and a cone
+		std::vector<Shader*> shaders;
+		for (int numLights = 0; numLights < 4; numLights++)
+		{
+			Shader& variant = litShader.getVariant({ { "NR_POINT_LIGHTS", std::to_string(numLights) } });
+			variant.waitUntilReady();
+			variant.use();
+			variant.setMat4("uView", glm::mat4(1.0f));
+			variant.setMat4("uProjection", glm::mat4(1.0f));
+			shaders.push_back(&variant);
+		}
+
+		std::vector<std::unique_ptr<UniformBuffer>> materials;
+		for (int i = 0; i < 8; i++) {
+			materials.push_back(makeMaterialBlock(i));
+		}
+
+		BasicMeshLodChain<CompactVertex> sphereChain, coneChain;
+		makeLodChains(sphereChain, coneChain);
+		std::vector<std::unique_ptr<Mesh>> meshes;
+		for (const BasicMeshLodChain<CompactVertex>* chain : { &sphereChain, &coneChain })
+		{
+			for (const MeshLod& level : chain->levels)
+			{
+				BasicMeshData<CompactVertex> meshData = { chain->vertices, level.indices };
+				meshes.emplace_back(new Mesh(&meshData));
+				meshes.back()->enableAttributes(litShader.getActiveAttributeMask());
+			}
+		}
+
+		//Every object picks its shader, material and mesh at random, as a scene submitted in traversal order would
+		std::mt19937 random(23);
+		std::vector<RenderItem> items;
+		std::vector<glm::mat4> models = makeGridModels(numObjects);
+		for (int i = 0; i < numObjects; i++)
+		{
+			RenderItem item = {};
+			item.shader = shaders[random() % shaders.size()];
+			item.material = materials[random() % materials.size()].get();
+			item.mesh = meshes[random() % meshes.size()].get();
+			item.model = models[i];
+			item.depth = 1.0f + (float)(random() % 1000);
+			items.push_back(item);
+		}
+
+		RenderQueue queue;
+		RenderQueueStats stats[2] = {};
+		GLStateStats stateStats[2] = {};
+		double frameMs[2] = {};
+		double sortMs = 0.0;
+		for (int sorted = 0; sorted < 2; sorted++)
+		{
+			frameMs[sorted] = runTimedFrames(numFrames, [&](int frame) {
+				//The state calls of the warm up frame aren't counted
+				if (frame == 0) {
+					GLState::resetStats();
+				}
+				queue.clear();
+				for (const RenderItem& item : items) {
+					queue.submit(item);
+				}
+				if (sorted) {
+					Clock::time_point sortStart = Clock::now();
+					queue.sort();
+					if (frame >= 0) {
+						sortMs += millisecondsSince(sortStart);
+					}
+				}
+				//execute() turns on depth testing, so each frame starts from a cleared depth buffer
+				glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+				stats[sorted] = queue.execute();
+			});
+			stateStats[sorted] = GLState::getStats();
+		}
+
+		printf("Render queue, %d objects over %d shaders, %d materials and %d meshes, average of %d frames:\n", numObjects,
+			(int)shaders.size(), (int)materials.size(), (int)meshes.size(), numFrames);
+		const char* labels[2] = { "submission order", "sorted          " };
+		for (int sorted = 0; sorted < 2; sorted++)
+		{
+			printf("  %s: %8.3f ms/frame, %u program, %u VAO, %u material switches, %u GL state calls issued, %u elided\n",
+				labels[sorted], frameMs[sorted], stats[sorted].programSwitches, stats[sorted].vertexArraySwitches,
+				stats[sorted].materialSwitches, stateStats[sorted].issued / numFrames, stateStats[sorted].elided / numFrames);
+		}
+		printf("  of which sorting:  %8.3f ms/frame\n", sortMs / numFrames);
+	}
+
+	void benchmarkCommandRecording(Shader& litShader, int numObjects, int numFrames)
+	{
+		//A sphere and a cone with every level in one mesh each, and in one geometry buffer for the multi-draw
+		BasicMeshLodChain<CompactVertex> sphereChain, coneChain;
+		makeLodChains(sphereChain, coneChain);
+		std::unique_ptr<Mesh> meshes[2] = { std::unique_ptr<Mesh>(new Mesh(&sphereChain)), std::unique_ptr<Mesh>(new Mesh(&coneChain)) };
+		for (std::unique_ptr<Mesh>& mesh : meshes) {
+			mesh->enableAttributes(litShader.getActiveAttributeMask());
+		}
+
+		std::unique_ptr<UniformBuffer> materials[4];
+		for (int i = 0; i < 4; i++) {
+			materials[i] = makeMaterialBlock(i);
+		}
+
+		//A field of objects on the ground, the camera looking across it so about half are behind or beside it.
+		//Runs of objects share a mesh and material, as a scene sorted by a RenderQueue would
+		std::vector<glm::mat4> models = makeGridModels(numObjects, 200.0f, true);
+		//Every object has the same scale
+		float scale = models[0][0][0];
+		std::vector<int> lods(numObjects, 0);
+		const float fieldOfView = glm::radians(60.0f);
+		const float screenHeight = 720.0f;
+		glm::vec3 eye(0.0f, 10.0f, 0.0f);
+		glm::mat4 view = glm::lookAt(eye, glm::vec3(0.0f, 0.0f, -50.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+		glm::mat4 projection = glm::perspective(fieldOfView, 16.0f / 9.0f, 0.1f, 500.0f);
+		Frustum frustum(projection * view);
+		float projectedScale = screenHeight / (2.0f * tanf(fieldOfView * 0.5f));
+
+		//The INDIRECT variant and the geometry buffer are only made if the driver can draw with them
+		bool indirect = IndirectRenderer::isSupported();
+		Shader* indirectShader = nullptr;
+		std::unique_ptr<GeometryBuffer> geometry;
+		GeometryHandle handles[2] = { INVALID_GEOMETRY, INVALID_GEOMETRY };
+		std::unique_ptr<IndirectRenderer> renderer;
+		if (indirect) {
+			indirectShader = &litShader.getVariant({ { "INDIRECT", "1" } });
+			indirectShader->waitUntilReady();
+			geometry.reset(new GeometryBuffer(CompactVertex::layout()));
+			handles[0] = geometry->add(sphereChain);
+			handles[1] = geometry->add(coneChain);
+			renderer.reset(new IndirectRenderer(geometry.get()));
+		}
+		for (Shader* shader : { &litShader, indirectShader })
+		{
+			if (!shader) {
+				continue;
+			}
+			shader->use();
+			shader->setMat4("uView", view);
+			shader->setMat4("uProjection", projection);
+		}
+
+		//Culling and level selection happen while recording, so they spread across the threads too. Each object only
+		//touches its own entry in lods, so the slices never share anything they write
+		constexpr UniformKey modelKey("uModel");
+		auto isVisible = [&](int i, int& lod) {
+			const Mesh& mesh = *meshes[(i / 64) % 2];
+			glm::vec3 center = glm::vec3(models[i][3]);
+			float radius = mesh.getBoundingRadius() * scale;
+			if (!frustum.intersectsSphere(center, radius)) {
+				return false;
+			}
+			float distance = glm::max(glm::length(center - eye), radius);
+			lods[i] = lod = mesh.selectLod(2.0f * radius / distance * projectedScale, lods[i]);
+			return true;
+		};
+		RecordFunction recordDraws = [&](CommandBuffer& buffer, size_t first, size_t last) {
+			buffer.useShader(&litShader);
+			for (size_t i = first; i < last; i++)
+			{
+				int lod;
+				if (!isVisible((int)i, lod)) {
+					continue;
+				}
+				buffer.bindMaterial(materials[(i / 256) % 4].get());
+				buffer.bindMesh(meshes[(i / 64) % 2].get());
+				buffer.setMat4(modelKey, models[i]);
+				buffer.draw(lod);
+			}
+		};
+		RecordFunction recordMultiDraw = [&](CommandBuffer& buffer, size_t first, size_t last) {
+			buffer.useShader(indirectShader);
+			buffer.bindMaterial(materials[0].get());
+			for (size_t i = first; i < last; i++)
+			{
+				int lod;
+				if (isVisible((int)i, lod)) {
+					buffer.addIndirect(*geometry, handles[(i / 64) % 2], models[i], lod);
+				}
+			}
+			buffer.multiDraw(renderer.get());
+		};
+
+		CommandRecorder serialRecorder(1);
+		CommandRecorder parallelRecorder;
+		CommandRecorder* recorders[2] = { &serialRecorder, &parallelRecorder };
+		const RecordFunction* recordFunctions[2] = { &recordDraws, &recordMultiDraw };
+		double recordMs[2][2] = {};
+		double replayMs[2][2] = {};
+		size_t commandCounts[2][2] = {};
+		for (int multiDraw = 0; multiDraw < (indirect ? 2 : 1); multiDraw++)
+		{
+			for (int parallel = 0; parallel < 2; parallel++)
+			{
+				std::fill(lods.begin(), lods.end(), 0);
+				double frameMs = runTimedFrames(numFrames, [&](int frame) {
+					Clock::time_point start = Clock::now();
+					recorders[parallel]->record(numObjects, *recordFunctions[multiDraw]);
+					if (frame >= 0) {
+						recordMs[multiDraw][parallel] += millisecondsSince(start) / numFrames;
+					}
+					glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+					recorders[parallel]->replay();
+				});
+				//Replaying is the rest of the frame
+				replayMs[multiDraw][parallel] = frameMs - recordMs[multiDraw][parallel];
+				commandCounts[multiDraw][parallel] = recorders[parallel]->getCommandCount();
+			}
+		}
+
+		printf("Command recording, %d objects, average of %d frames:\n", numObjects, numFrames);
+		const char* labels[2] = { "one draw per object", "multi-draw per thread" };
+		for (int multiDraw = 0; multiDraw < 2; multiDraw++)
+		{
+			if (multiDraw && !indirect) {
+				printf("  %s: multi-draw indirect not supported by this driver\n", labels[multiDraw]);
+				continue;
+			}
+			for (int parallel = 0; parallel < 2; parallel++)
+			{
+				printf("  %s, %2u thread(s): %8.3f ms recording, %8.3f ms replaying, %zu commands\n", labels[multiDraw],
+					recorders[parallel]->getThreadCount(), recordMs[multiDraw][parallel],
+					replayMs[multiDraw][parallel], commandCounts[multiDraw][parallel]);
+			}
+		}
+	}
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include "../EW/Shader.h"
+
+//Benchmarks are run by launching with --bench. Results are printed to stdout
+namespace WB
+{
+	//Per-frame cost of uploading the lit shader's uniforms for numObjects objects.
+	//Compares the old std::string + glGetUniformLocation path to the cached uniform table
+	void benchmarkUniformUploads(Shader& litShader, int numObjects, int numFrames);
+
+	//Time to draw a sphere of numSegments segments numDraws times, stored as Vertex (36 bytes) and as CompactVertex (12 bytes)
+	void benchmarkVertexFormats(Shader& litShader, int numSegments, int numDraws, int numFrames);
+
+	//ACMR and ATVR of the generated shapes before and after optimizeMesh
+	void reportVertexCache();
+
+	//Overdraw of the generated shapes and of a cluster of overlapping spheres, estimated on the CPU, before and after
+	//optimizeOverdraw at each threshold
+	void reportOverdraw(const std::vector<float>& thresholds);
+
+	//Triangles and error of each level of detail, regenerated and simplified, and the time simplification takes
+	void reportLods();
+
+	//Meshlets of a sphere of numSegments segments seen from one side, and how many triangles culling them removes
+	void benchmarkMeshletCulling(int numSegments, int numFrames);
+
+	//Time to generate a sphere and a cone of each segment count, growing the vectors per element on one thread
+	//and counting up front across threads. Also checks both produce the same bytes
+	void benchmarkShapeGen(const std::vector<int>& segmentCounts);
+
+	//Triangles, vertices, silhouette error and shading error of icospheres of up to maxSubdivisions, each next to
+	//the UV sphere with the fewest segments that is at least as round
+	void reportIcosphere(int maxSubdivisions);
+
+	//What cleanupMesh removes from each generated shape, and from an unindexed sphere
+	void reportCleanup();
+
+	//Time to draw numObjects small cubes and spheres with the lit shader, one draw call per object with uModel set
+	//before each, and with one Mesh::drawInstanced per shape
+	void benchmarkInstancing(Shader& litShader, int numObjects, int numFrames);
+
+	//Time to draw numObjects objects cycling through the levels of a sphere and a cone, each level its own Mesh drawn
+	//with its own call, and all of them from one GeometryBuffer in a single IndirectRenderer multi-draw
+	void benchmarkIndirect(Shader& litShader, int numObjects, int numFrames);
+
+	//Time to draw numObjects objects with random shaders, materials and meshes through a RenderQueue in the order
+	//they were submitted and sorted, how many times each changed program, vertex array and material, and how many
+	//GL state calls GLState passed on and dropped
+	void benchmarkRenderQueue(Shader& litShader, int numObjects, int numFrames);
+
+	//Time to frustum cull numObjects objects, pick each one's level and record its draw into command buffers on one
+	//thread and on every core, and to replay the buffers on the GL thread. Recorded as one draw per object, and as
+	//one multi-draw per thread when the driver supports it
+	void benchmarkCommandRecording(Shader& litShader, int numObjects, int numFrames);
+}
@@ -3,6 +3,7 @@
 #include <glm/glm.hpp>
 #include <glm/matrix.hpp>
 #include <glm/gtc/matrix_transform.hpp>
+#include <float.h>
 #include "Math.h"
 
 const glm::vec3 WORLD_UP = glm::vec3(0, 1, 0);
@@ -160,6 +161,29 @@ namespace WB {
 			return WB::lookAt(mPosition, mPosition + getForward(), WORLD_UP);
 		}
 
+		//Diameter in pixels of a sphere seen on a screen screenHeight pixels tall, used to pick levels of detail.
+		//Huge once the camera is inside the sphere
+		float getProjectedSize(glm::vec3 center, float radius, float screenHeight)
+		{
+			if (mProj == Projection::orthographic) {
+				return 2.0f * radius / mOrthoSize * screenHeight;
+			}
+
+			float distance = glm::length(center - mPosition);
+			if (distance <= radius) {
+				return FLT_MAX;
+			}
+			//The sphere's silhouette subtends an angle of asin(radius / distance) on each side
+			float tangent = radius / sqrtf(distance * distance - radius * radius);
+			return tangent / glm::tan(glm::radians(mFov) / 2.0f) * screenHeight;
+		}
+
+		//How far in front of the camera a point is, along its forward axis. Negative behind it
+		float getViewDepth(glm::vec3 point)
+		{
+			return glm::dot(point - mPosition, getForward());
+		}
+
 		glm::vec3 getForward()
 		{
 			float yawRadians = glm::radians(mYaw);
@@ -0,0 +1,84 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <cstddef>
+
+//Size of the pointLights array in LightBlock. Injected into the shaders as MAX_POINT_LIGHTS, see shaders/lights.glsl
+const int MAX_POINT_LIGHTS = 16;
+
+//C++ mirrors of the std140 uniform blocks declared in shaders/lights.glsl and shaders/material.glsl.
+//Every vec3 is followed by either a float the shader packs into that slot or explicit padding,
+//which puts each member on the offset std140 gives it. The asserts below catch any drift.
+
+struct DirLightStd140
+{
+	glm::vec3 direction;
+	float pad0;
+	glm::vec3 ambient;
+	float pad1;
+	glm::vec3 diffuse;
+	float pad2;
+	glm::vec3 specular;
+	float pad3;
+};
+
+struct SpotLightStd140
+{
+	glm::vec3 position;
+	float constant;
+	glm::vec3 direction;
+	float linear;
+	glm::vec3 ambient;
+	float quadratic;
+	glm::vec3 diffuse;
+	float cutOff;
+	glm::vec3 specular;
+	float pad0;
+};
+
+struct PointLightStd140
+{
+	glm::vec3 position;
+	float constant;
+	glm::vec3 ambient;
+	float linear;
+	glm::vec3 diffuse;
+	float quadratic;
+	glm::vec3 specular;
+	float pad0;
+};
+
+struct LightBlock
+{
+	DirLightStd140 dirLight;
+	SpotLightStd140 sptLight;
+	PointLightStd140 pointLights[MAX_POINT_LIGHTS];
+};
+
+struct MaterialBlock
+{
+	glm::vec3 ambient;
+	float shininess;
+	glm::vec3 diffuse;
+	float pad0;
+	glm::vec3 specular;
+	float pad1;
+};
+
+//Structs are padded to a multiple of 16 in std140, which is also the array stride of pointLights
+static_assert(sizeof(glm::vec3) == 12, "glm::vec3 must be tightly packed");
+static_assert(sizeof(DirLightStd140) == 64, "DirLight std140 size");
+static_assert(offsetof(SpotLightStd140, constant) == 12, "SpotLight.constant std140 offset");
+static_assert(offsetof(SpotLightStd140, direction) == 16, "SpotLight.direction std140 offset");
+static_assert(offsetof(SpotLightStd140, cutOff) == 60, "SpotLight.cutOff std140 offset");
+static_assert(offsetof(SpotLightStd140, specular) == 64, "SpotLight.specular std140 offset");
+static_assert(sizeof(SpotLightStd140) == 80, "SpotLight std140 size");
+static_assert(offsetof(PointLightStd140, quadratic) == 44, "PointLight.quadratic std140 offset");
+static_assert(offsetof(PointLightStd140, specular) == 48, "PointLight.specular std140 offset");
+static_assert(sizeof(PointLightStd140) == 64, "PointLight std140 size");
+static_assert(offsetof(LightBlock, sptLight) == 64, "LightBlock.sptLight std140 offset");
+static_assert(offsetof(LightBlock, pointLights) == 144, "LightBlock.pointLights std140 offset");
+static_assert(sizeof(LightBlock) == 144 + 64 * MAX_POINT_LIGHTS, "LightBlock std140 size");
+static_assert(offsetof(MaterialBlock, shininess) == 12, "Material.shininess std140 offset");
+static_assert(offsetof(MaterialBlock, diffuse) == 16, "Material.diffuse std140 offset");
+static_assert(offsetof(MaterialBlock, specular) == 32, "Material.specular std140 offset");
+static_assert(sizeof(MaterialBlock) == 48, "Material std140 size");
@@ -1,5 +1,8 @@
-#include <sstream>
 #include <random>
+#include <algorithm>
+#include <string>
+#include <memory>
+#include <chrono>
 
 #include "GL/glew.h"
 #include "GLFW/glfw3.h"
@@ -10,6 +13,7 @@
 #include <glm/gtc/type_ptr.hpp>
 
 #include <stdio.h>
+#include <string.h>
 
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
@@ -24,12 +28,23 @@
 #include "EW/Shader.h"
 #include "EW/Mesh.h"
 #include "EW/ShapeGen.h"
+#include "EW/StaticShapeGen.h"
+#include "EW/UniformBuffer.h"
+#include "EW/InstanceBuffer.h"
+#include "EW/GeometryBuffer.h"
+#include "EW/IndirectRenderer.h"
+#include "EW/RenderQueue.h"
+#include "EW/GLState.h"
+#include "EW/ProgramCache.h"
+#include "EW/ShaderWatcher.h"
 
 //
 #include "WBox/Lights.h"
+#include "WBox/LightBlocks.h"
 #include "WBox/Math.h"
 #include "WBox/Camera.h"
 #include "WBox/Transform.h"
+#include "WBox/Benchmarks.h"
 
 void processInput(GLFWwindow* window);
 void resizeFrameBufferCallback(GLFWwindow* window, int width, int height);
@@ -40,6 +55,9 @@ void mousePosCallback(GLFWwindow* window, double xpos, double ypos);
 void mouseButtonCallback(GLFWwindow* window, int button, int action, int mods);
 
 glm::vec3 getPointOnSphere(float radius);
+int selectLod(const std::vector<MeshLod>& levels, float boundingRadius, const WB::Transform& transform, int currentLod);
+bool failedToLink(const Shader& shader);
+ShaderDefines getLightDefines();
 
 const int NUM_OF_POINT_LIGHTS = 2;
 
@@ -106,9 +124,16 @@ float lightOrbit2Speed = -1.0f;
 
 bool drawAsPoints = false;
 
+//Lit shader variants are picked from these, so only the lights in use are computed
+int numActivePointLights = NUM_OF_POINT_LIGHTS;
+bool spotLightEnabled = true;
+
+//Raises (or lowers, if negative) the on-screen error every level of detail is allowed, doubling it per step
+float lodBias = 0.0f;
+
 //TODO: Add material variables. HINT: A struct is helpful!
 
-int main() {
+int main(int argc, char** argv) {
 	if (!glfwInit()) {
 		printf("glfw failed to init");
 		return 1;
@@ -140,35 +165,123 @@ int main() {
 	//Dark UI theme.
 	ImGui::StyleColorsDark();
 
-	//Used to draw shapes. This is the shader you will be completing.
-	Shader litShader("shaders/defaultLit.vert", "shaders/defaultLit.frag");
+	//Linked programs are kept on disk so later launches skip compiling
+	ProgramCache::setDirectory("shaderCache");
+	Shader::enableParallelCompile();
 
-	//Used to draw light
-	Shader unlitShader("shaders/defaultLit.vert", "shaders/unlit.frag");
+#ifdef _DEBUG
+	//Debug builds read shaders/ from disk when it is there, so shaders can be edited live. Release builds never touch it
+	Shader::setEmbeddedOverrideDirectory("shaders");
+	//Edits to anything in shaders/ are recompiled while the app runs
+	ShaderWatcher shaderWatcher("shaders");
+#endif
 
-	MeshData cubeMeshData;
-	createCube(1.0f, 1.0f, 1.0f, glm::vec3(1.0f), cubeMeshData);
-	MeshData sphereMeshData;
-	createSphere(0.5f, 64.0f, glm::vec3(1.0f), sphereMeshData);
-	MeshData coneMeshData;
-	createCone(0.75f, 1.0f, 64.0f, glm::vec3(1.0f), coneMeshData);
+	//Used to draw light. Compiled up front because it stands in for shaders that are still compiling
+	Shader unlitShader = Shader::fromEmbedded("defaultLit.vert", "unlit.frag");
 
-	Mesh cubeMesh(&cubeMeshData);
-	Mesh sphereMesh(&sphereMeshData);
-	Mesh coneMesh(&coneMeshData);
+	//Used to draw shapes. This is the shader you will be completing.
+	//Compiled in the background for the lights in use at startup, the shapes are drawn unlit until it has linked
+	ShaderDefines litDefines = getLightDefines();
+	litDefines.push_back({ "MAX_POINT_LIGHTS", std::to_string(MAX_POINT_LIGHTS) });
+	Shader litShader = Shader::fromEmbedded("defaultLit.vert", "defaultLit.frag", litDefines, true);
+	litShader.setFallback(&unlitShader);
+
+	//Mismatches between the shaders and the data fed to them are printed when each program links
+	unlitShader.expectVertexLayout(CompactVertex::layout());
+	litShader.expectVertexLayout(CompactVertex::layout());
+	litShader.expectUniformBlock("LightBlock", sizeof(LightBlock));
+	litShader.expectUniformBlock("MaterialBlock", sizeof(MaterialBlock));
+
+	//Draw the shapes and the lights with one multi-draw each, the lights picking their color with their material index.
+	//Only compiled if the driver can run them
+	Shader* litIndirectShader = nullptr;
+	Shader* unlitIndirectShader = nullptr;
+	if (IndirectRenderer::isSupported()) {
+		litIndirectShader = &litShader.getVariant({ { "INDIRECT", "1" } });
+		litIndirectShader->expectVertexLayout(IndirectRenderer::drawIndexLayout());
+		unlitIndirectShader = &unlitShader.getVariant({
+			{ "INDIRECT", "1" },
+			{ "MAX_INSTANCE_MATERIALS", std::to_string(MAX_INSTANCE_MATERIALS) }
+		});
+		unlitIndirectShader->expectVertexLayout(IndirectRenderer::drawIndexLayout());
+	}
+	//Draws both lights in one instanced call when the indirect shaders can't be used
+	Shader* unlitInstancedShader = nullptr;
+
+	//Shapes are stored as 12 byte vertices. Every shape is white, so the color isn't stored.
+	//The cube never changes, so it is built by the compiler and uploaded straight from read-only memory
+	static constexpr auto cubeMeshData = makeCube<CompactVertex>(1.0f, 1.0f, 1.0f);
+	//The sphere and cone get coarser levels of detail for when they are small on screen. The sphere is an icosphere
+	//(4 to 1 subdivisions), about as round as a 74 segment UV sphere at half the triangles. The cone has 64, 32, 16 and 8 segments
+	BasicMeshLodChain<CompactVertex> sphereLodChain;
+	createIcosphereLods(0.5f, 4, glm::vec3(1.0f), 4, sphereLodChain, SHAPEGEN_CLEANUP | SHAPEGEN_OPTIMIZE_VERTEX_CACHE);
+	BasicMeshLodChain<CompactVertex> coneLodChain;
+	createConeLods(0.75f, 1.0f, 64, glm::vec3(1.0f), 4, coneLodChain, SHAPEGEN_CLEANUP | SHAPEGEN_OPTIMIZE_VERTEX_CACHE);
+
+	//Levels of detail are picked from the chains, so it doesn't matter which of the two below holds the shapes
+	float sphereRadius = computeBoundingRadius(sphereLodChain.vertices);
+	float coneRadius = computeBoundingRadius(coneLodChain.vertices);
+
+	//The shapes are uploaded once, either into one vertex and one index buffer shared by the indirect draws,
+	//or as a mesh each
+	std::unique_ptr<GeometryBuffer> shapeGeometry;
+	std::unique_ptr<IndirectRenderer> shapeRenderer;
+	GeometryHandle cubeGeometry = INVALID_GEOMETRY;
+	GeometryHandle sphereGeometry = INVALID_GEOMETRY;
+	GeometryHandle coneGeometry = INVALID_GEOMETRY;
+	if (unlitIndirectShader && !failedToLink(*unlitIndirectShader)) {
+		shapeGeometry.reset(new GeometryBuffer(CompactVertex::layout()));
+		cubeGeometry = shapeGeometry->add(cubeMeshData);
+		sphereGeometry = shapeGeometry->add(sphereLodChain);
+		coneGeometry = shapeGeometry->add(coneLodChain);
+		shapeRenderer.reset(new IndirectRenderer(shapeGeometry.get()));
+	}
 
-	//Enable back face culling
-	glEnable(GL_CULL_FACE);
-	glCullFace(GL_BACK);
+	std::unique_ptr<Mesh> cubeMesh, sphereMesh, coneMesh;
+	//Only called without the indirect path, or once its shaders turn out not to link
+	auto createShapeMeshes = [&]() {
+		shapeRenderer.reset();
+		shapeGeometry.reset();
+		cubeMesh.reset(new Mesh(&cubeMeshData));
+		sphereMesh.reset(new Mesh(&sphereLodChain));
+		coneMesh.reset(new Mesh(&coneLodChain));
+		unlitInstancedShader = &unlitShader.getVariant({
+			{ "INSTANCED", "1" },
+			{ "MAX_INSTANCE_MATERIALS", std::to_string(MAX_INSTANCE_MATERIALS) }
+		});
+		unlitInstancedShader->expectVertexLayout(InstanceData::layout());
+	};
+	if (!shapeGeometry) {
+		createShapeMeshes();
+	}
 
-	//Enable blending
-	glEnable(GL_BLEND);
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	//Launch with --bench to print benchmark results and exit
+	if (argc > 1 && strcmp(argv[1], "--bench") == 0) {
+		litShader.waitUntilReady();
+		WB::benchmarkUniformUploads(litShader, 1000, 100);
+		WB::benchmarkVertexFormats(litShader, 512, 20, 50);
+		WB::reportVertexCache();
+		WB::reportOverdraw({ 1.0f, OVERDRAW_DEFAULT_THRESHOLD, 1.5f });
+		WB::reportLods();
+		WB::benchmarkMeshletCulling(512, 100);
+		WB::benchmarkShapeGen({ 64, 512, 4096 });
+		WB::reportIcosphere(5);
+		WB::reportCleanup();
+		WB::benchmarkInstancing(litShader, 100000, 20);
+		WB::benchmarkIndirect(litShader, 10000, 20);
+		WB::benchmarkRenderQueue(litShader, 10000, 20);
+		WB::benchmarkCommandRecording(litShader, 50000, 20);
+		glfwTerminate();
+		return 0;
+	}
 
-	glEnable(GL_DEPTH_TEST);
-	glDepthFunc(GL_LESS);
+#ifdef _DEBUG
+	shaderWatcher.watch(&litShader);
+	shaderWatcher.watch(&unlitShader);
+#endif
 
-	glPointSize(3.0f);
+	//Depth testing, back face culling and blending are set per pass, starting each frame from OPAQUE_RENDER_STATE
+	GLState::pointSize(3.0f);
 
 	//Initialize positions
 	cubeTransform.mPosition = glm::vec3(-2.0f, 0.0f, 0.0f);
@@ -194,6 +307,41 @@ int main() {
 
 	glm::vec3 testPointLightPositions[NUM_OF_POINT_LIGHTS];
 
+	//Light and material data go through uniform buffers shared by every shader that declares the blocks
+	UniformBuffer lightBuffer(LIGHT_BLOCK_BINDING, sizeof(LightBlock));
+	UniformBuffer materialBuffer(MATERIAL_BLOCK_BINDING, sizeof(MaterialBlock));
+	LightBlock lightBlock = {};
+
+	//The material never changes at runtime, so it only needs uploading once
+	MaterialBlock materialBlock = {};
+	materialBlock.ambient = testMaterial.mAmbient;
+	materialBlock.diffuse = testMaterial.mDiffuse;
+	materialBlock.specular = testMaterial.mSpecular;
+	materialBlock.shininess = testMaterial.mShininess;
+	materialBuffer.upload(materialBlock);
+
+	//Model matrix and material of each light, uploaded every frame
+	InstanceData lightInstances[2] = {};
+	InstanceBuffer lightInstanceBuffer(2);
+
+	//Everything not drawn indirectly is submitted here each frame and drawn sorted by state
+	RenderQueue renderQueue;
+
+	//Lit variants for the light settings below, only looked up for the path drawing the shapes. They start as
+	//litShader and its INDIRECT variant, which were compiled for them
+	Shader* litVariant = &litShader;
+	Shader* litIndirectVariant = litIndirectShader;
+	int variantPointLights = numActivePointLights;
+	bool variantSpotLight = spotLightEnabled;
+	//Set once an INDIRECT shader fails to link and the shapes move to their own meshes
+	bool indirectFailed = false;
+
+	//Level of detail each object was last drawn at
+	int sphereLod = 0;
+	int coneLod = 0;
+	int lightLod1 = 0;
+	int lightLod2 = 0;
+
 	while (!glfwWindowShouldClose(window)) {
 
 		testDirLight.setLight(LightType::ambient, ambientColor);
@@ -201,6 +349,13 @@ int main() {
 		testDirLight.setLight(LightType::specular, specularColor);
 
 		processInput(window);
+#ifdef _DEBUG
+		shaderWatcher.update();
+#endif
+		Shader::pollPending();
+		Shader::resetUniformStats();
+		GLState::resetStats();
+		GLState::apply(OPAQUE_RENDER_STATE);
 		glClearColor(bgColor.r,bgColor.g,bgColor.b, 1.0f);
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
@@ -221,32 +376,52 @@ int main() {
 		lightTransform2.mPosition.y += cosf(time * lightOrbit2Speed) * lightOrbit2Radius;
 		lightTransform2.mPosition.z += sinf(time * lightOrbit2Speed) * lightOrbit2Radius;
 
+		//Drawing each shape from its own mesh is the fallback if any INDIRECT shader in use doesn't link, the lit variant
+		//for the current lights included
+		if (shapeGeometry && (failedToLink(*litIndirectShader) || failedToLink(*litIndirectVariant)
+			|| failedToLink(*unlitIndirectShader))) {
+			createShapeMeshes();
+			litVariant = &litShader.getVariant(getLightDefines());
+			indirectFailed = true;
+		}
+		bool drawIndirect = shapeGeometry != nullptr;
+
+		//Pick the lit variant compiled for exactly the lights in use, looked up again only when they change.
+		//Each one is compiled on first use, and falls back to its parent until then
+		if (numActivePointLights != variantPointLights || spotLightEnabled != variantSpotLight) {
+			variantPointLights = numActivePointLights;
+			variantSpotLight = spotLightEnabled;
+			if (drawIndirect) {
+				litIndirectVariant = &litIndirectShader->getVariant(getLightDefines());
+			}
+			else {
+				litVariant = &litShader.getVariant(getLightDefines());
+			}
+		}
+		//Until the INDIRECT lit shader has linked at startup the shapes are drawn unlit, like the lit shader's fallback
+		Shader& opaqueShader = !drawIndirect ? *litVariant :
+			litIndirectShader->isReady() ? *litIndirectVariant : *unlitIndirectShader;
+
+		//Stop fetching vertex attributes no shader drawing the mesh reads (the lit shader ignores vertex color)
+		if (!drawIndirect) {
+			cubeMesh->enableAttributes(litVariant->getActiveAttributeMask());
+			coneMesh->enableAttributes(litVariant->getActiveAttributeMask());
+			sphereMesh->enableAttributes(litVariant->getActiveAttributeMask() | unlitInstancedShader->getActiveAttributeMask());
+		}
+
 		//Draw
-		litShader.use();
-		litShader.setMat4("uProjection", camera.getProjectionMatrix());
-		litShader.setMat4("uView", camera.getViewMatrix());
+		opaqueShader.use();
+		opaqueShader.setMat4("uProjection", camera.getProjectionMatrix());
+		opaqueShader.setMat4("uView", camera.getViewMatrix());
 
 		//TODO: Set material uniforms, lightPos, eyePos
-		litShader.setVec3("light.position", lightTransform1.mPosition);
- 		litShader.setVec3("dirLight.direction", testDirLight.getDirection());
-		litShader.setVec3("uEyePos", camera.getPosition());
-
-		litShader.setVec3("uLightColor", lightColor);
-
+		opaqueShader.setVec3("uEyePos", camera.getPosition());
 
 		//Directional Lighting Stuff
-		/*litShader.setVec3("dirLight.ambient", testDirLight.getLight(LightType::ambient));
-		litShader.setVec3("dirLight.diffuse", testDirLight.getLight(LightType::diffuse));
-		litShader.setVec3("dirLight.specular", testDirLight.getLight(LightType::specular));*/
-
-		litShader.setVec3("dirLight.ambient", ambientColor);
-		litShader.setVec3("dirLight.diffuse", diffuseColor);
-		litShader.setVec3("dirLight.specular", specularColor);
-
-		litShader.setVec3("material.ambient", testMaterial.mAmbient);
-		litShader.setVec3("material.diffuse", testMaterial.mDiffuse);
-		litShader.setVec3("material.specular", testMaterial.mSpecular);
-		litShader.setFloat("material.shininess", testMaterial.mShininess);
+		lightBlock.dirLight.direction = testDirLight.getDirection();
+		lightBlock.dirLight.ambient = ambientColor;
+		lightBlock.dirLight.diffuse = diffuseColor;
+		lightBlock.dirLight.specular = specularColor;
 
 		//Point Light Stuff
 		testPointLightPositions[0] = lightTransform1.mPosition;
@@ -254,71 +429,90 @@ int main() {
 
 		for (int i = 0; i < NUM_OF_POINT_LIGHTS; i++)
 		{
-			std::stringstream ss1,ss2,ss3,ss4,ss5,ss6,ss7;
-			ss1 << "pointLights[" << i << "].position";
-			ss2 << "pointLights[" << i << "].ambient";
-			ss3 << "pointLights[" << i << "].diffuse";
-			ss4 << "pointLights[" << i << "].specular";
-			ss5 << "pointLights[" << i << "].constant";
-			ss6 << "pointLights[" << i << "].linear";
-			ss7 << "pointLights[" << i << "].quadratic";
-
-			litShader.setVec3(ss1.str(), testPointLightPositions[i]);
-
-			litShader.setVec3(ss2.str(), orbitalAmbientColor);
-			litShader.setVec3(ss3.str(), orbitalDiffuseColor);
-			litShader.setVec3(ss4.str(), orbitalSpecularColor);
-
-			litShader.setFloat(ss5.str(), pointLightFloats.x);
-			litShader.setFloat(ss6.str(), pointLightFloats.y);
-			litShader.setFloat(ss7.str(), pointLightFloats.z);
-		}
-
-		std::stringstream ss0, ss1, ss2, ss3, ss4, ss5, ss6, ss7, ss8, ss9;
-		ss0 << "sptLight";
-
-		litShader.setVec3(ss0.str()+".position", camera.getPosition());
-		litShader.setVec3(ss0.str() + ".direction", camera.getForward());
-
-		litShader.setVec3(ss0.str() + ".ambient", spotLightAmbientColor);
-		litShader.setVec3(ss0.str() + ".diffuse", spotLightDiffuseColor);
-		litShader.setVec3(ss0.str() + ".specular", spotLightSpecularColor);
+			PointLightStd140& pointLight = lightBlock.pointLights[i];
+			pointLight.position = testPointLightPositions[i];
 
-		litShader.setFloat(ss0.str() + ".constant", spotLightFloats.x);
-		litShader.setFloat(ss0.str() + ".linear", spotLightFloats.y);
-		litShader.setFloat(ss0.str() + ".quadratic", spotLightFloats.z);
+			pointLight.ambient = orbitalAmbientColor;
+			pointLight.diffuse = orbitalDiffuseColor;
+			pointLight.specular = orbitalSpecularColor;
 
-		litShader.setFloat(ss0.str() + ".cutoff", glm::cos(glm::radians(12.5f)));
-
-		litShader.setVec3("uLightColor", lightColor);
-
-		//Draw cube
-		litShader.setMat4("uModel", cubeTransform.getModelMatrix());
-		cubeMesh.draw(drawAsPoints);
-
-		//Draw sphere
-		litShader.setMat4("uModel", sphereTransform.getModelMatrix());
-		sphereMesh.draw(drawAsPoints);
-
-		//Draw cone
-		litShader.setMat4("uModel", coneTransform.getModelMatrix());
-		coneMesh.draw(drawAsPoints);
+			pointLight.constant = pointLightFloats.x;
+			pointLight.linear = pointLightFloats.y;
+			pointLight.quadratic = pointLightFloats.z;
+		}
 
-		//Draw light as a small sphere using unlit shader, ironically.
-		unlitShader.use();
-		unlitShader.setMat4("uProjection", camera.getProjectionMatrix());
-		unlitShader.setMat4("uView", camera.getViewMatrix());
-		unlitShader.setMat4("uModel", lightTransform1.getModelMatrix());
-		unlitShader.setVec3("uColor", lightColor);
-		sphereMesh.draw(drawAsPoints);
+		//Spot Light Stuff
+		lightBlock.sptLight.position = camera.getPosition();
+		lightBlock.sptLight.direction = camera.getForward();
+
+		lightBlock.sptLight.ambient = spotLightAmbientColor;
+		lightBlock.sptLight.diffuse = spotLightDiffuseColor;
+		lightBlock.sptLight.specular = spotLightSpecularColor;
+
+		lightBlock.sptLight.constant = spotLightFloats.x;
+		lightBlock.sptLight.linear = spotLightFloats.y;
+		lightBlock.sptLight.quadratic = spotLightFloats.z;
+
+		lightBlock.sptLight.cutOff = glm::cos(glm::radians(spotlightCutOffDegrees));
+
+		//One upload for every light, only as far as the last point light in use
+		lightBuffer.upload(&lightBlock, offsetof(LightBlock, pointLights) + NUM_OF_POINT_LIGHTS * sizeof(PointLightStd140));
+
+		sphereLod = selectLod(sphereLodChain.levels, sphereRadius, sphereTransform, sphereLod);
+		coneLod = selectLod(coneLodChain.levels, coneRadius, coneTransform, coneLod);
+		lightLod1 = selectLod(sphereLodChain.levels, sphereRadius, lightTransform1, lightLod1);
+		lightLod2 = selectLod(sphereLodChain.levels, sphereRadius, lightTransform2, lightLod2);
+
+		renderQueue.clear();
+		if (drawIndirect) {
+			//Cube, sphere and cone in one call, then both lights in another using the unlit shader, ironically.
+			//Each light picks its color with its material index
+			unlitIndirectShader->setMat4("uProjection", camera.getProjectionMatrix());
+			unlitIndirectShader->setMat4("uView", camera.getViewMatrix());
+			unlitIndirectShader->setVec3("uMaterialColors[0]", lightColor);
+			unlitIndirectShader->setVec3("uMaterialColors[1]", lightColor);
+
+			opaqueShader.use();
+			shapeRenderer->clear();
+			shapeRenderer->add(cubeGeometry, cubeTransform.getModelMatrix());
+			shapeRenderer->add(sphereGeometry, sphereTransform.getModelMatrix(), sphereLod);
+			shapeRenderer->add(coneGeometry, coneTransform.getModelMatrix(), coneLod);
+			shapeRenderer->draw(drawAsPoints);
+
+			unlitIndirectShader->use();
+			shapeRenderer->clear();
+			shapeRenderer->add(sphereGeometry, lightTransform1.getModelMatrix(), lightLod1, 0);
+			shapeRenderer->add(sphereGeometry, lightTransform2.getModelMatrix(), lightLod2, 1);
+			shapeRenderer->draw(drawAsPoints);
+		}
+		else {
+			renderQueue.submit(cubeMesh.get(), litVariant, &materialBuffer, cubeTransform.getModelMatrix(),
+				camera.getViewDepth(cubeTransform.mPosition));
+			renderQueue.submit(sphereMesh.get(), litVariant, &materialBuffer, sphereTransform.getModelMatrix(),
+				camera.getViewDepth(sphereTransform.mPosition), sphereLod);
+			renderQueue.submit(coneMesh.get(), litVariant, &materialBuffer, coneTransform.getModelMatrix(),
+				camera.getViewDepth(coneTransform.mPosition), coneLod);
+
+			//Draw both lights as small spheres in one instanced draw using the unlit shader, ironically.
+			//They share a level of detail, the finer of the two
+			lightInstances[0].model = lightTransform1.getModelMatrix();
+			lightInstances[0].materialIndex = 0;
+			lightInstances[1].model = lightTransform2.getModelMatrix();
+			lightInstances[1].materialIndex = 1;
+			lightInstanceBuffer.upload(lightInstances, 2);
+
+			unlitInstancedShader->use();
+			unlitInstancedShader->setMat4("uProjection", camera.getProjectionMatrix());
+			unlitInstancedShader->setMat4("uView", camera.getViewMatrix());
+			unlitInstancedShader->setVec3("uMaterialColors[0]", lightColor);
+			unlitInstancedShader->setVec3("uMaterialColors[1]", lightColor);
+			float lightDepth = std::min(camera.getViewDepth(lightTransform1.mPosition), camera.getViewDepth(lightTransform2.mPosition));
+			renderQueue.submitInstanced(sphereMesh.get(), unlitInstancedShader, nullptr, &lightInstanceBuffer, 2, lightDepth,
+				std::min(lightLod1, lightLod2));
+		}
 
-		//Draw second point light as a small sphere using the unlit shader
-		unlitShader.use();
-		unlitShader.setMat4("uProjection", camera.getProjectionMatrix());
-		unlitShader.setMat4("uView", camera.getViewMatrix());
-		unlitShader.setMat4("uModel", lightTransform2.getModelMatrix());
-		unlitShader.setVec3("uColor", lightColor);
-		sphereMesh.draw(drawAsPoints);
+		renderQueue.sort();
+		renderQueue.execute(drawAsPoints);
 
 		//Draw UI
 		ImGui::Begin("Settings");
@@ -329,6 +523,9 @@ int main() {
 		ImGui::ColorEdit3("Directional Diffuse Color", &diffuseColor.r);
 		ImGui::ColorEdit3("Directional Specular Color", &specularColor.r);
 
+		ImGui::SliderInt("Point Lights", &numActivePointLights, 0, NUM_OF_POINT_LIGHTS);
+		ImGui::Checkbox("Spot Light", &spotLightEnabled);
+
 		ImGui::ColorEdit3("Spot Light Ambient Color", &spotLightAmbientColor.r);
 		ImGui::ColorEdit3("Spot Light Diffuse Color", &spotLightDiffuseColor.r);
 		ImGui::ColorEdit3("Spot Light Specular Color", &spotLightSpecularColor.r);
@@ -350,10 +547,36 @@ int main() {
 		ImGui::SliderFloat("Light Two Orbit Radius", &lightOrbit2Radius, 0.0f, 5.0f);
 		ImGui::SliderFloat("Light Two Orbit Speed", &lightOrbit2Speed, 0.0f, -3.0f);
 
+		ImGui::SliderFloat("LOD Bias", &lodBias, -2.0f, 4.0f);
+		ImGui::Text("LOD: sphere %d, cone %d, lights %d %d", sphereLod, coneLod, lightLod1, lightLod2);
+		ImGui::Text("Opaque pass: %s", drawIndirect ? "2 multi-draws" : "3 draws and 1 instanced");
+		const RenderQueueStats& queueStats = renderQueue.getStats();
+		ImGui::Text("Render queue: %u draws, %u program, %u VAO, %u material switches", queueStats.draws,
+			queueStats.programSwitches, queueStats.vertexArraySwitches, queueStats.materialSwitches);
+
+		UniformCallStats uniformStats = Shader::getUniformStats();
+		ImGui::Text("Uniform calls: %u issued, %u skipped", uniformStats.issued, uniformStats.skipped);
+		GLStateStats stateStats = GLState::getStats();
+		ImGui::Text("GL state calls: %u issued, %u elided", stateStats.issued, stateStats.elided);
+
+		//Shaders that failed to reload keep drawing with their last good program. Each log includes its variants',
+		//so the INDIRECT shaders and their light count variants are reported here too
+		std::string shaderErrors = litShader.getErrorLog() + unlitShader.getErrorLog();
+		if (indirectFailed) {
+			shaderErrors += "INDIRECT shaders failed to link, each shape is drawn from its own mesh\n";
+		}
+		if (!shaderErrors.empty()) {
+			ImGui::Separator();
+			ImGui::TextColored(ImVec4(1.0f, 0.4f, 0.4f, 1.0f), "Shader errors");
+			ImGui::TextWrapped("%s", shaderErrors.c_str());
+		}
+
 		ImGui::End();
 
 		ImGui::Render();
 		ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+		//ImGui binds and enables through GL directly
+		GLState::invalidate();
 		glfwPollEvents();
 
 		glfwSwapBuffers(window);
@@ -395,6 +618,30 @@ void keyboardCallback(GLFWwindow* window, int keycode, int scancode, int action,
 	}
 }
 
+int selectLod(const std::vector<MeshLod>& levels, float boundingRadius, const WB::Transform& transform, int currentLod)
+{
+	glm::vec3 scale = transform.mScale;
+	float radius = boundingRadius * glm::max(scale.x, glm::max(scale.y, scale.z));
+	float projectedSize = camera.getProjectedSize(transform.mPosition, radius, (float)SCREEN_HEIGHT);
+	return selectLod(levels, projectedSize, currentLod, lodBias);
+}
+
+//True once the shader's program has failed to link. Resolved by Shader::pollPending() on the GL thread
+bool failedToLink(const Shader& shader)
+{
+	std::shared_future<bool> ready = shader.ready();
+	return ready.wait_for(std::chrono::seconds(0)) == std::future_status::ready && !ready.get();
+}
+
+//Defines picking the lit variant for the lights in use
+ShaderDefines getLightDefines()
+{
+	return {
+		{ "NR_POINT_LIGHTS", std::to_string(numActivePointLights) },
+		{ "HAS_SPOT", spotLightEnabled ? "1" : "0" }
+	};
+}
+
 float randomRange(float min, float max)
 {
 	return min + (max - min) * ((float)rand() / (float)RAND_MAX);
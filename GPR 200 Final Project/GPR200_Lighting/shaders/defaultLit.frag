@@ -6,51 +6,32 @@ in vec3 Color;
 in vec3 WorldPos;
 in vec3 WorldNormal;
 
-struct Material
-{
-    vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;
-    float shininess;
-};
-
-struct SpotLight
-{
-    vec3  position;
-    vec3  direction;
+//Not read, but separable programs only match up the outputs of the INSTANCED and INDIRECT defaultLit.vert
+//if it is declared
+#ifndef INSTANCED
+#define INSTANCED 0
+#endif
 
-    vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;
-
-    float constant;
-    float linear;
-    float quadratic;
-
-    float cutOff;
-};
-
-struct PointLight
-{
-    vec3 position;
+#ifndef INDIRECT
+#define INDIRECT 0
+#endif
 
-    vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;
+#if INSTANCED || INDIRECT
+flat in uint MaterialIndex;
+#endif
 
-    float constant;
-    float linear;
-    float quadratic;
-};
+#include "material.glsl"
+#include "lights.glsl"
 
-struct DirLight
-{
-    vec3 direction;
+//Number of point lights actually lit. Pick a variant with the real count so the loop can be unrolled
+#ifndef NR_POINT_LIGHTS
+#define NR_POINT_LIGHTS 2
+#endif
 
-    vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;
-};
+//Set to 0 for a variant without the spot light
+#ifndef HAS_SPOT
+#define HAS_SPOT 1
+#endif
 
 struct Light
 {
@@ -67,15 +48,6 @@ vec3 CalculateSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 cameraD
 
 uniform vec3 uEyePos;
 
-uniform Material material;
-
-uniform DirLight dirLight;
-
-uniform SpotLight sptLight;
-
-#define NR_POINT_LIGHTS 2
-uniform PointLight pointLights[NR_POINT_LIGHTS];
-
 void main()
 {
     vec3 normal = normalize(WorldNormal);
@@ -83,7 +55,9 @@ void main()
 
     vec3 totalLight = CalculateDirectionalLighting(dirLight,normal,viewDirection);
 
+#if HAS_SPOT
     totalLight += CalculateSpotLight(sptLight,normal,WorldPos,viewDirection,uEyePos);
+#endif
 
     for(int i = 0; i < NR_POINT_LIGHTS; i++)
         totalLight += CalculatePointLight(pointLights[i], normal, WorldPos,viewDirection);
@@ -1,23 +1,74 @@
 #version 330     
+//Set to 1 for a variant drawn with Mesh::drawInstanced, which reads the model matrix per instance instead of uModel
+#ifndef INSTANCED
+#define INSTANCED 0
+#endif
+
+//Set to 1 for a variant drawn by IndirectRenderer, which reads the model matrix of each draw from DrawBlock.
+//Only compile it if IndirectRenderer::isSupported()
+#ifndef INDIRECT
+#define INDIRECT 0
+#endif
+
+#if INDIRECT
+#extension GL_ARB_shader_storage_buffer_object : require
+#endif
+
 layout (location = 0) in vec3 in_Pos;  
 layout (location = 1) in vec3 in_Color;
 layout (location = 2) in vec3 in_Normal;
 
+#if INSTANCED
+layout (location = 3) in mat4 in_Model;
+layout (location = 7) in uint in_MaterialIndex;
+#elif INDIRECT
+//Which entry of DrawBlock this draw is, from the command's baseInstance
+layout (location = 8) in uint in_DrawIndex;
+
+//Matches InstanceData
+struct DrawData
+{
+    mat4 model;
+    uint materialIndex;
+};
+
+layout (std430) readonly buffer DrawBlock
+{
+    DrawData draws[];
+};
+#else
+uniform mat4 uModel;
+#endif
+
+//Every fragment shader declares it too, or separable programs can't match up the outputs
+#if INSTANCED || INDIRECT
+flat out uint MaterialIndex;
+#endif
+
 out vec3 Color;
 
 out vec3 WorldPos;
 out vec3 WorldNormal;
 
-uniform mat4 uModel;
 uniform mat4 uView;
 uniform mat4 uProjection;
 
 void main(){       
+#if INSTANCED
+    mat4 model = in_Model;
+    MaterialIndex = in_MaterialIndex;
+#elif INDIRECT
+    mat4 model = draws[in_DrawIndex].model;
+    MaterialIndex = draws[in_DrawIndex].materialIndex;
+#else
+    mat4 model = uModel;
+#endif
+
     Color = in_Color;
-    gl_Position = uProjection * uView * uModel * vec4(in_Pos,1);
+    gl_Position = uProjection * uView * model * vec4(in_Pos,1);
 
-    WorldPos = vec3(uModel * vec4(in_Pos,1.0));
+    WorldPos = vec3(model * vec4(in_Pos,1.0));
 
-    WorldNormal = mat3(transpose(inverse(uModel))) * in_Normal;
+    WorldNormal = mat3(transpose(inverse(model))) * in_Normal;
 
 }
\ No newline at end of file
@@ -0,0 +1,50 @@
+//Shared light definitions. Pulled in with #include "lights.glsl"
+//Members are ordered so each float fills the padding after a vec3.
+//The std140 layout of these structs is mirrored in WBox/LightBlocks.h
+
+//Size of the pointLights array. Injected by the application from MAX_POINT_LIGHTS in WBox/LightBlocks.h
+#ifndef MAX_POINT_LIGHTS
+#define MAX_POINT_LIGHTS 16
+#endif
+
+struct SpotLight
+{
+    vec3  position;
+    float constant;
+    vec3  direction;
+    float linear;
+
+    vec3 ambient;
+    float quadratic;
+    vec3 diffuse;
+    float cutOff;
+    vec3 specular;
+};
+
+struct PointLight
+{
+    vec3 position;
+    float constant;
+
+    vec3 ambient;
+    float linear;
+    vec3 diffuse;
+    float quadratic;
+    vec3 specular;
+};
+
+struct DirLight
+{
+    vec3 direction;
+
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+};
+
+layout(std140) uniform LightBlock
+{
+    DirLight dirLight;
+    SpotLight sptLight;
+    PointLight pointLights[MAX_POINT_LIGHTS];
+};
@@ -0,0 +1,15 @@
+//Shared material definition. Pulled in with #include "material.glsl"
+//The std140 layout is mirrored by MaterialBlock in WBox/LightBlocks.h, shininess fills the padding after ambient
+
+struct Material
+{
+    vec3 ambient;
+    float shininess;
+    vec3 diffuse;
+    vec3 specular;
+};
+
+layout(std140) uniform MaterialBlock
+{
+    Material material;
+};
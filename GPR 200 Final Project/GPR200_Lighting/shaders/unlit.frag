@@ -5,8 +5,33 @@ in vec3 Color;
 in vec3 WorldPos;
 in vec3 WorldNormal;
 
+//Set to 1 for the variants paired with the INSTANCED or INDIRECT defaultLit.vert. Each instance or draw picks its
+//color from uMaterialColors
+#ifndef INSTANCED
+#define INSTANCED 0
+#endif
+
+#ifndef INDIRECT
+#define INDIRECT 0
+#endif
+
+#ifndef MAX_INSTANCE_MATERIALS
+#define MAX_INSTANCE_MATERIALS 8
+#endif
+
+#if INSTANCED || INDIRECT
+flat in uint MaterialIndex;
+
+uniform vec3 uMaterialColors[MAX_INSTANCE_MATERIALS];
+#else
 uniform vec3 uColor;
+#endif
 
 void main(){         
-    FragColor = vec4(Color * uColor,1.0f);
-}
+#if INSTANCED || INDIRECT
+    vec3 color = uMaterialColors[MaterialIndex];
+#else
+    vec3 color = uColor;
+#endif
+    FragColor = vec4(Color * color,1.0f);
+}
\ No newline at end of file
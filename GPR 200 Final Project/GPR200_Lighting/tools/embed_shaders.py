@@ -0,0 +1,89 @@
+"""Turns every file in a shader directory into a constexpr table compiled into the executable.
+
+Usage: python embed_shaders.py <shader directory> <output header>
+
+Run as a pre-build step. The header is only rewritten when its contents change, so an
+unchanged shader directory doesn't trigger a rebuild.
+"""
+import os
+import sys
+
+FNV64_OFFSET_BASIS = 14695981039346656037
+FNV64_PRIME = 1099511628211
+
+# MSVC caps a string literal at 65535 bytes, including every concatenated piece
+MAX_FILE_SIZE = 65535
+
+
+def fnv1a64(data):
+    """Same as hashString64 in EW/ProgramCache.h."""
+    value = FNV64_OFFSET_BASIS
+    for byte in data:
+        value ^= byte
+        value = (value * FNV64_PRIME) & 0xFFFFFFFFFFFFFFFF
+    return value
+
+
+def escape_line(line):
+    out = []
+    for ch in line:
+        if ch == "\\":
+            out.append("\\\\")
+        elif ch == '"':
+            out.append('\\"')
+        elif ch == "\t":
+            out.append("\\t")
+        elif ch == "?":
+            # Keeps ?? from forming a trigraph
+            out.append("\\?")
+        elif 32 <= ord(ch) < 127:
+            out.append(ch)
+        else:
+            out.append("\\x%02x\"\"" % ord(ch))
+    return "".join(out)
+
+
+def embed(shader_dir, output_path):
+    entries = []
+    for name in sorted(os.listdir(shader_dir)):
+        path = os.path.join(shader_dir, name)
+        if not os.path.isfile(path):
+            continue
+        with open(path, "rb") as f:
+            data = f.read()
+        # Line endings depend on the checkout, the embedded copy always uses \n
+        data = data.replace(b"\r\n", b"\n")
+        if len(data) > MAX_FILE_SIZE:
+            sys.exit("%s is too big to embed (%d bytes)" % (path, len(data)))
+        text = data.decode("latin-1")
+        lines = text.split("\n")
+        pieces = ['\t\t"%s\\n"' % escape_line(line) for line in lines[:-1]]
+        if lines[-1]:
+            pieces.append('\t\t"%s"' % escape_line(lines[-1]))
+        if not pieces:
+            pieces.append('\t\t""')
+        entries.append("\t{\n\t\t\"%s\",\n%s,\n\t\t%d, 0x%016xull\n\t}" % (name, "\n".join(pieces), len(data), fnv1a64(data)))
+
+    header = (
+        "//Generated by tools/embed_shaders.py from shaders/. Do not edit, rebuild instead\n"
+        "#pragma once\n"
+        "#include \"EmbeddedShaders.h\"\n"
+        "\n"
+        "constexpr EmbeddedShaderFile EMBEDDED_SHADER_FILES[] = {\n"
+        + ",\n".join(entries) + "\n"
+        "};\n"
+    )
+
+    if os.path.exists(output_path):
+        with open(output_path, "r", newline="") as f:
+            if f.read() == header:
+                return
+    with open(output_path, "w", newline="\n") as f:
+        f.write(header)
+    print("Embedded %d shader files into %s" % (len(entries), output_path))
+
+
+if __name__ == "__main__":
+    if len(sys.argv) != 3:
+        sys.exit(__doc__)
+    embed(sys.argv[1], sys.argv[2])